@@ -1,27 +1,29 @@
 #!/usr/bin/env python3
-"""Generate Language.dat and editable fixed-width Dictionary.dat files.
+"""Generate Language.dat and editable Dictionary.dat files.
 
-Dictionary.dat text record format (fixed width):
-    15 two-digit hex values plus trailing spaces (45 chars)
+Dictionary.dat text record format (one record per line):
+    2-digit hex phoneme count + ':' (3 chars)
+    + that many two-digit hex phoneme IDs, each followed by a space (3 chars each, up to 24)
     + 2-digit hex language ID + space (3 chars)
-    + word field padded with spaces to 26 chars
+    + word (up to 26 chars, no padding)
     + CRLF
 
-Record length = 76 bytes, which keeps binary-search indexing simple.
+Example: "04:05 10 15 21 01 hello\r\n"
+Lines in the old fixed-width layout (15 zero-padded phonemes, 26-char padded word, 76 bytes)
+are still read by the firmware and rewritten in this layout by the next compaction.
 """
 
 import sys
 import os
 
 # Record sizes
-DICT_HEX_COUNT = 15
-DICT_HEX_FIELD_CHARS = 45
-DICT_LANG_ID_CHARS = 2
-DICT_LANG_SEP_CHARS = 1
+DICT_PHONEME_MAX = 24
 DICT_WORD_SIZE = 26
-DICT_RECORD_SIZE = DICT_HEX_FIELD_CHARS + DICT_LANG_ID_CHARS + DICT_LANG_SEP_CHARS + DICT_WORD_SIZE + 2
+DICT_RECORD_MAX = 3 + DICT_PHONEME_MAX * 3 + 3 + DICT_WORD_SIZE + 2
 
-DICT_PHONEME_SIZE = 15
+# Old fixed-width layout, still accepted by print_dictionary_entry()
+DICT_LEGACY_PHONEMES = 15
+DICT_LEGACY_LANG_OFFSET = 45
 
 # Language definitions
 LANGUAGES = [
@@ -63,22 +65,29 @@ def create_language_dat(output_path):
 
 def create_dictionary_dat(input_file, output_path, language_id=0):
     """
-    Create Dictionary.dat as an empty fixed-width text file.
+    Create Dictionary.dat as an empty text file.
     """
     print(f"Creating {output_path}...")
     
     # Create empty file
     open(output_path, 'wb').close()
     print(f"✓ Created empty {output_path} (ready for population)")
-    print(f"  Record format: 15 hex bytes + 26-char word + CRLF")
-    print(f"  Each record: {DICT_RECORD_SIZE} bytes")
+    print(f"  Record format: phoneme count + up to {DICT_PHONEME_MAX} hex phonemes + language ID + word + CRLF")
+    print(f"  Each record: up to {DICT_RECORD_MAX} bytes")
     return True
 
 
 def format_dict_record(phoneme_seq, word, language_id=0):
-    """Build one fixed-width Dictionary.dat record (as bytes)."""
-    if len(phoneme_seq) != DICT_PHONEME_SIZE:
-        raise ValueError(f"Phoneme sequence must be {DICT_PHONEME_SIZE} bytes")
+    """Build one Dictionary.dat record (as bytes). Trailing zero phonemes are dropped."""
+    phoneme_seq = list(phoneme_seq)
+    while phoneme_seq and phoneme_seq[-1] == 0:
+        phoneme_seq.pop()
+
+    if len(phoneme_seq) > DICT_PHONEME_MAX:
+        raise ValueError(f"Phoneme sequence too long (max {DICT_PHONEME_MAX} phonemes)")
+
+    if 0 in phoneme_seq:
+        raise ValueError("Phoneme ID 00 is only valid as padding")
 
     if len(word) > DICT_WORD_SIZE:
         raise ValueError(f"Word too long (max {DICT_WORD_SIZE} chars)")
@@ -86,12 +95,8 @@ def format_dict_record(phoneme_seq, word, language_id=0):
     if language_id < 0 or language_id > 255:
         raise ValueError("language_id must be 0..255")
 
-    hex_part = ''.join(f"{b:02X} " for b in phoneme_seq)  # 45 chars with trailing space
-    if len(hex_part) != DICT_HEX_FIELD_CHARS:
-        raise ValueError("Internal format error: bad hex field length")
-
-    word_part = word.ljust(DICT_WORD_SIZE, ' ')
-    line = f"{hex_part}{language_id:02X} {word_part}\r\n"
+    hex_part = ''.join(f"{b:02X} " for b in phoneme_seq)
+    line = f"{len(phoneme_seq):02X}:{hex_part}{language_id:02X} {word}\r\n"
     return line.encode('ascii')
 
 
@@ -101,13 +106,10 @@ def add_dictionary_entry(output_path, phoneme_seq, word, language_id=0):
     
     Args:
         output_path: Path to Dictionary.dat
-        phoneme_seq: List of 15 phoneme IDs (bytes)
-        word: Word string (max 25 chars)
+        phoneme_seq: List of up to 24 phoneme IDs (bytes)
+        word: Word string (max 26 chars)
         language_id: Language ID (default 0 = Unknown)
     """
-    if len(phoneme_seq) != DICT_PHONEME_SIZE:
-        raise ValueError(f"Phoneme sequence must be {DICT_PHONEME_SIZE} bytes")
-    
     record = format_dict_record(phoneme_seq, word, language_id=language_id)
 
     with open(output_path, 'ab') as f:
@@ -124,20 +126,25 @@ def get_language_name(language_id):
 
 def print_dictionary_entry(data):
     """Print a dictionary entry in human-readable format."""
-    if len(data) != DICT_RECORD_SIZE:
+    line = data.decode('ascii', errors='ignore').rstrip('\r\n')
+    try:
+        if line[2:3] == ':':
+            count = int(line[0:2], 16)
+            fields = line[3:3 + count * 3].split()
+            lang_hex = line[3 + count * 3:5 + count * 3]
+            word = line[6 + count * 3:]
+        else:
+            fields = [f for f in line[:DICT_LEGACY_LANG_OFFSET].split() if f != '00']
+            lang_hex = line[DICT_LEGACY_LANG_OFFSET:DICT_LEGACY_LANG_OFFSET + 2]
+            word = line[DICT_LEGACY_LANG_OFFSET + 3:]
+        language_id = int(lang_hex, 16)
+    except ValueError:
         return None
-    line = data.decode('ascii', errors='ignore')
 
-    hex_part = line[:DICT_HEX_FIELD_CHARS]
-    lang_hex = line[DICT_HEX_FIELD_CHARS:DICT_HEX_FIELD_CHARS + DICT_LANG_ID_CHARS]
-    word = line[DICT_HEX_FIELD_CHARS + DICT_LANG_ID_CHARS + DICT_LANG_SEP_CHARS:
-                DICT_HEX_FIELD_CHARS + DICT_LANG_ID_CHARS + DICT_LANG_SEP_CHARS + DICT_WORD_SIZE].rstrip(' ')
-    phoneme_seq = hex_part.strip().split(' ')
-    
     return {
-        'phoneme_seq': ' '.join(phoneme_seq),
-        'language_id': int(lang_hex, 16) if lang_hex.strip() else 0,
-        'word': word
+        'phoneme_seq': ' '.join(fields),
+        'language_id': language_id,
+        'word': word.strip(' ')
     }
 
 
@@ -190,12 +197,14 @@ def main():
     print(f"    - 1 char: Space separator")
     print(f"    - N chars: Language name")
     print(f"    - 2 chars: CRLF")
-    print(f"  Dictionary.dat: {DICT_RECORD_SIZE} bytes per record")
-    print(f"    - 45 chars: 15 hex phoneme IDs (00-FF) separated by spaces")
+    print(f"  Dictionary.dat: one record per line, up to {DICT_RECORD_MAX} bytes")
+    print(f"    - 3 chars: Phoneme count in hex + ':'")
+    print(f"    - 3 chars per phoneme: hex phoneme ID (01-FF) + space, up to {DICT_PHONEME_MAX}")
     print(f"    - 2 chars: Language ID in hex (00-FF)")
     print(f"    - 1 char: Space separator")
-    print(f"    - 26 chars: Word (space padded)")
+    print(f"    - N chars: Word (up to {DICT_WORD_SIZE}, no padding)")
     print(f"    - 2 chars: CRLF")
+    print(f"    - Example: 04:05 10 15 21 01 hello")
 
 
 if __name__ == '__main__':
@@ -50,6 +50,9 @@ typedef unsigned long   LBA_t;
 static uint8_t sd_initialized = 0;
 static uint8_t sd_card_type = 0;  /* 0=SD1, 1=SD2, 2=SDHC/SDXC */
 
+/* Sectors fetched by disk_read(), used for dictionary lookup statistics */
+volatile uint32_t sd_sector_reads = 0;
+
 static void sd_cs_low(void) {
     gpio_put(SD_CS, 0);
 }
@@ -187,6 +190,7 @@ DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count) {
     if (!sd_initialized) return RES_NOTRDY;
 
     if (sd_card_type != 2) sector *= 512;
+    sd_sector_reads += count;
 
     for (UINT i = 0; i < count; i++) {
         sd_cs_low();
@@ -4,10 +4,15 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
 #include "hardware/i2c.h"
 #include "hardware/spi.h"
 #include "hardware/gpio.h"
 #include "hardware/uart.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "ff.h"
 #include "diskio.h"
 
@@ -18,6 +23,39 @@
 #define I2C_STAGE2_SDA 20
 #define I2C_STAGE2_SCL 21
 #define I2C_STAGE2_BAUD 400000
+#define I2C_STAGE2_IRQ I2C0_IRQ
+// The clock is switched per transfer. Stage 2/4 devices are probed at boot from 1 MHz (Fast-mode
+// Plus) down and drop one speed tier when failures pile up; the PCF8574 LCD backpack and keypad
+// stay at their rated 100 kHz.
+#define I2C_UI_BAUD 100000
+#define I2C_SPEED_ERROR_WEIGHT 16   // error score added per failed transfer; a success takes 1 off
+#define I2C_SPEED_ERROR_LIMIT 48    // score at which a device drops to the next slower tier
+// After this many failures in a row a device is only polled after a backoff that doubles with
+// each further failure; until then its descriptors fail without touching the bus.
+#define I2C_HEALTH_FAIL_LIMIT 3
+#define I2C_BACKOFF_MIN_MS 10
+#define I2C_BACKOFF_MAX_MS 5000
+
+// Every bus access goes through the I2C transaction engine: descriptors are queued and run back to
+// back by DMA, the I2C interrupt finishes each one and starts the next, and completion callbacks
+// run from i2c_async_tick() on core 1. Without two free DMA channels each descriptor runs with the
+// blocking SDK calls when it reaches the head of the queue.
+#define I2C_ASYNC_QUEUE_SIZE 32     // power of two
+#define I2C_ASYNC_MAX_CMDS 192      // header + payload + read bytes of one descriptor
+#define I2C_ASYNC_HEADER_MAX 6
+#define I2C_ASYNC_TIMEOUT_MIN_US 2000
+// Each descriptor belongs to a bus class with its own queue; the next transfer always comes from
+// the highest non-empty class. UI streams (the LCD) go out in slices of this many bytes, so a
+// FIFO drain waits for at most one slice.
+#define I2C_UI_SLICE_BYTES 4      // one LCD character, about 0.45 ms at 100 kHz
+// Page transfers keep up to this many descriptors in flight
+#define STAGE2_BATCH_DEPTH 16
+
+// Core 1 drains the Stage 2 FIFOs and owns the I2C engine's interrupt and callbacks; entries
+// reach core 0 through this ring. A drain only starts with room for one full burst.
+#define STAGE2_ENTRY_RING_SIZE 256  // power of two
+// Core 1 runs on a stack of its own in main RAM, so core 0 keeps both scratch banks
+#define CORE1_STACK_BYTES 4096
 
 #define STAGE2_BASE_ADDR 0x60
 #define STAGE2_COUNT 5
@@ -27,6 +65,8 @@
 #define STAGE2_REG_CONTROL    0x00
 #define STAGE2_REG_FIFO_LEN   0x01
 #define STAGE2_REG_FIFO_READ  0x05
+#define STAGE2_REG_CAPS       0x06
+#define STAGE2_REG_PAGE_CRC   0x0B
 #define STAGE2_REG_TARGET_NEURON 0x04
 #define STAGE2_REG_PAGE_MODE  0x0C
 #define STAGE2_REG_PAGE_ADDR  0x0D
@@ -48,6 +88,25 @@
 #define STAGE2_PAGE_B2    0x04
 #define STAGE2_PAGE_INPUT 0x05
 
+// Stage 2 capability bits (STAGE2_REG_CAPS). Older firmware NACKs the register or reads 0.
+// FIFO_BURST: reads of STAGE2_REG_FIFO_READ auto-advance, so one read of n x 5 bytes pops n entries.
+#define STAGE2_CAP_FIFO_BURST 0x01
+// REG_BLOCK: a multi-byte access moves on to the next register after each one (1 byte for 8-bit,
+// 2 for 16-bit registers) and stays on STAGE2_REG_PAGE_DATA once it gets there. One write then sets
+// page mode, address and length and carries the first data chunk, and one read returns
+// STAGE2_REG_LAST_MAX_ID..STAGE2_REG_LAST_MALE_VAL.
+#define STAGE2_CAP_REG_BLOCK 0x02
+// BROADCAST: the beam also accepts writes to STAGE2_GROUP_ADDR, and STAGE2_REG_PAGE_CRC reads the
+// CRC-16/CCITT (0x1021, start 0xFFFF) of the page window set by mode, address and length. An ANN
+// upload writes each page once to the group and checks every beam's copy with one CRC read.
+#define STAGE2_CAP_BROADCAST 0x04
+#define STAGE2_GROUP_ADDR 0x6F
+#define STAGE2_PAGE_HEADER_SIZE 6   // register + mode + 16-bit address + 16-bit length
+#define STAGE2_METRICS_COUNT 7      // STAGE2_REG_LAST_MAX_ID..STAGE2_REG_LAST_MALE_VAL
+#define STAGE2_ENTRY_SIZE 5
+// Entries per burst read; a longer FIFO is drained in several bursts.
+#define STAGE2_FIFO_BURST_MAX 32
+
 // Stage 2 control bits (write 0x06 to freeze + pause)
 #define STAGE2_CTRL_FREEZE_PAUSE 0x0006
 #define STAGE2_CTRL_BACKPROP 0x0004
@@ -173,6 +232,12 @@ typedef enum {
 // ==============================
 static const uint8_t word_ready_pins[STAGE2_COUNT] = {6, 7, 8, 9, 10};
 
+// A falling edge on a word-ready pin queues its beam (once until the beam is drained) from the GPIO
+// interrupt; core 1 drains beams in arrival order. A pin still low after its drain is queued
+// again, and every STAGE2_READY_SWEEP_MS the pins are re-read in case an edge was missed.
+#define STAGE2_READY_QUEUE_SIZE 8  // power of two, larger than STAGE2_COUNT
+#define STAGE2_READY_SWEEP_MS 50
+
 // ==============================
 // Diagnostics: stage2 not running
 // ==============================
@@ -206,20 +271,309 @@ typedef struct {
     uint8_t user_id;
 } stage2_entry_t;
 
-#define PHONEME_SEQ_LEN 15
+typedef enum {
+    STAGE2_FIFO_UNPROBED = 0,
+    STAGE2_FIFO_SINGLE,   // one write-address + repeated-start read per entry
+    STAGE2_FIFO_BURST     // all pending entries in one read
+} stage2_fifo_mode_t;
+
+typedef struct {
+    stage2_fifo_mode_t mode;
+    uint32_t drains;
+    uint32_t entries;
+    uint32_t transactions;  // I2C write/read pairs, FIFO length reads included
+    uint32_t burst_failures;
+    uint32_t ready_events;
+    uint32_t swept;         // ready pins found by the sweep rather than an edge
+    uint64_t latency_sum_us;  // ready edge -> drain start
+    uint32_t latency_max_us;
+} stage2_fifo_stats_t;
+
+typedef struct {
+    uint8_t beam;
+    uint32_t edge_us;
+} stage2_ready_event_t;
+
+typedef struct {
+    uint32_t time_us;  // when core 1 read the entry
+    uint8_t beam;
+    stage2_entry_t entry;
+} stage2_entry_record_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t high_water;
+    uint32_t full_stalls;  // drains cut short or held back for lack of room
+    uint32_t max_age_us;   // read on core 1 -> handled on core 0
+} stage2_entry_ring_stats_t;
+
+typedef enum {
+    I2C_CLASS_REALTIME = 0,  // Stage 2 FIFO drains
+    I2C_CLASS_TRAINING,      // register and page transfers of training, ANN load/save, Stage 4
+    I2C_CLASS_UI,            // LCD and keypad
+    I2C_CLASS_COUNT
+} i2c_bus_class_t;
+
+typedef enum {
+    I2C_ASYNC_IDLE = 0,
+    I2C_ASYNC_QUEUED,
+    I2C_ASYNC_ACTIVE,
+    I2C_ASYNC_DONE,
+    I2C_ASYNC_FAILED
+} i2c_async_state_t;
+
+// Descriptors of one group stop at the first failure: the rest complete as failed without
+// touching the bus (e.g. no page data after a failed page address write).
+typedef struct {
+    volatile bool failed;
+} i2c_async_group_t;
+
+typedef struct i2c_async_desc i2c_async_desc_t;
+typedef void (*i2c_async_callback_t)(i2c_async_desc_t *desc);
+
+// Writes header then tx, then reads rx_len bytes after a repeated start. The descriptor and its
+// buffers belong to the caller and must stay valid until the descriptor is done, or until its
+// callback has run if it has one. A sliced descriptor (tx only, no header) is written as separate
+// I2C_UI_SLICE_BYTES transfers, each with its own STOP; higher classes may run in between.
+struct i2c_async_desc {
+    uint8_t addr;
+    uint8_t bus_class;  // i2c_bus_class_t
+    bool sliced;
+    uint16_t tx_done;   // bytes of a sliced descriptor already on the bus
+    uint8_t header[I2C_ASYNC_HEADER_MAX];  // register address and small values, copied at submit
+    uint8_t header_len;
+    const uint8_t *tx;
+    uint16_t tx_len;
+    uint8_t *rx;
+    uint16_t rx_len;
+    i2c_async_group_t *group;
+    i2c_async_callback_t done;  // called from i2c_async_tick(), may be NULL
+    void *ctx;
+    volatile i2c_async_state_t state;
+};
+
+// Ring of descriptor pointers: head is advanced by i2c_async_submit(), tail by the interrupt as
+// descriptors finish, retire by i2c_async_tick() once their callbacks ran. The callback is kept
+// next to the pointer: a descriptor without one may be gone (or reused) by the time it retires.
+typedef struct {
+    i2c_async_desc_t *queue[I2C_ASYNC_QUEUE_SIZE];
+    i2c_async_callback_t callbacks[I2C_ASYNC_QUEUE_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t retire;
+} i2c_async_ring_t;
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t slices;     // UI slices that gave way to the scheduler before their stream ended
+    uint32_t queue_max;
+    uint64_t busy_us;    // bus time from start to STOP
+} i2c_class_stats_t;
+
+// Clock and health of one Stage 2/4 device. The tier only moves down after the boot probe.
+typedef struct {
+    uint8_t tier;          // index into i2c_speed_tiers
+    bool probed;           // passed the read-back probe at this tier
+    uint16_t error_score;
+    uint8_t fail_run;      // failures in a row
+    uint32_t backoff_ms;   // 0 while healthy
+    uint32_t retry_us;     // next poll of a backed-off device
+    uint32_t transfers;
+    uint32_t errors;
+    uint32_t downgrades;
+    uint32_t skipped;      // descriptors failed and drains held back during a backoff
+} i2c_device_t;
+
+typedef struct {
+    bool dma;
+    uint32_t failures;
+    uint32_t timeouts;
+    uint32_t recoveries;   // SCL clocked to free a held SDA line
+    i2c_class_stats_t cls[I2C_CLASS_COUNT];
+} i2c_async_stats_t;
+
+typedef struct {
+    uint32_t uploads;        // group uploads started
+    uint32_t group_beams;    // beams loaded through the group address
+    uint32_t page_retries;   // pages rewritten to one beam after a CRC mismatch
+    uint32_t unicast_beams;  // beams loaded one at a time
+    uint32_t delta_beams;    // beams that were sent only their changed weight pages
+    uint32_t pages_sent;     // 128-byte weight pages put on the bus (once per group write)
+    uint32_t pages_skipped;  // weight pages left out because the beams already held them
+} stage2_nn_upload_stats_t;
+
+// One beam's FIFO drain, run as a chain of descriptors: length, capability probe, entries.
+typedef enum {
+    STAGE2_DRAIN_IDLE = 0,
+    STAGE2_DRAIN_LEN,
+    STAGE2_DRAIN_CAPS,
+    STAGE2_DRAIN_BURST,
+    STAGE2_DRAIN_ENTRY
+} stage2_drain_step_t;
 
-// Dictionary text format (fixed width, binary-search friendly):
-// 15 hex bytes with trailing spaces (45 chars) + 2-char language ID + space + 26-char word + CRLF (2 chars)
+typedef struct {
+    i2c_async_desc_t desc;
+    stage2_drain_step_t step;
+    uint16_t remaining;
+    uint16_t count;
+    uint8_t buf[STAGE2_FIFO_BURST_MAX * STAGE2_ENTRY_SIZE];
+} stage2_drain_t;
+
+// Up to STAGE2_BATCH_DEPTH page descriptors in flight, reused in submission order.
+typedef struct {
+    i2c_async_desc_t desc[STAGE2_BATCH_DEPTH];
+    i2c_async_group_t group;
+    uint32_t submitted;
+    bool ok;
+} stage2_batch_t;
+
+// Longest word, in phonemes, the dictionary and the beam buffers can hold. Keys are stored
+// length-prefixed on the card, so raising this only costs RAM (one byte per key copy).
+#define PHONEME_SEQ_MAX 24
+
+// Dictionary text format, one record per CRLF-terminated line, sorted by (sequence, language, word):
+// phoneme count + ':' + that many phonemes + language ID (all 2-digit hex, space separated) + word
+// (up to 26 chars, no padding)
 // Example:
-// "05 10 15 21 00 00 00 00 00 00 00 00 00 00 00 00 hello                     \r\n"
-#define DICT_HEX_FIELD_CHARS 45
-#define DICT_LANG_ID_CHARS 2
-#define DICT_LANG_SEP_CHARS 1
-#define DICT_LANG_OFFSET DICT_HEX_FIELD_CHARS
-#define DICT_WORD_OFFSET (DICT_HEX_FIELD_CHARS + DICT_LANG_ID_CHARS + DICT_LANG_SEP_CHARS)
+// "04:05 10 15 21 01 hello\r\n"
+// Lines in the original fixed-width layout (15 zero-padded phonemes in 45 chars, language ID, space,
+// 26-char space-padded word) are still read; every line written by the firmware uses the new layout.
 #define DICT_WORD_SIZE 26
-#define DICT_LINE_END_CHARS 2
-#define DICT_RECORD_SIZE (DICT_HEX_FIELD_CHARS + DICT_LANG_ID_CHARS + DICT_LANG_SEP_CHARS + DICT_WORD_SIZE + DICT_LINE_END_CHARS)
+#define DICT_LEGACY_SEQ_LEN 15
+#define DICT_LEGACY_LANG_OFFSET 45
+// Longest line either layout produces, without the CRLF.
+#define DICT_LINE_MAX (3 + (PHONEME_SEQ_MAX * 3) + 3 + DICT_WORD_SIZE)
+// Line buffer size: longest line + CRLF + NUL.
+#define DICT_LINE_BUF (DICT_LINE_MAX + 3)
+// Bytes fetched per f_read() by the sequential line reader; must exceed DICT_LINE_MAX + 2.
+#define DICT_READER_BYTES 128
+
+// Packed binary shadow of Dictionary.dat (Dictionary.bin), rebuilt whenever the text file changes:
+// block 0 = header + language directory, then 512-byte blocks of variable-length records (phoneme
+// count, the phonemes, language ID, little-endian byte offset of the source line). Records never
+// straddle a block and a zero count byte ends a block early, so a probe is one sector. Each language
+// ID owns one segment that starts on a block boundary and is sorted by phoneme sequence; the
+// directory lists segments in ascending language ID.
+#define DICT_KEY_SIZE (PHONEME_SEQ_MAX + 1)
+#define DICT_BIN_VERSION 3
+#define DICT_BIN_BLOCK_SIZE 512
+#define DICT_BIN_RECORD_MAX (PHONEME_SEQ_MAX + 6)
+// Directory entries (language ID, 3 reserved bytes, u32 first block, u32 record count) from byte 32.
+#define DICT_BIN_DIR_OFFSET 32
+#define DICT_BIN_DIR_ENTRY_SIZE 12
+#define DICT_BIN_MAX_SEGMENTS ((DICT_BIN_BLOCK_SIZE - DICT_BIN_DIR_OFFSET) / DICT_BIN_DIR_ENTRY_SIZE)
+
+// RAM budget for the fence index (first key of every Dictionary.bin block, or of every Nth block
+// once the dictionary outgrows the budget). 8 KB covers 327 blocks (~15000 typical words) at one
+// sector per lookup.
+#define DICT_FENCE_BUDGET_BYTES 8192
+#define DICT_FENCE_MAX (DICT_FENCE_BUDGET_BYTES / DICT_KEY_SIZE)
+// Set to 1 to print probe/sector counts for every dictionary lookup.
+#define DICT_LOOKUP_TRACE 0
+// Fast-seek cluster link map entries per dictionary handle (2 per fragment + 1).
+#define DICT_CLMT_SIZE 64
+
+// Flash-resident dictionary: a compiled copy of Dictionary.dat in the top DICT_XIP_REGION_BYTES of
+// QSPI flash, binary-searched through XIP with no FatFs calls. Header (stamp, record count, segment
+// count, block size, block count, language directory as in Dictionary.bin) in the first 512 bytes.
+// Records (phoneme count, phonemes, language ID, word length, word) are packed into 256-byte blocks
+// in Dictionary.bin segment order, one flash page each, starting one sector in.
+#define DICT_XIP_ENABLE 1
+#define DICT_XIP_AUTO_SYNC 1
+#define DICT_XIP_VERSION 2
+#define DICT_XIP_REGION_BYTES (1024u * 1024u)
+#define DICT_XIP_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - DICT_XIP_REGION_BYTES)
+#define DICT_XIP_HEADER_BYTES 512
+#define DICT_XIP_DATA_OFFSET FLASH_SECTOR_SIZE
+#define DICT_XIP_BLOCK_SIZE FLASH_PAGE_SIZE
+#define DICT_XIP_RECORD_MAX (PHONEME_SEQ_MAX + 3 + DICT_WORD_SIZE)
+
+// Dictionary.trie: phoneme trie compiled from Dictionary.dat for streaming per-beam matching.
+// Block 0 = header, then 16-byte nodes (node 0 = root). The children of a node are stored as one
+// contiguous block sorted by phoneme, so stepping or scanning siblings stays inside one sector.
+#define DICT_TRIE_VERSION 2
+#define DICT_TRIE_NODE_SIZE 16
+// Widest fan-out allowed per node. Stage-2 phoneme IDs stop at 0x2C, so every legal sequence fits;
+// a dictionary with wider nodes is left without a trie.
+#define DICT_TRIE_MAX_CHILDREN 48
+#define DICT_TRIE_ROOT 0u
+#define DICT_TRIE_NONE UINT32_MAX
+#define DICT_TRIE_FLAG_TERMINAL 0x01
+// Shortest prefix allowed to emit a word before silence arrives (guards against one-phoneme guesses).
+#define DICT_TRIE_EARLY_MIN_PHONEMES 2
+
+// Phrases.ac: Aho-Corasick automaton over dictionary words and multi-word phrases, compiled offline
+// by tools/compile_phrases.py. Block 0 = header, then 16-byte states (state 0 = root), 4-byte edges
+// (phoneme + 24-bit target state, sorted per state), 8-byte patterns and the pattern text. Every
+// beam feeds its phonemes through it, so back-to-back words are found without a silence between them.
+#define DICT_PHRASE_PATH "0:/microsd/Phrases.ac"
+#define DICT_PHRASE_VERSION 1
+#define DICT_PHRASE_NODE_SIZE 16
+#define DICT_PHRASE_EDGE_SIZE 4
+#define DICT_PHRASE_PATTERN_SIZE 8
+#define DICT_PHRASE_MAX_EDGES DICT_TRIE_MAX_CHILDREN
+#define DICT_PHRASE_TEXT_MAX 64
+
+// Dictionary.widx: word -> line hash file for dict_seq_from_word()/dict_target_from_word().
+// Block 0 = header, then 512-byte buckets of 64 slots (u32 hash of the lower-cased word, u32 byte
+// offset of the line + 1, 0 = empty). Probing never leaves the bucket, so a lookup reads one sector
+// plus one line.
+#define DICT_WIDX_VERSION 2
+#define DICT_WIDX_SLOT_SIZE 8
+#define DICT_WIDX_SLOTS_PER_BUCKET (DICT_BIN_BLOCK_SIZE / DICT_WIDX_SLOT_SIZE)
+// Bucket bytes filled in RAM per chunk while building Dictionary.widx.
+#define DICT_WIDX_BUILD_BYTES 8192
+#define DICT_WIDX_CHUNK_BUCKETS (DICT_WIDX_BUILD_BYTES / DICT_BIN_BLOCK_SIZE)
+// Build runs: 512-byte blocks after the bucket area holding u32 previous block of the same run
+// (0 = none), u32 pair count, then (hash, line offset + 1) pairs.
+#define DICT_WIDX_RUN_PAIRS ((DICT_BIN_BLOCK_SIZE - 8) / DICT_WIDX_SLOT_SIZE)
+// Runs written at once while splitting: one block each in dict_build_scratch, plus the block being read.
+#define DICT_WIDX_RUNS (DICT_BUILD_SCRATCH_BYTES / DICT_BIN_BLOCK_SIZE - 1)
+// Shared by the index builds, which never run at the same time, and the approximate search. The trie
+// build and the search keep the open child blocks there as a stack (768 nodes).
+#define DICT_BUILD_SCRATCH_BYTES 12288
+#define DICT_SCRATCH_NODES (DICT_BUILD_SCRATCH_BYTES / DICT_TRIE_NODE_SIZE)
+
+// Approximate matching after an exact miss. Costs are in tenths of an edit: insertions, deletions and
+// default substitutions cost DICT_APPROX_UNIT; PhonemeCosts.txt can make confusable pairs cheaper.
+// DICT_APPROX_MAX_COST is the default search radius (APPROX <edits> changes it, 0 disables).
+#define DICT_APPROX_UNIT 10
+#define DICT_APPROX_MAX_COST 10
+#define DICT_APPROX_MIN_PHONEMES 3
+#define DICT_APPROX_FIRST_ID 0x05
+#define DICT_APPROX_PHONEMES 40
+// Child-block reads allowed per search; the best match so far is kept when the budget runs out.
+#define DICT_APPROX_READ_BUDGET 384
+
+// Bloom filter over the (sequence, language) keys in NewWords.dat so most misses skip the file scan.
+// 4 KB with 4 hashes gives ~2% false positives at 4096 unknown words.
+#define DICT_BLOOM_BITS 32768
+#define DICT_BLOOM_HASHES 4
+
+// In-RAM copy of NewWords.dat: open-addressing table (power-of-two slot count) over a fixed entry pool.
+// 52 bytes per pooled entry; keep SLOTS >= 2 x POOL so probe runs stay short. Once the pool is full,
+// further unknown words fall back to the Bloom filter + file scan.
+#define DICT_NEWWORDS_POOL 1024
+#define DICT_NEWWORDS_SLOTS 2048
+
+// Log-structured dictionary additions: sorted RAM memtable (53 bytes per entry) mirrored by the
+// append-only Dictionary.delta. Reaching COMPACT_AT starts a background merge into Dictionary.dat.
+#define DICT_MEMTABLE_MAX 256
+#define DICT_MEMTABLE_COMPACT_AT 192
+// Records merged per main-loop tick by a background compaction.
+#define DICT_COMPACT_BATCH 32
+// A merged Dictionary.new that could not be swapped in is retried this often.
+#define DICT_INSTALL_RETRY_MS 2000
+
+// Lookup result cache in front of dict_lookup_word(): LRU over DICT_CACHE_ENTRIES (~68 bytes each).
+// The DICT_CACHE_PERSIST most-hit entries are written to DictCache.bin every DICT_CACHE_SAVE_MS
+// (only when hit counts changed) and looked up again at boot so the cache starts warm.
+#define DICT_CACHE_ENTRIES 64
+#define DICT_CACHE_PERSIST 32
+#define DICT_CACHE_SAVE_MS 60000
+#define DICT_CACHE_VERSION 2
+#define DICT_CACHE_RECORD_SIZE (DICT_KEY_SIZE + 4)
 
 // Language file format: "HH Name\r\n" (2-digit hex ID, space, text name)
 #define LANG_RECORD_SIZE 32
@@ -244,6 +598,53 @@ typedef struct {
 #define B2_SIZE (OUTPUT_NEURONS)
 #define NN_TOTAL_SIZE (W1_SIZE + B1_SIZE + W2_SIZE + B2_SIZE)
 
+// RecognizerANNXX.dat: 16-byte header ("NNDT", format, flags, parent version, reserved, then the
+// input/hidden/output neuron counts), followed by W1, B1, W2 and B2. Format 1 stores the sections
+// raw; format 2 gives each one a 5-byte header (coding, 32-bit coded length).
+#define NN_FILE_HEADER_SIZE 16
+#define NN_FILE_V1 1
+#define NN_FILE_V2 2
+#define NN_FILE_FLAG_DELTA 0x01       // sections hold residuals to add to the parent version's weights
+#define NN_SECTION_HEADER_SIZE 5
+#define NN_CODING_STORED 0
+#define NN_CODING_RLE 1               // PackBits: 0-127 = n + 1 literal bytes, 128-255 = next byte n - 126 times
+#define NN_DELTA_MAX_PERCENT 50       // a delta above this share of the keyframe size starts a new keyframe
+
+// Delta uploads compare the weights in 128-byte pages (the page transfer chunk size)
+#define STAGE2_NN_PAGE_SIZE 128
+#define STAGE2_NN_PAGES(size) (((size) + STAGE2_NN_PAGE_SIZE - 1) / STAGE2_NN_PAGE_SIZE)
+#define STAGE2_NN_PAGE_COUNT \
+    (STAGE2_NN_PAGES(W1_SIZE) + STAGE2_NN_PAGES(B1_SIZE) + STAGE2_NN_PAGES(W2_SIZE) + STAGE2_NN_PAGES(B2_SIZE))
+
+// Page hashes of the weights a beam holds: set by every upload and by reading the weights back,
+// cleared by backprop and by failed uploads.
+typedef struct {
+    bool valid;
+    uint32_t page_hash[STAGE2_NN_PAGE_COUNT];
+} stage2_nn_manifest_t;
+
+// One RecognizerANNXX.dat file being decoded a section at a time.
+typedef struct {
+    FIL file;
+    uint8_t version;        // NN_FILE_V1 or NN_FILE_V2
+    uint8_t flags;          // NN_FILE_FLAG_*
+    uint8_t parent;         // parent version of a delta file
+    uint8_t coding;         // NN_CODING_* of the current section
+    uint32_t coded_left;    // bytes of the current section not read from the file yet
+    bool run_literal;       // PackBits run being expanded: literal bytes or a repeat of run_value
+    uint8_t run_value;
+    uint8_t run_left;
+    uint8_t in[64];
+    uint16_t in_pos;
+    uint16_t in_len;
+} nn_stream_t;
+
+// An ANN file and, for a delta file, the keyframe its residuals apply to.
+typedef struct {
+    nn_stream_t file;
+    nn_stream_t parent;
+} stage2_nn_reader_t;
+
 // ==============================
 // Training configuration
 // ==============================
@@ -288,12 +689,60 @@ static uint16_t training_word_count = 0;
 static uint16_t training_word_index = 0;
 static bool training_words_loaded = false;
 
+// Phrases.ac cursor. A match is held back until no longer match from the same start can
+// still arrive, so "in" is not emitted while "inside" is in progress. Matches never overlap, and
+// only a match that starts where the emitted ones end is emitted, so "in" inside an unknown word is not.
+typedef struct {
+    uint32_t state;
+    uint16_t pos;          // phonemes fed since the last silence
+    uint16_t floor;        // first position a new match may start at (after the last released one)
+    uint16_t covered;      // phonemes from the last silence covered by emitted matches without a gap
+    uint32_t pending;      // pattern index + 1 of the held match, 0 = none
+    uint16_t pending_start;
+    uint16_t pending_end;
+    uint16_t hits;         // matches emitted since the last silence
+} phrase_cursor_t;
+
 typedef struct {
-    uint8_t seq[PHONEME_SEQ_LEN];
+    uint8_t seq[PHONEME_SEQ_MAX];
     uint8_t count;
+    bool overflow;       // more than PHONEME_SEQ_MAX phonemes before silence; no lookup for this word
+    uint32_t trie_node;  // Dictionary.trie cursor, DICT_TRIE_NONE once the prefix left the trie
+    bool emitted;        // word already sent early; swallow phonemes until silence
+    phrase_cursor_t phrase;
 } beam_seq_t;
 
 static beam_seq_t beam_sequences[STAGE2_COUNT];
+static stage2_fifo_stats_t stage2_fifo[STAGE2_COUNT];
+// STAGE2_REG_CAPS of each beam, read on first use and again by every FIFO capability probe
+static uint8_t stage2_caps[STAGE2_COUNT];
+static bool stage2_caps_known[STAGE2_COUNT];
+static stage2_nn_upload_stats_t stage2_nn_upload_stats;
+static stage2_nn_manifest_t stage2_nn_manifests[STAGE2_COUNT];
+// Weights of the ANN being saved, loaded or uploaded, with their page hashes. Those run one at a
+// time on core 0, and 24 KB would not fit on either core's stack.
+static struct {
+    uint8_t weights[NN_TOTAL_SIZE];
+    uint32_t hash[STAGE2_NN_PAGE_COUNT];
+    stage2_nn_reader_t reader;
+} stage2_nn_work;
+// Single-producer/single-consumer ring on core 1: the GPIO interrupt (or the acquisition loop with
+// interrupts off) advances head, the acquisition loop advances tail.
+static stage2_ready_event_t stage2_ready_queue[STAGE2_READY_QUEUE_SIZE];
+static volatile uint32_t stage2_ready_head = 0;
+static volatile uint32_t stage2_ready_tail = 0;
+static volatile bool stage2_ready_queued[STAGE2_COUNT];
+static volatile uint32_t stage2_ready_overflows = 0;
+static stage2_drain_t stage2_drain[STAGE2_COUNT];
+// Single producer (core 1) / single consumer (core 0)
+static stage2_entry_record_t stage2_entry_ring[STAGE2_ENTRY_RING_SIZE];
+static volatile uint32_t stage2_entry_head = 0;
+static volatile uint32_t stage2_entry_tail = 0;
+static uint32_t stage2_entry_reserved = 0;  // ring slots promised to reads on the bus (core 1)
+static stage2_entry_ring_stats_t stage2_entry_stats;
+static volatile bool stage2_acquisition_paused = false;
+static volatile bool core1_running = false;
+static uint32_t core1_stack[CORE1_STACK_BYTES / sizeof(uint32_t)];
 
 // ==============================
 // Output helpers
@@ -327,35 +776,510 @@ static void output_send_line(const char *line) {
     }
 }
 
+// ==============================
+// I2C transaction engine
+// ==============================
+// One ring per bus class; only one descriptor is on the bus at a time.
+static i2c_async_ring_t i2c_async_rings[I2C_CLASS_COUNT];
+static i2c_async_desc_t *volatile i2c_async_active = NULL;
+static volatile bool i2c_async_aborted = false;
+static uint32_t i2c_async_started_us = 0;
+static uint32_t i2c_async_deadline_us = 0;
+static bool i2c_async_in_tick = false;
+static uint32_t i2c_async_cmds[I2C_ASYNC_MAX_CMDS];
+static int i2c_async_tx_chan = -1;
+static int i2c_async_rx_chan = -1;
+static dma_channel_config i2c_async_tx_cfg;
+static dma_channel_config i2c_async_rx_cfg;
+static i2c_async_stats_t i2c_async_stats;
+// Guards the queues and the controller: descriptors are submitted from both cores and completed
+// by the interrupt on core 1.
+static spin_lock_t *i2c_async_lock = NULL;
+
+static const char *const i2c_class_names[I2C_CLASS_COUNT] = {"realtime", "training", "ui"};
+
+// Stage 2 beams 0x60-0x64 and Stage 4 at 0x65; other addresses run at I2C_UI_BAUD.
+#define I2C_DEVICE_COUNT (STAGE2_COUNT + 1)
+#define I2C_SPEED_TIER_COUNT 3
+#define I2C_SPEED_DEFAULT_TIER 1
+static const uint32_t i2c_speed_tiers[I2C_SPEED_TIER_COUNT] = {1000000, I2C_STAGE2_BAUD, 100000};
+static i2c_device_t i2c_devices[I2C_DEVICE_COUNT];
+static uint32_t i2c_async_baud = I2C_STAGE2_BAUD;  // clock the controller is set to
+
+static void i2c_async_tick(void);
+
+// Callbacks and deadline checks run on core 1 once it is up; core 0 only submits and waits.
+static bool i2c_async_ticks_here(void) {
+    return !core1_running || get_core_num() == 1;
+}
+
+static uint16_t i2c_async_length(const i2c_async_desc_t *desc) {
+    return (uint16_t)(desc->header_len + desc->tx_len + desc->rx_len);
+}
+
+static i2c_device_t *i2c_device(uint8_t addr) {
+    if (addr < STAGE2_BASE_ADDR || addr >= STAGE2_BASE_ADDR + I2C_DEVICE_COUNT) return NULL;
+    return &i2c_devices[addr - STAGE2_BASE_ADDR];
+}
+
+// Switches the controller clock to the device's rate; only between transfers. Group writes run
+// at the rate of the slowest Stage 2 beam.
+static void i2c_async_set_clock(uint8_t addr) {
+    const i2c_device_t *dev = i2c_device(addr);
+    uint32_t baud = dev ? i2c_speed_tiers[dev->tier] : I2C_UI_BAUD;
+    if (addr == STAGE2_GROUP_ADDR) {
+        uint8_t tier = 0;
+        for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+            if (i2c_devices[i].tier > tier) tier = i2c_devices[i].tier;
+        }
+        baud = i2c_speed_tiers[tier];
+    }
+    if (baud == i2c_async_baud) return;
+    i2c_set_baudrate(I2C_STAGE2_PORT, baud);
+    i2c_async_baud = baud;
+}
+
+// Failures raise the device's error score and successes wear it down; a device that keeps
+// failing drops to the next slower tier. A run of failures starts a backoff, doubled by every
+// failed poll after it; one success makes the device healthy again.
+static void i2c_device_account(uint8_t addr, bool ok) {
+    i2c_device_t *dev = i2c_device(addr);
+    if (!dev) return;
+    dev->transfers++;
+    if (ok) {
+        if (dev->error_score) dev->error_score--;
+        dev->fail_run = 0;
+        dev->backoff_ms = 0;
+        return;
+    }
+    dev->errors++;
+    // A beam that stops answering may have browned out and lost its weights; its next ANN load
+    // is sent whole
+    if (addr < STAGE2_BASE_ADDR + STAGE2_COUNT) stage2_nn_manifests[addr - STAGE2_BASE_ADDR].valid = false;
+    dev->error_score = (uint16_t)(dev->error_score + I2C_SPEED_ERROR_WEIGHT);
+    if (dev->error_score >= I2C_SPEED_ERROR_LIMIT && dev->tier + 1 < I2C_SPEED_TIER_COUNT) {
+        dev->tier++;
+        dev->downgrades++;
+        dev->error_score = 0;
+    }
+    if (dev->fail_run < 255) dev->fail_run++;
+    if (dev->fail_run >= I2C_HEALTH_FAIL_LIMIT) {
+        dev->backoff_ms = dev->backoff_ms ? dev->backoff_ms * 2 : I2C_BACKOFF_MIN_MS;
+        if (dev->backoff_ms > I2C_BACKOFF_MAX_MS) dev->backoff_ms = I2C_BACKOFF_MAX_MS;
+        dev->retry_us = time_us_32() + dev->backoff_ms * 1000u;
+    }
+}
+
+// Probe failures at too high a clock say nothing about the device at its final one.
+static void i2c_device_reset_health(i2c_device_t *dev) {
+    dev->error_score = 0;
+    dev->fail_run = 0;
+    dev->backoff_ms = 0;
+}
+
+// True while a failing device waits for its next poll.
+static bool i2c_device_backing_off(uint8_t addr) {
+    const i2c_device_t *dev = i2c_device(addr);
+    return dev && dev->backoff_ms && (int32_t)(time_us_32() - dev->retry_us) < 0;
+}
+
+// Deadline of one transfer: nine bit times per byte, four times over, plus a fixed margin for
+// clock stretching.
+static uint32_t i2c_async_timeout_us(uint16_t bytes) {
+    return I2C_ASYNC_TIMEOUT_MIN_US + (uint32_t)((uint64_t)bytes * 36000000u / i2c_async_baud);
+}
+
+// A device stopped mid-byte can hold SDA low for good. Clocks SCL by hand (open drain through the
+// pin direction) until SDA is released, at most nine times, then sends a STOP.
+static void i2c_bus_recover(void) {
+    if (gpio_get(I2C_STAGE2_SDA) && gpio_get(I2C_STAGE2_SCL)) return;
+
+    gpio_put(I2C_STAGE2_SDA, 0);
+    gpio_put(I2C_STAGE2_SCL, 0);
+    gpio_set_dir(I2C_STAGE2_SDA, GPIO_IN);
+    gpio_set_dir(I2C_STAGE2_SCL, GPIO_IN);
+    gpio_set_function(I2C_STAGE2_SDA, GPIO_FUNC_SIO);
+    gpio_set_function(I2C_STAGE2_SCL, GPIO_FUNC_SIO);
+    for (int i = 0; i < 9 && !gpio_get(I2C_STAGE2_SDA); i++) {
+        gpio_set_dir(I2C_STAGE2_SCL, GPIO_OUT);
+        busy_wait_us_32(5);
+        gpio_set_dir(I2C_STAGE2_SCL, GPIO_IN);
+        busy_wait_us_32(5);
+    }
+    gpio_set_dir(I2C_STAGE2_SCL, GPIO_OUT);
+    busy_wait_us_32(5);
+    gpio_set_dir(I2C_STAGE2_SDA, GPIO_OUT);
+    busy_wait_us_32(5);
+    gpio_set_dir(I2C_STAGE2_SCL, GPIO_IN);
+    busy_wait_us_32(5);
+    gpio_set_dir(I2C_STAGE2_SDA, GPIO_IN);
+    busy_wait_us_32(5);
+    gpio_set_function(I2C_STAGE2_SDA, GPIO_FUNC_I2C);
+    gpio_set_function(I2C_STAGE2_SCL, GPIO_FUNC_I2C);
+    i2c_async_stats.recoveries++;
+}
+
+// Bytes of the next bus transfer of a descriptor: the whole of it, or the next slice.
+static uint16_t i2c_async_run_length(const i2c_async_desc_t *desc) {
+    if (!desc->sliced) return i2c_async_length(desc);
+    uint16_t left = (uint16_t)(desc->tx_len - desc->tx_done);
+    return left > I2C_UI_SLICE_BYTES ? I2C_UI_SLICE_BYTES : left;
+}
+
+static void i2c_async_complete(i2c_async_desc_t *desc, bool ok) {
+    if (!ok) {
+        i2c_async_stats.failures++;
+        if (desc->group) desc->group->failed = true;
+    }
+    i2c_async_ring_t *ring = &i2c_async_rings[desc->bus_class];
+    i2c_async_stats.cls[desc->bus_class].transactions++;
+    desc->state = ok ? I2C_ASYNC_DONE : I2C_ASYNC_FAILED;
+    i2c_async_active = NULL;
+    __mem_fence_release();
+    ring->tail = ring->tail + 1;
+}
+
+// Accounts a transfer that has left the bus. A sliced descriptor with bytes left goes back to
+// the head of its queue, behind any higher class that has work.
+static void i2c_async_finish(i2c_async_desc_t *desc, bool ok) {
+    i2c_class_stats_t *stats = &i2c_async_stats.cls[desc->bus_class];
+    uint16_t run = i2c_async_run_length(desc);
+    stats->busy_us += time_us_32() - i2c_async_started_us;
+    stats->bytes += run;
+    i2c_device_account(desc->addr, ok);
+    if (ok && desc->sliced && desc->tx_done + run < desc->tx_len) {
+        desc->tx_done = (uint16_t)(desc->tx_done + run);
+        desc->state = I2C_ASYNC_QUEUED;
+        stats->slices++;
+        i2c_async_active = NULL;
+        return;
+    }
+    i2c_async_complete(desc, ok);
+}
+
+// Returns the SDK result of the transfer: its length, PICO_ERROR_TIMEOUT or another error.
+static int i2c_async_run_blocking(const i2c_async_desc_t *desc) {
+    i2c_async_set_clock(desc->addr);
+    if (desc->sliced) {
+        uint16_t run = i2c_async_run_length(desc);
+        return i2c_write_timeout_us(
+            I2C_STAGE2_PORT, desc->addr, desc->tx + desc->tx_done, run, false, i2c_async_timeout_us(run));
+    }
+
+    uint8_t buf[I2C_ASYNC_MAX_CMDS];
+    uint16_t len = desc->header_len;
+    memcpy(buf, desc->header, desc->header_len);
+    if (desc->tx_len) memcpy(&buf[len], desc->tx, desc->tx_len);
+    len = (uint16_t)(len + desc->tx_len);
+
+    bool read = desc->rx_len > 0;
+    if (len) {
+        int result = i2c_write_timeout_us(I2C_STAGE2_PORT, desc->addr, buf, len, read, i2c_async_timeout_us(len));
+        if (result != len || !read) return result;
+    }
+    return i2c_read_timeout_us(
+        I2C_STAGE2_PORT, desc->addr, desc->rx, desc->rx_len, false, i2c_async_timeout_us(desc->rx_len));
+}
+
+// Queues the command words (data, or read requests from the first rx byte on) and lets DMA feed
+// them; the interrupt sees STOP_DET when the bus is done.
+static void i2c_async_start_dma(i2c_async_desc_t *desc) {
+    i2c_hw_t *hw = i2c_get_hw(I2C_STAGE2_PORT);
+    uint16_t n = 0;
+    if (desc->sliced) {
+        uint16_t run = i2c_async_run_length(desc);
+        for (uint16_t i = 0; i < run; i++) i2c_async_cmds[n++] = desc->tx[desc->tx_done + i];
+    } else {
+        for (uint8_t i = 0; i < desc->header_len; i++) i2c_async_cmds[n++] = desc->header[i];
+        for (uint16_t i = 0; i < desc->tx_len; i++) i2c_async_cmds[n++] = desc->tx[i];
+        for (uint16_t i = 0; i < desc->rx_len; i++) {
+            uint32_t cmd = I2C_IC_DATA_CMD_CMD_BITS;
+            if (i == 0 && n > 0) cmd |= I2C_IC_DATA_CMD_RESTART_BITS;
+            i2c_async_cmds[n++] = cmd;
+        }
+    }
+    i2c_async_cmds[n - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    i2c_async_set_clock(desc->addr);
+    hw->enable = 0;
+    hw->tar = desc->addr;
+    hw->enable = 1;
+    (void)hw->clr_tx_abrt;
+    (void)hw->clr_stop_det;
+    i2c_async_aborted = false;
+
+    i2c_async_deadline_us = time_us_32() + i2c_async_timeout_us(n);
+    if (desc->rx_len) {
+        dma_channel_configure((uint)i2c_async_rx_chan, &i2c_async_rx_cfg, desc->rx, &hw->data_cmd, desc->rx_len, true);
+    }
+    dma_channel_configure((uint)i2c_async_tx_chan, &i2c_async_tx_cfg, &hw->data_cmd, i2c_async_cmds, n, true);
+}
+
+// Called with i2c_async_lock held. Picks the head of the highest class with work; with DMA it is
+// started here, in blocking mode it is returned for the caller to run outside the lock.
+static i2c_async_desc_t *i2c_async_claim_next(void) {
+    while (!i2c_async_active) {
+        i2c_async_ring_t *ring = NULL;
+        for (int c = 0; c < I2C_CLASS_COUNT && !ring; c++) {
+            if (i2c_async_rings[c].tail != i2c_async_rings[c].head) ring = &i2c_async_rings[c];
+        }
+        if (!ring) return NULL;
+
+        __mem_fence_acquire();
+        i2c_async_desc_t *desc = ring->queue[ring->tail & (I2C_ASYNC_QUEUE_SIZE - 1)];
+        i2c_async_active = desc;
+        desc->state = I2C_ASYNC_ACTIVE;
+        i2c_async_started_us = time_us_32();
+
+        if (desc->group && desc->group->failed) {
+            i2c_async_complete(desc, false);
+        } else if (i2c_device_backing_off(desc->addr)) {
+            i2c_device(desc->addr)->skipped++;
+            i2c_async_complete(desc, false);
+        } else if (i2c_async_stats.dma) {
+            i2c_async_start_dma(desc);
+            return NULL;
+        } else {
+            return desc;
+        }
+    }
+    return NULL;
+}
+
+// Starts queued work and releases i2c_async_lock. A blocking-mode caller keeps running
+// descriptors (its own and the other core's) until the queues are empty.
+static void i2c_async_pump(uint32_t lock_state) {
+    i2c_async_desc_t *desc = i2c_async_claim_next();
+    while (desc) {
+        spin_unlock(i2c_async_lock, lock_state);
+        int result = i2c_async_run_blocking(desc);
+        if (result == PICO_ERROR_TIMEOUT) i2c_bus_recover();
+        lock_state = spin_lock_blocking(i2c_async_lock);
+        if (result == PICO_ERROR_TIMEOUT) i2c_async_stats.timeouts++;
+        i2c_async_finish(desc, result >= 0);
+        desc = i2c_async_claim_next();
+    }
+    spin_unlock(i2c_async_lock, lock_state);
+}
+
+static void i2c_async_irq(void) {
+    i2c_hw_t *hw = i2c_get_hw(I2C_STAGE2_PORT);
+    uint32_t lock_state = spin_lock_blocking(i2c_async_lock);
+    uint32_t raw = hw->raw_intr_stat;
+    if (raw & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        // Clearing the abort releases the flushed TX FIFO; stop the DMA first, or the rest of the
+        // command words would go out as a new transaction (e.g. a page write at the wrong offset).
+        dma_channel_abort((uint)i2c_async_tx_chan);
+        dma_channel_abort((uint)i2c_async_rx_chan);
+        i2c_async_aborted = true;
+        (void)hw->clr_tx_abrt;
+    }
+    i2c_async_desc_t *desc = i2c_async_active;
+    if (!(raw & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS) || !desc) {
+        // Abort without its STOP yet, or the STOP of a transfer that already timed out
+        if (raw & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS) (void)hw->clr_stop_det;
+        spin_unlock(i2c_async_lock, lock_state);
+        return;
+    }
+    (void)hw->clr_stop_det;
+
+    bool ok = !i2c_async_aborted;
+    if (ok && desc->rx_len) {
+        // The last byte can still be on its way from the RX FIFO
+        for (int spin = 0; spin < 100 && dma_channel_is_busy((uint)i2c_async_rx_chan); spin++) {
+            tight_loop_contents();
+        }
+        ok = !dma_channel_is_busy((uint)i2c_async_rx_chan);
+    }
+    if (!ok) {
+        dma_channel_abort((uint)i2c_async_tx_chan);
+        dma_channel_abort((uint)i2c_async_rx_chan);
+    }
+    i2c_async_finish(desc, ok);
+    i2c_async_claim_next();
+    spin_unlock(i2c_async_lock, lock_state);
+}
+
+// Runs on core 1, so the I2C interrupt is taken there.
+static void i2c_async_init(void) {
+    i2c_async_tx_chan = dma_claim_unused_channel(false);
+    i2c_async_rx_chan = dma_claim_unused_channel(false);
+    if (i2c_async_tx_chan < 0 || i2c_async_rx_chan < 0) {
+        if (i2c_async_tx_chan >= 0) dma_channel_unclaim((uint)i2c_async_tx_chan);
+        if (i2c_async_rx_chan >= 0) dma_channel_unclaim((uint)i2c_async_rx_chan);
+        i2c_async_stats.dma = false;
+        printf("WARNING: No free DMA channels; I2C transfers are blocking\n");
+        return;
+    }
+
+    i2c_hw_t *hw = i2c_get_hw(I2C_STAGE2_PORT);
+    i2c_async_tx_cfg = dma_channel_get_default_config((uint)i2c_async_tx_chan);
+    channel_config_set_transfer_data_size(&i2c_async_tx_cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&i2c_async_tx_cfg, true);
+    channel_config_set_write_increment(&i2c_async_tx_cfg, false);
+    channel_config_set_dreq(&i2c_async_tx_cfg, i2c_get_dreq(I2C_STAGE2_PORT, true));
+
+    i2c_async_rx_cfg = dma_channel_get_default_config((uint)i2c_async_rx_chan);
+    channel_config_set_transfer_data_size(&i2c_async_rx_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&i2c_async_rx_cfg, false);
+    channel_config_set_write_increment(&i2c_async_rx_cfg, true);
+    channel_config_set_dreq(&i2c_async_rx_cfg, i2c_get_dreq(I2C_STAGE2_PORT, false));
+
+    hw->dma_tdlr = 4;
+    hw->dma_rdlr = 0;
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+    irq_set_exclusive_handler(I2C_STAGE2_IRQ, i2c_async_irq);
+    irq_set_enabled(I2C_STAGE2_IRQ, true);
+    i2c_async_stats.dma = true;
+}
+
+// Returns false if the descriptor cannot be queued (too long, or its class queue is full while a
+// completion callback is running).
+static bool i2c_async_submit(i2c_async_desc_t *desc) {
+    if (desc->header_len || desc->rx_len) desc->sliced = false;
+    desc->tx_done = 0;
+    uint16_t len = i2c_async_length(desc);
+    if (len == 0 || (!desc->sliced && len > I2C_ASYNC_MAX_CMDS) || desc->header_len > I2C_ASYNC_HEADER_MAX ||
+        desc->bus_class >= I2C_CLASS_COUNT) {
+        desc->state = I2C_ASYNC_FAILED;
+        return false;
+    }
+    i2c_async_ring_t *ring = &i2c_async_rings[desc->bus_class];
+    uint32_t lock_state = spin_lock_blocking(i2c_async_lock);
+    while (ring->head - ring->retire >= I2C_ASYNC_QUEUE_SIZE) {
+        spin_unlock(i2c_async_lock, lock_state);
+        if (i2c_async_in_tick && i2c_async_ticks_here()) {
+            desc->state = I2C_ASYNC_FAILED;
+            return false;
+        }
+        i2c_async_tick();
+        lock_state = spin_lock_blocking(i2c_async_lock);
+    }
+
+    desc->state = I2C_ASYNC_QUEUED;
+    uint32_t head = ring->head;
+    ring->queue[head & (I2C_ASYNC_QUEUE_SIZE - 1)] = desc;
+    ring->callbacks[head & (I2C_ASYNC_QUEUE_SIZE - 1)] = desc->done;
+    __mem_fence_release();
+    ring->head = head + 1;
+    i2c_class_stats_t *stats = &i2c_async_stats.cls[desc->bus_class];
+    if (head + 1 - ring->tail > stats->queue_max) stats->queue_max = head + 1 - ring->tail;
+    i2c_async_pump(lock_state);
+    return true;
+}
+
+// Aborts a transfer that overran its deadline, then runs the callbacks of finished descriptors,
+// in submission order within each class. Callbacks may submit more work; nested ticks only
+// check the deadline.
+static void i2c_async_tick(void) {
+    if (!i2c_async_ticks_here()) return;
+
+    if (i2c_async_stats.dma && i2c_async_active) {
+        uint32_t lock_state = spin_lock_blocking(i2c_async_lock);
+        i2c_async_desc_t *desc = i2c_async_active;
+        if (desc && (int32_t)(time_us_32() - i2c_async_deadline_us) > 0) {
+            i2c_hw_t *hw = i2c_get_hw(I2C_STAGE2_PORT);
+            dma_channel_abort((uint)i2c_async_tx_chan);
+            dma_channel_abort((uint)i2c_async_rx_chan);
+            hw->enable |= I2C_IC_ENABLE_ABORT_BITS;
+            // Let the abort's STOP go out before the next transfer clears STOP_DET; a bus that is
+            // held low never finishes it until i2c_bus_recover() has freed SDA.
+            for (int spin = 0; spin < 1000 && (hw->enable & I2C_IC_ENABLE_ABORT_BITS); spin++) {
+                tight_loop_contents();
+            }
+            (void)hw->clr_tx_abrt;
+            (void)hw->clr_stop_det;
+            i2c_bus_recover();
+            i2c_async_stats.timeouts++;
+            i2c_async_finish(desc, false);
+            i2c_async_claim_next();
+        }
+        spin_unlock(i2c_async_lock, lock_state);
+    }
+
+    if (i2c_async_in_tick) return;
+    i2c_async_in_tick = true;
+    for (int c = 0; c < I2C_CLASS_COUNT; c++) {
+        i2c_async_ring_t *ring = &i2c_async_rings[c];
+        while (ring->retire != ring->tail) {
+            __mem_fence_acquire();
+            uint32_t slot = ring->retire & (I2C_ASYNC_QUEUE_SIZE - 1);
+            i2c_async_desc_t *desc = ring->queue[slot];
+            i2c_async_callback_t done = ring->callbacks[slot];
+            ring->retire++;
+            if (done) done(desc);
+        }
+    }
+    i2c_async_in_tick = false;
+}
+
+static bool i2c_async_wait(i2c_async_desc_t *desc) {
+    while (desc->state == I2C_ASYNC_QUEUED || desc->state == I2C_ASYNC_ACTIVE) {
+        i2c_async_tick();
+        tight_loop_contents();
+    }
+    return desc->state == I2C_ASYNC_DONE;
+}
+
+// Synchronous write and/or read through the queue of the given class.
+static bool i2c_transfer(uint8_t addr,
+                         i2c_bus_class_t bus_class,
+                         const uint8_t *tx,
+                         uint16_t tx_len,
+                         uint8_t *rx,
+                         uint16_t rx_len) {
+    i2c_async_desc_t desc = {
+        .addr = addr, .bus_class = (uint8_t)bus_class, .tx = tx, .tx_len = tx_len, .rx = rx, .rx_len = rx_len};
+    if (!i2c_async_submit(&desc)) return false;
+    return i2c_async_wait(&desc);
+}
+
 // ==============================
 // LCD helpers
 // ==============================
-static void lcd_i2c_write(uint8_t data) {
-    uint8_t buf = (uint8_t)(data | LCD_BACKLIGHT);
-    i2c_write_blocking(LCD_I2C_PORT, LCD_I2C_ADDR, &buf, 1, false);
+// Every nibble is two PCF8574 writes: EN high with the data, then EN low to latch it. At the
+// bus rate one write outlasts the minimum EN pulse, and the four writes of a character outlast
+// the controller's 37 us execution time, so a whole run of characters goes out as one stream.
+static uint16_t lcd_encode_nibble(uint8_t *out, uint8_t nibble, bool rs) {
+    uint8_t data = (uint8_t)((nibble << 4) | (rs ? LCD_RS : 0) | LCD_BACKLIGHT);
+    out[0] = (uint8_t)(data | LCD_EN);
+    out[1] = (uint8_t)(data & ~LCD_EN);
+    return 2;
 }
 
-static void lcd_pulse_enable(uint8_t data) {
-    lcd_i2c_write((uint8_t)(data | LCD_EN));
-    sleep_us(1);
-    lcd_i2c_write((uint8_t)(data & ~LCD_EN));
-    sleep_us(50);
+// Sent as one sliced UI descriptor: FIFO drains and training transfers get the bus between slices.
+static void lcd_i2c_stream(const uint8_t *buf, uint16_t len) {
+    i2c_async_desc_t desc = {
+        .addr = LCD_I2C_ADDR, .bus_class = I2C_CLASS_UI, .sliced = true, .tx = buf, .tx_len = len};
+    if (i2c_async_submit(&desc)) i2c_async_wait(&desc);
 }
 
 static void lcd_write4(uint8_t nibble, bool rs) {
-    uint8_t data = (uint8_t)((nibble << 4) | (rs ? LCD_RS : 0));
-    lcd_pulse_enable(data);
+    uint8_t buf[2];
+    lcd_i2c_stream(buf, lcd_encode_nibble(buf, nibble, rs));
+    sleep_us(50);
 }
 
-static void lcd_command(uint8_t cmd) {
-    lcd_write4((uint8_t)(cmd >> 4), false);
-    lcd_write4((uint8_t)(cmd & 0x0F), false);
-    sleep_us(50);
+static void lcd_write_bytes(const char *bytes, size_t count, bool rs) {
+    uint8_t buf[20 * 4];
+    while (count > 0) {
+        size_t chunk = count > 20 ? 20 : count;
+        uint16_t len = 0;
+        for (size_t i = 0; i < chunk; i++) {
+            uint8_t c = (uint8_t)bytes[i];
+            len = (uint16_t)(len + lcd_encode_nibble(&buf[len], (uint8_t)(c >> 4), rs));
+            len = (uint16_t)(len + lcd_encode_nibble(&buf[len], (uint8_t)(c & 0x0F), rs));
+        }
+        lcd_i2c_stream(buf, len);
+        bytes += chunk;
+        count -= chunk;
+    }
 }
 
-static void lcd_write_char(char c) {
-    lcd_write4((uint8_t)(c >> 4), true);
-    lcd_write4((uint8_t)(c & 0x0F), true);
+static void lcd_command(uint8_t cmd) {
+    lcd_write_bytes((const char *)&cmd, 1, false);
+    sleep_us(50);
 }
 
 static void lcd_clear(void) {
@@ -369,9 +1293,7 @@ static void lcd_set_cursor(uint8_t col, uint8_t row) {
 }
 
 static void lcd_print(const char *s) {
-    while (*s) {
-        lcd_write_char(*s++);
-    }
+    lcd_write_bytes(s, strlen(s), true);
 }
 
 static void lcd_init(void) {
@@ -485,12 +1407,12 @@ static int strcasecmp_local(const char *a, const char *b) {
 // ==============================
 static uint8_t keypad_read_raw(void) {
     uint8_t data = 0xFF;
-    i2c_read_blocking(KEYPAD_I2C_PORT, KEYPAD_I2C_ADDR, &data, 1, false);
+    if (!i2c_transfer(KEYPAD_I2C_ADDR, I2C_CLASS_UI, NULL, 0, &data, 1)) data = 0xFF;
     return data;
 }
 
 static void keypad_write(uint8_t value) {
-    i2c_write_blocking(KEYPAD_I2C_PORT, KEYPAD_I2C_ADDR, &value, 1, false);
+    i2c_transfer(KEYPAD_I2C_ADDR, I2C_CLASS_UI, &value, 1, NULL, 0);
 }
 
 static char keypad_get_key(void) {
@@ -684,8 +1606,9 @@ static bool language_name_from_index(uint8_t index, char *name_out, size_t name_
         if (!language_parse_line(line, &parsed_id, parsed_name, sizeof(parsed_name))) continue;
         if (parsed_id != index) continue;
 
-        strncpy(name_out, parsed_name, name_out_len - 1);
-        name_out[name_out_len - 1] = '\0';
+        size_t name_len = strnlen(parsed_name, name_out_len - 1);
+        memcpy(name_out, parsed_name, name_len);
+        name_out[name_len] = '\0';
         found = true;
         break;
     }
@@ -956,7 +1879,7 @@ static void menu_render_add_user(void) {
     lcd_print_padded_line(2, line2);
 
     char line3[21];
-    snprintf(line3, sizeof(line3), "Language: %s", add_user_language);
+    snprintf(line3, sizeof(line3), "Language: %.10s", add_user_language);
     lcd_print_padded_line(3, line3);
 }
 
@@ -985,7 +1908,7 @@ static void menu_render_unrec_select(void) {
     for (uint8_t i = 0; i < 3; i++) {
         char line[21];
         if (i < unrec_preview_count) {
-            snprintf(line, sizeof(line), "%u:%s", (unsigned)(i + 1), unrec_preview[i]);
+            snprintf(line, sizeof(line), "%u:%.18s", (unsigned)(i + 1), unrec_preview[i]);
         } else {
             snprintf(line, sizeof(line), "%u:<empty>", (unsigned)(i + 1));
         }
@@ -1040,8 +1963,9 @@ static bool load_training_words_from_file(const char *path) {
         line[l] = '\0';
         if (line[0] == '\0' || line[0] == '#') continue;
 
-        strncpy(training_words[training_word_count], line, DICT_WORD_SIZE);
-        training_words[training_word_count][DICT_WORD_SIZE] = '\0';
+        if (l > DICT_WORD_SIZE) l = DICT_WORD_SIZE;
+        memcpy(training_words[training_word_count], line, l);
+        training_words[training_word_count][l] = '\0';
         training_word_count++;
     }
 
@@ -1054,8 +1978,9 @@ static bool training_words_load_for_current_user(void) {
 
     char lang_name[LANG_NAME_SIZE + 1] = "English";
     if (current_user.language[0] != '\0') {
-        strncpy(lang_name, current_user.language, sizeof(lang_name) - 1);
-        lang_name[sizeof(lang_name) - 1] = '\0';
+        size_t lang_len = strnlen(current_user.language, sizeof(lang_name) - 1);
+        memcpy(lang_name, current_user.language, lang_len);
+        lang_name[lang_len] = '\0';
     }
 
     char path[160];
@@ -1090,7 +2015,7 @@ static void menu_render_training_menu(void) {
         return;
     }
 
-    char line0[21];
+    char line0[32];  // lcd_print_padded_line() clips to 20 columns
     snprintf(line0, sizeof(line0), "Training Memnu %u/%u",
              (unsigned)(training_word_index + 1),
              (unsigned)training_word_count);
@@ -1116,14 +2041,226 @@ static void menu_render_training_menu(void) {
 // ==============================
 static FATFS fs;
 static FIL dict_file;
+static FIL dict_bin_file;
 static FIL newwords_file;
 static bool sd_ready = false;
 static bool dict_ready = false;
+static bool dict_bin_ready = false;
+static uint32_t dict_bin_record_count = 0;
+static uint32_t dict_bin_block_count = 0;
+static uint32_t dict_bin_payload_bytes = 0;  // packed keys + words, sizes the flash image
+
+typedef struct {
+    uint8_t lang;
+    uint32_t first_block;
+    uint32_t blocks;
+    uint32_t count;
+    uint16_t fill;  // build only: bytes used in the segment's last block
+} dict_bin_segment_t;
+
+static dict_bin_segment_t dict_bin_segments[DICT_BIN_MAX_SEGMENTS];
+static uint16_t dict_bin_segment_count = 0;
+
+typedef struct {
+    uint8_t lang;
+    uint32_t first_block;  // block index of the segment's first record
+    uint32_t blocks;
+    uint32_t count;
+} dict_xip_segment_t;
+
+typedef struct {
+    bool active;
+    uint8_t stamp[16];  // source header of the Dictionary.dat being copied
+    uint16_t segment;   // Dictionary.bin segment being copied
+    uint32_t block;     // Dictionary.bin block inside that segment
+    uint16_t pos;       // next record inside that block
+    uint32_t records;
+    uint32_t written;   // record bytes programmed so far
+    uint32_t fill;
+    uint32_t seg_first[DICT_BIN_MAX_SEGMENTS];  // first flash block of every segment copied so far
+    uint8_t page[FLASH_PAGE_SIZE];
+} dict_xip_sync_t;
+
+extern char __flash_binary_end;
+static bool dict_xip_ready = false;
+static uint32_t dict_xip_record_count = 0;
+static dict_xip_segment_t dict_xip_segments[DICT_BIN_MAX_SEGMENTS];
+static uint16_t dict_xip_segment_count = 0;
+static dict_xip_sync_t dict_xip_sync = {0};
+static uint32_t dict_xip_hits = 0;
+static uint32_t dict_xip_syncs = 0;
+static uint8_t dict_bin_block[DICT_BIN_BLOCK_SIZE];
+static uint32_t dict_bin_block_index = UINT32_MAX;
+static DWORD dict_clmt[DICT_CLMT_SIZE];
+static DWORD dict_bin_clmt[DICT_CLMT_SIZE];
+static FIL dict_trie_file;
+static bool dict_trie_ready = false;
+static uint32_t dict_trie_node_count = 0;
+static DWORD dict_trie_clmt[DICT_CLMT_SIZE];
+static FIL dict_widx_file;
+static bool dict_widx_ready = false;
+static uint32_t dict_widx_buckets = 0;
+static DWORD dict_widx_clmt[DICT_CLMT_SIZE];
+static FIL dict_phrase_file;
+static bool dict_phrase_ready = false;
+static uint32_t dict_phrase_node_count = 0;
+static uint32_t dict_phrase_edge_count = 0;
+static uint32_t dict_phrase_pattern_count = 0;
+static FSIZE_t dict_phrase_edge_base = 0;
+static FSIZE_t dict_phrase_pattern_base = 0;
+static FSIZE_t dict_phrase_text_base = 0;
+static DWORD dict_phrase_clmt[DICT_CLMT_SIZE];
+static uint8_t dict_build_scratch[DICT_BUILD_SCRATCH_BYTES];
+static uint8_t dict_fence_keys[DICT_FENCE_MAX][DICT_KEY_SIZE];
+static uint32_t dict_fence_count = 0;
+static uint32_t dict_fence_stride = 1;
+
+typedef struct {
+    uint32_t lookups;
+    uint32_t probes;
+    uint32_t block_reads;
+    uint32_t sector_reads;
+    uint32_t single_block_lookups;
+    uint32_t newwords_scans;
+    uint32_t newwords_skips;
+    uint32_t bloom_false_positives;
+    uint32_t primary_hits;       // resolved in the target language's segment
+    uint32_t fallback_searches;  // other-language segments searched after a primary miss
+    uint32_t fallback_hits;
+    uint16_t last_probes;
+    uint16_t last_block_reads;
+    uint16_t last_sector_reads;
+} dict_lookup_stats_t;
+
+static dict_lookup_stats_t dict_stats = {0};
+static uint16_t dict_lookup_probes = 0;
+static uint16_t dict_lookup_block_reads = 0;
+
+// Sector counter maintained by disk_read() in sd_driver.c.
+extern volatile uint32_t sd_sector_reads;
 static bool newwords_ready = false;
 static uint16_t unrecognised_counter = 0;
+static uint8_t dict_bloom_bits[DICT_BLOOM_BITS / 8];
+static uint32_t dict_bloom_entries = 0;
+static bool dict_bloom_ready = false;
+
+typedef struct {
+    uint8_t key[DICT_KEY_SIZE];
+    char word[DICT_WORD_SIZE + 1];
+} dict_newword_t;
+
+typedef struct {
+    uint32_t lookups;
+    uint32_t hits;
+    uint32_t probes;
+    uint16_t max_probe;
+    uint16_t max_insert_probe;
+} dict_newwords_stats_t;
+
+static dict_newword_t dict_newwords_pool[DICT_NEWWORDS_POOL];
+static uint16_t dict_newwords_slots[DICT_NEWWORDS_SLOTS];  // pool index + 1, 0 = empty
+static uint16_t dict_newwords_used = 0;
+static bool dict_newwords_complete = false;  // every NewWords.dat record is in the table
+static dict_newwords_stats_t dict_newwords_stats = {0};
+
+typedef struct {
+    uint8_t key[DICT_KEY_SIZE];
+    char word[DICT_WORD_SIZE + 1];
+    bool frozen;  // owned by the running (or interrupted) compaction
+} dict_mem_entry_t;
+
+// Sequential line reader: DICT_READER_BYTES per f_read() instead of one call per line.
+typedef struct {
+    FIL *file;
+    FSIZE_t offset;  // file offset of buf[0]
+    UINT pos;
+    UINT len;
+    bool eof;
+    bool error;     // f_read() failed; dict_reader_next() returned false before the end of the file
+    bool skipping;  // inside an over-long line, dropping it up to its '\n'
+    char buf[DICT_READER_BYTES];
+} dict_reader_t;
+
+typedef struct {
+    bool active;
+    FIL base;
+    FIL out;
+    dict_reader_t reader;
+    uint16_t mem_cursor;  // next memtable slot to merge; entries added after the start are skipped
+    bool base_valid;
+    uint8_t base_key[DICT_KEY_SIZE];
+    char base_word[DICT_WORD_SIZE + 1];
+    uint32_t written;
+} dict_compaction_t;
+
+static dict_mem_entry_t dict_memtable[DICT_MEMTABLE_MAX];
+static uint16_t dict_memtable_count = 0;
+static uint16_t dict_memtable_frozen = 0;
+static FIL dict_delta_file;
+static bool dict_delta_ready = false;
+static bool dict_lsm_ready = false;
+static dict_compaction_t dict_compaction = {0};
+static uint32_t dict_compactions = 0;
+static bool dict_install_pending = false;  // Dictionary.new committed but not swapped in yet
+static absolute_time_t dict_install_failed_at;
+
+typedef struct {
+    uint32_t attempts;
+    uint32_t hits;
+    uint32_t nodes;
+    uint32_t reads;
+    uint32_t truncated;
+} dict_approx_stats_t;
+
+static uint8_t dict_approx_sub_cost[DICT_APPROX_PHONEMES][DICT_APPROX_PHONEMES];
+static uint16_t dict_approx_max_cost = DICT_APPROX_MAX_COST;
+static dict_approx_stats_t dict_approx_stats = {0};
+
+typedef struct {
+    uint32_t steps;
+    uint32_t fail_steps;  // failure links followed
+    uint32_t reads;       // state/edge reads from Phrases.ac
+    uint32_t hits;
+    uint32_t phrase_hits; // hits spanning more than one word
+    uint32_t superseded;  // held matches replaced by a longer one from the same start
+    uint32_t dropped;     // final matches left to the silence lookup (after a gap, or a run-time word may follow)
+} dict_phrase_stats_t;
+
+static dict_phrase_stats_t dict_phrase_stats = {0};
+
+typedef struct {
+    uint32_t hash;       // dict_key_hash() of key, 0 = empty slot
+    uint32_t last_used;  // dict_cache_clock at the last hit or fill
+    uint32_t hits;
+    uint8_t key[DICT_KEY_SIZE];  // phoneme sequence + target language
+    uint8_t lang;                // language of the record the lookup resolved to
+    char word[DICT_WORD_SIZE + 1];
+} dict_cache_entry_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t invalidations;
+    uint16_t preloaded;
+    uint32_t saves;
+} dict_cache_stats_t;
+
+static dict_cache_entry_t dict_cache[DICT_CACHE_ENTRIES];
+static uint32_t dict_cache_clock = 0;
+static bool dict_cache_dirty = false;
+static dict_cache_stats_t dict_cache_stats = {0};
+// Language of the record that satisfied the last dict_resolve_word() call.
+static uint8_t dict_resolved_lang = LANG_UNKNOWN;
 
 static bool ensure_microsd_dir(void);
 static bool stage2_load_nn_from_sd(uint8_t addr, const char *path);
+static uint8_t stage2_load_nn_broadcast(const char *path, uint8_t beam_mask);
+static void stage2_nn_manifest_read_back(uint8_t addr, const uint8_t *weights);
+static bool stage2_nn_write_file(const char *path, uint8_t version, uint8_t *weights);
+static void handle_stage2_entry(uint8_t beam_idx, const stage2_entry_t *entry);
+static bool dict_parse_record_line(const char *line, uint8_t *key_out, char *word_out, size_t word_out_len);
+static size_t dict_format_record_line(const uint8_t *seq, uint8_t language_id, const char *word, char *line_out);
 
 static bool ensure_logs_dir(void) {
     if (!ensure_microsd_dir()) return false;
@@ -1311,63 +2448,203 @@ static bool user_lookup_name(uint8_t user_id, char *name_out, size_t name_out_le
     return found;
 }
 
+// Language ID of the current user, cached so lookups do not re-scan Language.dat.
+static uint8_t dict_target_language(void) {
+    static char cached_name[sizeof(current_user.language)] = {0};
+    static uint8_t cached_id = LANG_UNKNOWN;
+
+    if (!current_user.set || current_user.language[0] == '\0') return LANG_UNKNOWN;
+    if (strcmp(cached_name, current_user.language) != 0) {
+        cached_id = language_id_from_name(current_user.language);
+        strncpy(cached_name, current_user.language, sizeof(cached_name) - 1);
+        cached_name[sizeof(cached_name) - 1] = '\0';
+    }
+    return cached_id;
+}
+
+// ==============================
+// NewWords.dat Bloom filter
+// ==============================
+// FNV-1a over the zero-padded (sequence, language) key; the seed gives a second independent hash.
+static uint32_t dict_key_hash(const uint8_t *key, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (int i = 0; i < DICT_KEY_SIZE; i++) {
+        h ^= key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void dict_bloom_clear(void) {
+    memset(dict_bloom_bits, 0, sizeof(dict_bloom_bits));
+    dict_bloom_entries = 0;
+}
+
+// Bit positions are h1 + i*h2 (double hashing), so two hashes serve all DICT_BLOOM_HASHES probes.
+static void dict_bloom_add(const uint8_t *key) {
+    uint32_t h1 = dict_key_hash(key, 0);
+    uint32_t h2 = dict_key_hash(key, 0x9E3779B9u) | 1u;
+    for (uint32_t i = 0; i < DICT_BLOOM_HASHES; i++) {
+        uint32_t bit = (h1 + i * h2) % DICT_BLOOM_BITS;
+        dict_bloom_bits[bit >> 3] |= (uint8_t)(1u << (bit & 7));
+    }
+    dict_bloom_entries++;
+}
+
+static bool dict_bloom_may_contain(const uint8_t *key) {
+    uint32_t h1 = dict_key_hash(key, 0);
+    uint32_t h2 = dict_key_hash(key, 0x9E3779B9u) | 1u;
+    for (uint32_t i = 0; i < DICT_BLOOM_HASHES; i++) {
+        uint32_t bit = (h1 + i * h2) % DICT_BLOOM_BITS;
+        if (!(dict_bloom_bits[bit >> 3] & (1u << (bit & 7)))) return false;
+    }
+    return true;
+}
+
+// ==============================
+// NewWords.dat hash table
+// ==============================
+static void dict_newwords_reset(void) {
+    memset(dict_newwords_slots, 0, sizeof(dict_newwords_slots));
+    dict_newwords_used = 0;
+    dict_newwords_complete = true;
+}
+
+static dict_newword_t *dict_newwords_alloc(void) {
+    if (dict_newwords_used >= DICT_NEWWORDS_POOL) return NULL;
+    return &dict_newwords_pool[dict_newwords_used++];
+}
+
+// The first record for a key wins, matching what the sequential file scan returned.
+static bool dict_newwords_insert(const uint8_t *key, const char *word) {
+    uint32_t slot = dict_key_hash(key, 0) & (DICT_NEWWORDS_SLOTS - 1);
+    for (uint16_t probe = 1; probe <= DICT_NEWWORDS_SLOTS; probe++) {
+        uint16_t ref = dict_newwords_slots[slot];
+        if (ref == 0) {
+            dict_newword_t *entry = dict_newwords_alloc();
+            if (!entry) break;
+            memcpy(entry->key, key, DICT_KEY_SIZE);
+            strncpy(entry->word, word, DICT_WORD_SIZE);
+            entry->word[DICT_WORD_SIZE] = '\0';
+            dict_newwords_slots[slot] = dict_newwords_used;
+            if (probe > dict_newwords_stats.max_insert_probe) dict_newwords_stats.max_insert_probe = probe;
+            return true;
+        }
+        if (memcmp(dict_newwords_pool[ref - 1].key, key, DICT_KEY_SIZE) == 0) return true;
+        slot = (slot + 1) & (DICT_NEWWORDS_SLOTS - 1);
+    }
+
+    if (dict_newwords_complete) {
+        printf("WARNING: NewWords table full (%u entries), falling back to file scan\n", (unsigned)dict_newwords_used);
+    }
+    dict_newwords_complete = false;
+    return false;
+}
+
+static bool dict_newwords_find(const uint8_t *key, char *word_out, size_t word_out_len) {
+    uint32_t slot = dict_key_hash(key, 0) & (DICT_NEWWORDS_SLOTS - 1);
+    uint16_t probe = 0;
+    bool found = false;
+
+    dict_newwords_stats.lookups++;
+    while (probe < DICT_NEWWORDS_SLOTS) {
+        uint16_t ref = dict_newwords_slots[slot];
+        probe++;
+        if (ref == 0) break;
+        if (memcmp(dict_newwords_pool[ref - 1].key, key, DICT_KEY_SIZE) == 0) {
+            strncpy(word_out, dict_newwords_pool[ref - 1].word, word_out_len - 1);
+            word_out[word_out_len - 1] = '\0';
+            dict_newwords_stats.hits++;
+            found = true;
+            break;
+        }
+        slot = (slot + 1) & (DICT_NEWWORDS_SLOTS - 1);
+    }
+
+    dict_newwords_stats.probes += probe;
+    if (probe > dict_newwords_stats.max_probe) dict_newwords_stats.max_probe = probe;
+    return found;
+}
+
+// NewWords.dat stays open for appends; it must be closed before anything else rewrites or unlinks it.
+static void dict_newwords_close(void) {
+    if (newwords_ready) {
+        f_close(&newwords_file);
+        newwords_ready = false;
+    }
+}
+
 static bool dict_add_unknown_word(const uint8_t *seq) {
     if (!sd_ready) return false;
     
-    FIL newwords;
     FRESULT res;
     UINT bw;
     
-    // Open NewWords.dat in append mode
-    res = f_open(&newwords, "0:/microsd/NewWords.dat", FA_WRITE | FA_OPEN_APPEND);
-    if (res != FR_OK) {
-        // File doesn't exist, create it
-        res = f_open(&newwords, "0:/microsd/NewWords.dat", FA_WRITE | FA_CREATE_NEW);
+    // Open NewWords.dat in append mode on first use
+    if (!newwords_ready) {
+        res = f_open(&newwords_file, "0:/microsd/NewWords.dat", FA_WRITE | FA_OPEN_APPEND);
         if (res != FR_OK) {
-            printf("ERROR: failed to create NewWords.dat (code %d)\n", res);
-            return false;
+            // File doesn't exist, create it
+            res = f_open(&newwords_file, "0:/microsd/NewWords.dat", FA_WRITE | FA_CREATE_NEW);
+            if (res != FR_OK) {
+                printf("ERROR: failed to create NewWords.dat (code %d)\n", res);
+                return false;
+            }
         }
+        newwords_ready = true;
     }
     
     // Generate word: "UnRecognisedXX"
     char word[DICT_WORD_SIZE];
     snprintf(word, DICT_WORD_SIZE, "UnRecognised%02d", unrecognised_counter);
 
-    uint8_t language_id = LANG_UNKNOWN;
-    if (current_user.set && current_user.language[0] != '\0') {
-        language_id = language_id_from_name(current_user.language);
-    }
-
-    char record_line[DICT_RECORD_SIZE + 1];
-    memset(record_line, ' ', sizeof(record_line));
+    uint8_t language_id = dict_target_language();
 
-    for (int i = 0; i < PHONEME_SEQ_LEN; i++) {
-        int pos = i * 3;
-        snprintf(&record_line[pos], 3, "%02X", seq[i]);
-        record_line[pos + 2] = ' ';
-    }
-
-    snprintf(&record_line[DICT_LANG_OFFSET], 3, "%02X", language_id);
-    record_line[DICT_LANG_OFFSET + DICT_LANG_ID_CHARS] = ' ';
+    char record_line[DICT_LINE_MAX + 3];
+    size_t len = dict_format_record_line(seq, language_id, word, record_line);
+    if (len == 0) return false;
 
-    size_t wlen = strnlen(word, DICT_WORD_SIZE);
-    memcpy(&record_line[DICT_WORD_OFFSET], word, wlen);
-    record_line[DICT_WORD_OFFSET + DICT_WORD_SIZE] = '\r';
-    record_line[DICT_WORD_OFFSET + DICT_WORD_SIZE + 1] = '\n';
-
-    res = f_write(&newwords, record_line, DICT_RECORD_SIZE, &bw);
-    f_close(&newwords);
+    // Sync instead of close so the record is durable and visible to other read handles.
+    res = f_write(&newwords_file, record_line, (UINT)len, &bw);
+    if (res == FR_OK) res = f_sync(&newwords_file);
     
-    if (res != FR_OK || bw != DICT_RECORD_SIZE) {
+    if (res != FR_OK || bw != (UINT)len) {
         printf("ERROR: failed to write unknown word record\n");
+        dict_newwords_close();
         return false;
     }
     
+    uint8_t key[DICT_KEY_SIZE];
+    memcpy(key, seq, PHONEME_SEQ_MAX);
+    key[PHONEME_SEQ_MAX] = language_id;
+    dict_bloom_add(key);
+    dict_newwords_insert(key, word);
+
     printf("INFO: Added unknown word '%s' to NewWords.dat\n", word);
     unrecognised_counter++;
     return true;
 }
 
+static bool dict_bin_open(void);
+static bool dict_trie_open(void);
+static bool dict_phrase_open(void);
+static bool dict_widx_open(void);
+static bool dict_newwords_load(void);
+static void dict_lsm_recover(void);
+static bool dict_lsm_load(void);
+static bool dict_approx_load_costs(void);
+static bool dict_xip_open(void);
+static void dict_cache_preload(void);
+
+// Builds a fast-seek cluster map so f_lseek() on a read handle does not walk the FAT chain.
+static void dict_enable_fast_seek(FIL *file, DWORD *clmt) {
+    file->cltbl = clmt;
+    clmt[0] = DICT_CLMT_SIZE;
+    if (f_lseek(file, CREATE_LINKMAP) != FR_OK) {
+        file->cltbl = NULL;
+    }
+}
+
 static bool dict_init(void) {
     FRESULT res = f_mount(&fs, "0:", 1);
     if (res != FR_OK) {
@@ -1391,6 +2668,8 @@ static bool dict_init(void) {
         printf("WARNING: failed to create UserList.txt\n");
     }
 
+    dict_lsm_recover();
+
     res = f_open(&dict_file, "0:/microsd/Dictionary.dat", FA_READ | FA_OPEN_EXISTING);
     if (res != FR_OK) {
         printf("ERROR: f_open Dictionary.dat failed with code %d\n", res);
@@ -1398,17 +2677,33 @@ static bool dict_init(void) {
     }
 
     dict_ready = true;
-    return true;
-}
+    dict_enable_fast_seek(&dict_file, dict_clmt);
 
-static int compare_seq_to_record(const uint8_t *lhs_seq, const uint8_t *rhs_seq) {
-    for (int i = 0; i < PHONEME_SEQ_LEN; i++) {
-        uint8_t lhs = lhs_seq[i];
-        uint8_t rhs = rhs_seq[i];
-        if (lhs < rhs) return -1;
-        if (lhs > rhs) return 1;
+    if (!dict_bin_open()) {
+        printf("WARNING: Dictionary.bin unavailable, using text search\n");
     }
-    return 0;
+    if (!dict_trie_open()) {
+        printf("WARNING: Dictionary.trie unavailable, words resolve at silence only\n");
+    }
+    if (!dict_widx_open()) {
+        printf("WARNING: Dictionary.widx unavailable, word searches scan Dictionary.dat\n");
+    }
+    if (dict_phrase_open()) {
+        printf("INFO: Phrases.ac ready (%lu states, %lu patterns)\n",
+               (unsigned long)dict_phrase_node_count, (unsigned long)dict_phrase_pattern_count);
+    }
+    if (dict_xip_open()) {
+        printf("INFO: flash dictionary ready (%lu records)\n", (unsigned long)dict_xip_record_count);
+    }
+    if (!dict_newwords_load()) {
+        printf("WARNING: NewWords.dat index unavailable, misses scan the file\n");
+    }
+    if (!dict_lsm_load()) {
+        printf("WARNING: dictionary additions disabled\n");
+    }
+    dict_approx_load_costs();
+    dict_cache_preload();
+    return true;
 }
 
 static int hex_nibble_to_int(char c) {
@@ -1418,280 +2713,2852 @@ static int hex_nibble_to_int(char c) {
     return -1;
 }
 
-static bool dict_parse_record_line(const char *record, uint8_t *seq_out, uint8_t *language_id_out, char *word_out, size_t word_out_len) {
-    if (!record || !seq_out || !word_out || word_out_len < 2) return false;
-
-    for (int i = 0; i < PHONEME_SEQ_LEN; i++) {
-        int pos = i * 3;
-        int hi = hex_nibble_to_int(record[pos]);
-        int lo = hex_nibble_to_int(record[pos + 1]);
-        if (hi < 0 || lo < 0) return false;
-        seq_out[i] = (uint8_t)((hi << 4) | lo);
-    }
+static bool dict_parse_hex_byte(const char *text, uint8_t *value_out) {
+    int hi = hex_nibble_to_int(text[0]);
+    if (hi < 0) return false;
+    int lo = hex_nibble_to_int(text[1]);
+    if (lo < 0) return false;
+    *value_out = (uint8_t)((hi << 4) | lo);
+    return true;
+}
 
-    int lang_hi = hex_nibble_to_int(record[DICT_LANG_OFFSET]);
-    int lang_lo = hex_nibble_to_int(record[DICT_LANG_OFFSET + 1]);
-    if (lang_hi < 0 || lang_lo < 0) return false;
-    if (language_id_out) {
-        *language_id_out = (uint8_t)((lang_hi << 4) | lang_lo);
-    }
+// Keys are zero padded; the phoneme count is the position after the last phoneme.
+static uint8_t dict_seq_length(const uint8_t *seq) {
+    uint8_t len = PHONEME_SEQ_MAX;
+    while (len > 0 && seq[len - 1] == 0x00) len--;
+    return len;
+}
 
-    char raw_word[DICT_WORD_SIZE + 1];
-    memcpy(raw_word, &record[DICT_WORD_OFFSET], DICT_WORD_SIZE);
-    raw_word[DICT_WORD_SIZE] = '\0';
+// Parses the sort key of a text line (either layout) into a zero-padded key: PHONEME_SEQ_MAX
+// phoneme bytes followed by the language ID. Returns where the word starts, NULL if malformed.
+static const char *dict_parse_record_head(const char *line, uint8_t *key_out) {
+    if (!line || !key_out) return NULL;
+    memset(key_out, 0, DICT_KEY_SIZE);
 
-    for (int i = DICT_WORD_SIZE - 1; i >= 0; i--) {
-        if (raw_word[i] == ' ' || raw_word[i] == '\0') raw_word[i] = '\0';
-        else break;
+    uint8_t count = 0;
+    if (!dict_parse_hex_byte(line, &count)) return NULL;
+
+    const char *p;
+    if (line[2] == ':') {
+        if (count > PHONEME_SEQ_MAX) return NULL;
+        p = &line[3];
+        for (uint8_t i = 0; i < count; i++, p += 3) {
+            if (!dict_parse_hex_byte(p, &key_out[i]) || key_out[i] == 0x00 || p[2] != ' ') return NULL;
+        }
+    } else {
+        // Fixed-width line: the first hex byte was phoneme 0, the rest sit at 3-char steps.
+        for (int i = 0; i < DICT_LEGACY_SEQ_LEN; i++) {
+            if (!dict_parse_hex_byte(&line[i * 3], &key_out[i]) || line[i * 3 + 2] != ' ') return NULL;
+        }
+        p = &line[DICT_LEGACY_LANG_OFFSET];
     }
 
-    strncpy(word_out, raw_word, word_out_len - 1);
-    word_out[word_out_len - 1] = '\0';
-    return true;
+    if (!dict_parse_hex_byte(p, &key_out[PHONEME_SEQ_MAX])) return NULL;
+    p += 2;
+    while (*p == ' ') p++;
+    return p;
 }
 
-static bool dict_format_record_line(const uint8_t *seq, uint8_t language_id, const char *word, char *record_out) {
-    if (!seq || !word || !record_out) return false;
-
-    memset(record_out, ' ', DICT_RECORD_SIZE);
+static bool dict_parse_record_key(const char *line, uint8_t *key_out) {
+    return dict_parse_record_head(line, key_out) != NULL;
+}
 
-    for (int i = 0; i < PHONEME_SEQ_LEN; i++) {
-        int pos = i * 3;
-        snprintf(&record_out[pos], 3, "%02X", seq[i]);
-        record_out[pos + 2] = ' ';
-    }
+// Fills word_out with the word of a text line, minus the padding of fixed-width lines.
+static bool dict_parse_record_line(const char *line, uint8_t *key_out, char *word_out, size_t word_out_len) {
+    if (!word_out || word_out_len < 2) return false;
 
-    snprintf(&record_out[DICT_LANG_OFFSET], 3, "%02X", language_id);
-    record_out[DICT_LANG_OFFSET + DICT_LANG_ID_CHARS] = ' ';
+    const char *word = dict_parse_record_head(line, key_out);
+    if (!word) return false;
 
-    size_t wlen = strnlen(word, DICT_WORD_SIZE);
-    memcpy(&record_out[DICT_WORD_OFFSET], word, wlen);
-    record_out[DICT_WORD_OFFSET + DICT_WORD_SIZE] = '\r';
-    record_out[DICT_WORD_OFFSET + DICT_WORD_SIZE + 1] = '\n';
+    size_t len = strcspn(word, "\r\n");
+    while (len > 0 && word[len - 1] == ' ') len--;
+    if (len > DICT_WORD_SIZE) len = DICT_WORD_SIZE;
+    if (len > word_out_len - 1) len = word_out_len - 1;
+    memcpy(word_out, word, len);
+    word_out[len] = '\0';
     return true;
 }
 
-static int dict_compare_record_keys(const char *record_a, const char *record_b) {
-    uint8_t seq_a[PHONEME_SEQ_LEN] = {0};
-    uint8_t seq_b[PHONEME_SEQ_LEN] = {0};
-    uint8_t lang_a = LANG_UNKNOWN;
-    uint8_t lang_b = LANG_UNKNOWN;
-    char word_a[DICT_WORD_SIZE + 1] = {0};
-    char word_b[DICT_WORD_SIZE + 1] = {0};
-
-    if (!dict_parse_record_line(record_a, seq_a, &lang_a, word_a, sizeof(word_a))) return 0;
-    if (!dict_parse_record_line(record_b, seq_b, &lang_b, word_b, sizeof(word_b))) return 0;
-
-    int seq_cmp = compare_seq_to_record(seq_a, seq_b);
-    if (seq_cmp != 0) return seq_cmp;
+// Writes one CRLF-terminated line (NUL terminated after the CRLF); line_out needs DICT_LINE_BUF bytes.
+// Returns the number of bytes to write, 0 when the sequence does not fit.
+static size_t dict_format_record_line(const uint8_t *seq, uint8_t language_id, const char *word, char *line_out) {
+    if (!seq || !word || !line_out) return 0;
 
-    if (lang_a < lang_b) return -1;
-    if (lang_a > lang_b) return 1;
+    uint8_t count = dict_seq_length(seq);
+    for (uint8_t i = 0; i < count; i++) {
+        if (seq[i] == 0x00) return 0;
+    }
 
-    return strcasecmp_local(word_a, word_b);
+    size_t len = (size_t)snprintf(line_out, DICT_LINE_BUF, "%02X:", count);
+    for (uint8_t i = 0; i < count; i++) {
+        len += (size_t)snprintf(&line_out[len], DICT_LINE_BUF - len, "%02X ", seq[i]);
+    }
+    len += (size_t)snprintf(&line_out[len], DICT_LINE_BUF - len, "%02X %.*s\r\n", language_id,
+                            (int)strnlen(word, DICT_WORD_SIZE), word);
+    return len;
 }
 
-static bool dict_read_record_at(FIL *dict, uint32_t index, char *record_out) {
-    if (!dict || !record_out) return false;
-
-    FSIZE_t offset = (FSIZE_t)index * (FSIZE_t)DICT_RECORD_SIZE;
-    UINT br = 0;
-    if (f_lseek(dict, offset) != FR_OK) return false;
-    if (f_read(dict, record_out, DICT_RECORD_SIZE, &br) != FR_OK || br < DICT_RECORD_SIZE) return false;
-    return true;
+// Dictionary order: packed key first, the word (case-insensitive) only breaks ties.
+static int dict_compare_key_word(const uint8_t *key_a, const char *word_a, const uint8_t *key_b, const char *word_b) {
+    int key_cmp = memcmp(key_a, key_b, DICT_KEY_SIZE);
+    if (key_cmp != 0) return key_cmp;
+    return strcasecmp_local(word_a, word_b);
 }
 
-static bool dict_write_record_at(FIL *dict, uint32_t index, const char *record_in) {
-    if (!dict || !record_in) return false;
+static bool dict_reader_start(dict_reader_t *reader, FIL *file, FSIZE_t offset) {
+    reader->file = file;
+    reader->offset = offset;
+    reader->pos = 0;
+    reader->len = 0;
+    reader->eof = false;
+    reader->error = f_lseek(file, offset) != FR_OK;
+    reader->skipping = false;
+    return !reader->error;
+}
+
+// Returns the next non-empty line without its CR/LF, and the file offset it starts at. False at the
+// end of the file, or on a read error with reader->error set.
+static bool dict_reader_next(dict_reader_t *reader, char *line, size_t line_len, FSIZE_t *offset_out) {
+    if (reader->error) return false;
+    for (;;) {
+        const char *start = &reader->buf[reader->pos];
+        UINT avail = reader->len - reader->pos;
+        const char *eol = memchr(start, '\n', avail);
+
+        // No valid line is this long (a hand edit of Dictionary.dat): drop it up to its '\n' rather
+        // than ending the file there.
+        if (reader->skipping || (!eol && avail == DICT_READER_BYTES)) {
+            reader->skipping = !eol;
+            reader->pos += eol ? (UINT)(eol - start) + 1 : avail;
+            if (eol) continue;
+            if (reader->eof) return false;
+            start = &reader->buf[reader->pos];
+            avail = 0;
+        }
 
-    FSIZE_t offset = (FSIZE_t)index * (FSIZE_t)DICT_RECORD_SIZE;
-    UINT bw = 0;
-    if (f_lseek(dict, offset) != FR_OK) return false;
-    if (f_write(dict, record_in, DICT_RECORD_SIZE, &bw) != FR_OK || bw != DICT_RECORD_SIZE) return false;
-    return true;
-}
+        if (!eol && !reader->eof) {
+            memmove(reader->buf, start, avail);
+            reader->offset += reader->pos;
+            reader->pos = 0;
+            reader->len = avail;
 
-static bool dict_insert_sorted_record(FIL *dict, const char *record_line) {
-    if (!dict || !record_line) return false;
+            UINT br = 0;
+            if (f_read(reader->file, &reader->buf[avail], DICT_READER_BYTES - avail, &br) != FR_OK) {
+                reader->error = true;
+                return false;
+            }
+            reader->len += br;
+            if (br == 0) reader->eof = true;
+            continue;
+        }
 
-    UINT bw = 0;
-    FSIZE_t end = f_size(dict);
-    if (f_lseek(dict, end) != FR_OK) return false;
-    if (f_write(dict, record_line, DICT_RECORD_SIZE, &bw) != FR_OK || bw != DICT_RECORD_SIZE) return false;
+        UINT n = eol ? (UINT)(eol - start) : avail;
+        if (!eol && n == 0) return false;
 
-    uint32_t record_count = (uint32_t)(f_size(dict) / DICT_RECORD_SIZE);
-    if (record_count == 0) return false;
+        FSIZE_t line_offset = reader->offset + reader->pos;
+        reader->pos += eol ? n + 1 : n;
+        if (n > 0 && start[n - 1] == '\r') n--;
+        if (n == 0) continue;
 
-    uint32_t current_index = record_count - 1;
-    char current_record[DICT_RECORD_SIZE + 1] = {0};
-    memcpy(current_record, record_line, DICT_RECORD_SIZE);
+        if (n > line_len - 1) n = (UINT)(line_len - 1);
+        memcpy(line, start, n);
+        line[n] = '\0';
+        if (offset_out) *offset_out = line_offset;
+        return true;
+    }
+}
 
-    char prev_record[DICT_RECORD_SIZE + 1] = {0};
+// Reads the line that starts at offset with one f_read(); line must hold DICT_LINE_BUF bytes.
+static bool dict_read_line_at(FIL *file, FSIZE_t offset, char *line) {
+    UINT br = 0;
+    if (f_lseek(file, offset) != FR_OK) return false;
+    if (f_read(file, line, DICT_LINE_BUF - 1, &br) != FR_OK || br == 0) return false;
+    line[br] = '\0';
+    line[strcspn(line, "\r\n")] = '\0';
+    return line[0] != '\0';
+}
 
-    // Reverse bubble sort pass for the newly appended entry:
-    // swap backwards until ordering is correct for binary search.
-    while (current_index > 0) {
-        uint32_t prev_index = current_index - 1;
-        if (!dict_read_record_at(dict, prev_index, prev_record)) return false;
+// ==============================
+// Dictionary lookup cache
+// ==============================
+static uint32_t dict_cache_hash(const uint8_t *key) {
+    uint32_t h = dict_key_hash(key, 0);
+    return h ? h : 1;
+}
 
-        if (dict_compare_record_keys(prev_record, current_record) <= 0) {
-            break;
-        }
+static void dict_cache_clear(void) {
+    memset(dict_cache, 0, sizeof(dict_cache));
+    dict_cache_clock = 0;
+}
 
-        if (!dict_write_record_at(dict, prev_index, current_record)) return false;
-        if (!dict_write_record_at(dict, current_index, prev_record)) return false;
+static bool dict_cache_get(const uint8_t *key, char *word_out, size_t word_out_len) {
+    uint32_t hash = dict_cache_hash(key);
+    for (uint16_t i = 0; i < DICT_CACHE_ENTRIES; i++) {
+        dict_cache_entry_t *entry = &dict_cache[i];
+        if (entry->hash != hash || memcmp(entry->key, key, DICT_KEY_SIZE) != 0) continue;
 
-        current_index = prev_index;
+        entry->hits++;
+        entry->last_used = ++dict_cache_clock;
+        dict_cache_dirty = true;
+        dict_cache_stats.hits++;
+        strncpy(word_out, entry->word, word_out_len - 1);
+        word_out[word_out_len - 1] = '\0';
+        return true;
     }
+    dict_cache_stats.misses++;
+    return false;
+}
 
+// Fills an empty slot, otherwise replaces the least recently used entry.
+static void dict_cache_put(const uint8_t *key, uint8_t lang, const char *word, uint32_t hits) {
+    dict_cache_entry_t *victim = &dict_cache[0];
+    for (uint16_t i = 0; i < DICT_CACHE_ENTRIES; i++) {
+        dict_cache_entry_t *entry = &dict_cache[i];
+        if (entry->hash == 0) {
+            victim = entry;
+            break;
+        }
+        if (entry->last_used < victim->last_used) victim = entry;
+    }
+    if (victim->hash != 0) dict_cache_stats.evictions++;
+
+    victim->hash = dict_cache_hash(key);
+    victim->last_used = ++dict_cache_clock;
+    victim->hits = hits;
+    memcpy(victim->key, key, DICT_KEY_SIZE);
+    victim->lang = lang;
+    strncpy(victim->word, word, DICT_WORD_SIZE);
+    victim->word[DICT_WORD_SIZE] = '\0';
+}
+
+// A new record for seq can change what any target language resolves to, so every entry for it goes.
+static void dict_cache_forget(const uint8_t *seq) {
+    for (uint16_t i = 0; i < DICT_CACHE_ENTRIES; i++) {
+        dict_cache_entry_t *entry = &dict_cache[i];
+        if (entry->hash != 0 && memcmp(entry->key, seq, PHONEME_SEQ_MAX) == 0) {
+            entry->hash = 0;
+            dict_cache_stats.invalidations++;
+        }
+    }
+}
+
+// ==============================
+// Dictionary.bin packed shadow
+// ==============================
+static uint32_t dict_bin_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void dict_bin_put_u32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)(value & 0xFF);
+    p[1] = (uint8_t)((value >> 8) & 0xFF);
+    p[2] = (uint8_t)((value >> 16) & 0xFF);
+    p[3] = (uint8_t)((value >> 24) & 0xFF);
+}
+
+// Whole-block reads are sector aligned, so FatFs hands them straight to disk_read() as one sector.
+static const uint8_t *dict_bin_load_block(uint32_t block) {
+    if (block == dict_bin_block_index) return dict_bin_block;
+
+    UINT br = 0;
+    dict_bin_block_index = UINT32_MAX;
+    if (f_lseek(&dict_bin_file, (FSIZE_t)(block + 1) * DICT_BIN_BLOCK_SIZE) != FR_OK) return NULL;
+    if (f_read(&dict_bin_file, dict_bin_block, DICT_BIN_BLOCK_SIZE, &br) != FR_OK || br != DICT_BIN_BLOCK_SIZE) return NULL;
+
+    dict_bin_block_index = block;
+    dict_lookup_block_reads++;
+    return dict_bin_block;
+}
+
+// Block records (Dictionary.bin and the flash image) open with the packed key: phoneme count, the
+// phonemes, language ID. Returns the packed size.
+static uint8_t dict_pack_key(const uint8_t *key, uint8_t *out) {
+    uint8_t len = dict_seq_length(key);
+    out[0] = len;
+    memcpy(&out[1], key, len);
+    out[1 + len] = key[PHONEME_SEQ_MAX];
+    return (uint8_t)(len + 2);
+}
+
+static void dict_unpack_key(const uint8_t *packed, uint8_t *key_out) {
+    memset(key_out, 0, DICT_KEY_SIZE);
+    memcpy(key_out, &packed[1], packed[0]);
+    key_out[PHONEME_SEQ_MAX] = packed[1 + packed[0]];
+}
+
+// Size of the record at p, 0 once the block has no more records. Flash image records carry the
+// word (length byte + text) where Dictionary.bin records carry a Dictionary.dat line offset.
+static uint16_t dict_block_record_size(const uint8_t *p, const uint8_t *end, bool words) {
+    if (p >= end || p[0] == 0 || p[0] > PHONEME_SEQ_MAX) return 0;
+    uint16_t size = (uint16_t)(p[0] + 2);
+    if (words) {
+        if (p + size >= end) return 0;
+        size = (uint16_t)(size + 1 + p[size]);
+    } else {
+        size += 4;
+    }
+    return (p + size <= end) ? size : 0;
+}
+
+typedef const uint8_t *(*dict_block_loader_t)(uint32_t block);
+
+// Lower-bound search over the blocks [first, end) of one segment. The first record not below key is
+// either in the block before the first block whose head is not below key, or heads that block, so
+// only block heads in [low, high] are probed before a single block is scanned. Returns the record
+// when its key equals key.
+static const uint8_t *dict_blocks_find(dict_block_loader_t load, uint16_t block_size, bool words, uint32_t first,
+                                       uint32_t end, uint32_t low, uint32_t high, const uint8_t *key) {
+    uint8_t head[DICT_KEY_SIZE];
+    while (low < high) {
+        uint32_t mid = low + ((high - low) / 2);
+        const uint8_t *block = load(mid);
+        dict_lookup_probes++;
+        if (!block || dict_block_record_size(block, block + block_size, words) == 0) return NULL;
+        dict_unpack_key(block, head);
+        if (memcmp(head, key, DICT_KEY_SIZE) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low > first) {
+        const uint8_t *block = load(low - 1);
+        if (!block) return NULL;
+        const uint8_t *block_end = block + block_size;
+        for (const uint8_t *p = block;;) {
+            uint16_t size = dict_block_record_size(p, block_end, words);
+            if (size == 0) break;
+            dict_lookup_probes++;
+            dict_unpack_key(p, head);
+            int cmp = memcmp(head, key, DICT_KEY_SIZE);
+            if (cmp == 0) return p;
+            if (cmp > 0) return NULL;
+            p += size;
+        }
+    }
+
+    if (low >= end) return NULL;
+    const uint8_t *block = load(low);
+    if (!block || dict_block_record_size(block, block + block_size, words) == 0) return NULL;
+    dict_unpack_key(block, head);
+    return memcmp(head, key, DICT_KEY_SIZE) == 0 ? block : NULL;
+}
+
+static bool dict_fence_build(void) {
+    uint32_t blocks = dict_bin_block_count;
+    dict_fence_stride = (blocks + DICT_FENCE_MAX - 1) / DICT_FENCE_MAX;
+    if (dict_fence_stride == 0) dict_fence_stride = 1;
+    dict_fence_count = 0;
+
+    for (uint32_t block = 0; block < blocks; block += dict_fence_stride) {
+        const uint8_t *data = dict_bin_load_block(block);
+        if (!data) {
+            dict_fence_count = 0;
+            return false;
+        }
+        dict_unpack_key(data, dict_fence_keys[dict_fence_count++]);
+    }
+
+    printf("INFO: Dictionary fence index: %lu fences x %lu block(s), %lu bytes\n",
+           (unsigned long)dict_fence_count,
+           (unsigned long)dict_fence_stride,
+           (unsigned long)(dict_fence_count * DICT_KEY_SIZE));
+    return true;
+}
+
+// Derived files share a 16-byte prefix: magic, version and the size/timestamp of the Dictionary.dat they came from.
+static void dict_source_header_write(uint8_t *header, const char *magic, uint8_t version, const FILINFO *src) {
+    memcpy(header, magic, 4);
+    header[4] = version;
+    dict_bin_put_u32(&header[8], (uint32_t)src->fsize);
+    header[12] = (uint8_t)(src->fdate & 0xFF);
+    header[13] = (uint8_t)(src->fdate >> 8);
+    header[14] = (uint8_t)(src->ftime & 0xFF);
+    header[15] = (uint8_t)(src->ftime >> 8);
+}
+
+static bool dict_source_header_matches(const uint8_t *header, const char *magic, uint8_t version, const FILINFO *src) {
+    if (memcmp(header, magic, 4) != 0 || header[4] != version) return false;
+    if (dict_bin_get_u32(&header[8]) != (uint32_t)src->fsize) return false;
+    if ((uint16_t)(header[12] | (header[13] << 8)) != src->fdate) return false;
+    return (uint16_t)(header[14] | (header[15] << 8)) == src->ftime;
+}
+
+static int dict_bin_segment_index(uint8_t lang) {
+    for (uint16_t i = 0; i < dict_bin_segment_count; i++) {
+        if (dict_bin_segments[i].lang == lang) return i;
+    }
+    return -1;
+}
+
+// Counting pass: finds the segment for lang, inserting it in language order on first use.
+static dict_bin_segment_t *dict_bin_segment_add(uint8_t lang) {
+    uint16_t pos = 0;
+    while (pos < dict_bin_segment_count && dict_bin_segments[pos].lang < lang) pos++;
+    if (pos < dict_bin_segment_count && dict_bin_segments[pos].lang == lang) return &dict_bin_segments[pos];
+    if (dict_bin_segment_count >= DICT_BIN_MAX_SEGMENTS) return NULL;
+
+    memmove(&dict_bin_segments[pos + 1], &dict_bin_segments[pos],
+            (dict_bin_segment_count - pos) * sizeof(dict_bin_segments[0]));
+    dict_bin_segment_count++;
+    dict_bin_segments[pos].lang = lang;
+    dict_bin_segments[pos].first_block = 0;
+    dict_bin_segments[pos].blocks = 0;
+    dict_bin_segments[pos].count = 0;
+    dict_bin_segments[pos].fill = DICT_BIN_BLOCK_SIZE;
+    return &dict_bin_segments[pos];
+}
+
+static bool dict_bin_write_block(uint32_t block, const uint8_t *data) {
+    UINT bw = 0;
+    if (f_lseek(&dict_bin_file, (FSIZE_t)(block + 1) * DICT_BIN_BLOCK_SIZE) != FR_OK) return false;
+    return f_write(&dict_bin_file, data, DICT_BIN_BLOCK_SIZE, &bw) == FR_OK && bw == DICT_BIN_BLOCK_SIZE;
+}
+
+// Two passes over the sorted Dictionary.dat: the first sizes every language segment, the second
+// deals records into one RAM block per segment (dict_build_scratch) and writes each block once the
+// next record no longer fits. More languages than the scratch holds blocks for take extra passes.
+static bool dict_bin_build(const FILINFO *src) {
+    dict_bin_block_index = UINT32_MAX;
+    dict_bin_segment_count = 0;
+    dict_bin_block_count = 0;
+    FRESULT res = f_open(&dict_bin_file, "0:/microsd/Dictionary.bin", FA_READ | FA_WRITE | FA_CREATE_ALWAYS);
+    if (res != FR_OK) {
+        printf("ERROR: f_open Dictionary.bin failed with code %d\n", res);
+        return false;
+    }
+
+    // Header block stays zeroed until every record is written, so an interrupted build reads as stale.
+    uint8_t *block = dict_bin_block;
+    memset(block, 0, DICT_BIN_BLOCK_SIZE);
+    UINT bw = 0;
+    if (f_write(&dict_bin_file, block, DICT_BIN_BLOCK_SIZE, &bw) != FR_OK || bw != DICT_BIN_BLOCK_SIZE) goto fail;
+
+    dict_reader_t reader;
+    char line[DICT_LINE_BUF];
+    char word[DICT_WORD_SIZE + 1];
+    uint8_t key[DICT_KEY_SIZE];
+    uint8_t prev_key[DICT_KEY_SIZE] = {0};
+    uint32_t count = 0;
+    uint32_t unsorted = 0;
+    uint32_t payload = 0;
+    FSIZE_t line_offset = 0;
+
+    if (!dict_reader_start(&reader, &dict_file, 0)) goto fail;
+    while (dict_reader_next(&reader, line, sizeof(line), &line_offset)) {
+        if (!dict_parse_record_line(line, key, word, sizeof(word))) {
+            printf("ERROR: Dictionary.dat line at byte %lu is malformed\n", (unsigned long)line_offset);
+            goto fail;
+        }
+        if (count > 0 && memcmp(prev_key, key, DICT_KEY_SIZE) > 0) unsorted++;
+        memcpy(prev_key, key, DICT_KEY_SIZE);
+
+        uint8_t len = dict_seq_length(key);
+        if (len == 0) continue;
+
+        dict_bin_segment_t *seg = dict_bin_segment_add(key[PHONEME_SEQ_MAX]);
+        if (!seg) {
+            printf("ERROR: Dictionary.dat uses more than %d languages\n", DICT_BIN_MAX_SEGMENTS);
+            goto fail;
+        }
+        uint16_t size = (uint16_t)(len + 6);
+        if (seg->fill + size > DICT_BIN_BLOCK_SIZE) {
+            seg->blocks++;
+            seg->fill = 0;
+        }
+        seg->fill += size;
+        seg->count++;
+        payload += len + 3 + (uint32_t)strlen(word);
+        count++;
+    }
+    if (reader.error) goto fail;
+
+    for (uint16_t i = 0; i < dict_bin_segment_count; i++) {
+        dict_bin_segments[i].first_block = dict_bin_block_count;
+        dict_bin_block_count += dict_bin_segments[i].blocks;
+    }
+
+    // Pre-size the file so segment blocks can be written in whatever order they fill.
+    FSIZE_t data_end = (FSIZE_t)(dict_bin_block_count + 1) * DICT_BIN_BLOCK_SIZE;
+    if (f_lseek(&dict_bin_file, data_end) != FR_OK || f_tell(&dict_bin_file) != data_end) goto fail;
+
+    uint32_t placed[DICT_BIN_MAX_SEGMENTS] = {0};  // blocks written per segment
+    uint16_t fill[DICT_BIN_MAX_SEGMENTS] = {0};
+    const uint16_t per_pass = DICT_BUILD_SCRATCH_BYTES / DICT_BIN_BLOCK_SIZE;
+    for (uint16_t group = 0; group < dict_bin_segment_count; group += per_pass) {
+        uint16_t group_end = group + per_pass;
+        if (group_end > dict_bin_segment_count) group_end = dict_bin_segment_count;
+        memset(dict_build_scratch, 0, DICT_BUILD_SCRATCH_BYTES);
+
+        if (!dict_reader_start(&reader, &dict_file, 0)) goto fail;
+        while (dict_reader_next(&reader, line, sizeof(line), &line_offset)) {
+            if (!dict_parse_record_key(line, key)) goto fail;
+            if (dict_seq_length(key) == 0) continue;
+            int s = dict_bin_segment_index(key[PHONEME_SEQ_MAX]);
+            if (s < group || s >= group_end) continue;
+
+            uint8_t *buf = &dict_build_scratch[(s - group) * DICT_BIN_BLOCK_SIZE];
+            uint16_t size = (uint16_t)(dict_seq_length(key) + 6);
+            if (fill[s] + size > DICT_BIN_BLOCK_SIZE) {
+                if (!dict_bin_write_block(dict_bin_segments[s].first_block + placed[s], buf)) goto fail;
+                memset(buf, 0, DICT_BIN_BLOCK_SIZE);
+                placed[s]++;
+                fill[s] = 0;
+            }
+            uint8_t *out = &buf[fill[s]];
+            uint8_t packed = dict_pack_key(key, out);
+            dict_bin_put_u32(&out[packed], (uint32_t)line_offset);
+            fill[s] += size;
+        }
+        if (reader.error) goto fail;
+
+        for (uint16_t s = group; s < group_end; s++) {
+            if (fill[s] == 0) continue;
+            if (!dict_bin_write_block(dict_bin_segments[s].first_block + placed[s], &dict_build_scratch[(s - group) * DICT_BIN_BLOCK_SIZE])) goto fail;
+        }
+    }
+
+    if (unsorted > 0) {
+        printf("WARNING: Dictionary.dat has %lu out-of-order records\n", (unsigned long)unsorted);
+    }
+
+    memset(block, 0, DICT_BIN_BLOCK_SIZE);
+    dict_source_header_write(block, "DBIN", DICT_BIN_VERSION, src);
+    dict_bin_put_u32(&block[16], count);
+    dict_bin_put_u32(&block[20], dict_bin_segment_count);
+    dict_bin_put_u32(&block[24], dict_bin_block_count);
+    dict_bin_put_u32(&block[28], payload);
+    for (uint16_t i = 0; i < dict_bin_segment_count; i++) {
+        uint8_t *entry = &block[DICT_BIN_DIR_OFFSET + i * DICT_BIN_DIR_ENTRY_SIZE];
+        entry[0] = dict_bin_segments[i].lang;
+        dict_bin_put_u32(&entry[4], dict_bin_segments[i].first_block);
+        dict_bin_put_u32(&entry[8], dict_bin_segments[i].count);
+    }
+
+    if (f_lseek(&dict_bin_file, 0) != FR_OK) goto fail;
+    if (f_write(&dict_bin_file, block, DICT_BIN_BLOCK_SIZE, &bw) != FR_OK || bw != DICT_BIN_BLOCK_SIZE) goto fail;
+    if (f_sync(&dict_bin_file) != FR_OK) goto fail;
+
+    dict_bin_record_count = count;
+    dict_bin_payload_bytes = payload;
+    printf("INFO: Dictionary.bin rebuilt (%lu records, %u language segments)\n",
+           (unsigned long)count, (unsigned)dict_bin_segment_count);
+    return true;
+
+fail:
+    dict_bin_segment_count = 0;
+    f_close(&dict_bin_file);
+    return false;
+}
+
+// Loads the language directory from a header block that already matched Dictionary.dat. Segments
+// are stored in block order, so each one ends where the next begins.
+static bool dict_bin_load_directory(const uint8_t *header) {
+    uint32_t segments = dict_bin_get_u32(&header[20]);
+    uint32_t blocks = dict_bin_get_u32(&header[24]);
+    uint32_t total = 0;
+    if (segments > DICT_BIN_MAX_SEGMENTS) return false;
+
+    for (uint16_t i = 0; i < segments; i++) {
+        const uint8_t *entry = &header[DICT_BIN_DIR_OFFSET + i * DICT_BIN_DIR_ENTRY_SIZE];
+        dict_bin_segment_t *seg = &dict_bin_segments[i];
+        seg->lang = entry[0];
+        seg->first_block = dict_bin_get_u32(&entry[4]);
+        seg->count = dict_bin_get_u32(&entry[8]);
+        if (seg->first_block > blocks || (i > 0 && seg->first_block < dict_bin_segments[i - 1].first_block)) return false;
+        if (i > 0) dict_bin_segments[i - 1].blocks = seg->first_block - dict_bin_segments[i - 1].first_block;
+        seg->blocks = blocks - seg->first_block;
+        total += seg->count;
+    }
+    if (total != dict_bin_get_u32(&header[16])) return false;
+
+    dict_bin_segment_count = (uint16_t)segments;
+    dict_bin_block_count = blocks;
+    return true;
+}
+
+// Opens Dictionary.bin and checks it against the size/timestamp of Dictionary.dat, rebuilding it when stale.
+static bool dict_bin_open(void) {
+    dict_bin_ready = false;
+    dict_bin_record_count = 0;
+    dict_bin_block_count = 0;
+    dict_bin_payload_bytes = 0;
+    dict_bin_segment_count = 0;
+    dict_bin_block_index = UINT32_MAX;
+    dict_fence_count = 0;
+
+    FILINFO src;
+    if (f_stat("0:/microsd/Dictionary.dat", &src) != FR_OK) return false;
+
+    if (f_open(&dict_bin_file, "0:/microsd/Dictionary.bin", FA_READ | FA_WRITE | FA_OPEN_EXISTING) == FR_OK) {
+        uint8_t *header = dict_bin_block;
+        UINT br = 0;
+        if (f_read(&dict_bin_file, header, DICT_BIN_BLOCK_SIZE, &br) == FR_OK && br == DICT_BIN_BLOCK_SIZE &&
+            dict_source_header_matches(header, "DBIN", DICT_BIN_VERSION, &src) && dict_bin_load_directory(header)) {
+            dict_bin_record_count = dict_bin_get_u32(&header[16]);
+            dict_bin_payload_bytes = dict_bin_get_u32(&header[28]);
+            dict_bin_ready = true;
+            dict_enable_fast_seek(&dict_bin_file, dict_bin_clmt);
+            dict_fence_build();
+            return true;
+        }
+        dict_bin_segment_count = 0;
+        f_close(&dict_bin_file);
+    }
+
+    if (!dict_bin_build(&src)) return false;
+    dict_bin_ready = true;
+    dict_enable_fast_seek(&dict_bin_file, dict_bin_clmt);
+    dict_fence_build();
+    return true;
+}
+
+// Re-opens Dictionary.dat after another handle rewrote it and brings the shadow back in sync.
+static void dict_close_files(void) {
+    dict_xip_sync.active = false;
+    dict_xip_ready = false;
+    if (dict_bin_ready) {
+        f_close(&dict_bin_file);
+        dict_bin_ready = false;
+    }
+    if (dict_trie_ready) {
+        f_close(&dict_trie_file);
+        dict_trie_ready = false;
+    }
+    if (dict_widx_ready) {
+        f_close(&dict_widx_file);
+        dict_widx_ready = false;
+    }
+    if (dict_ready) {
+        f_close(&dict_file);
+        dict_ready = false;
+    }
+}
+
+static bool dict_reload(void) {
+    dict_close_files();
+
+    if (f_open(&dict_file, "0:/microsd/Dictionary.dat", FA_READ | FA_OPEN_EXISTING) != FR_OK) return false;
+    dict_ready = true;
+    dict_enable_fast_seek(&dict_file, dict_clmt);
+
+    if (!dict_bin_open()) {
+        printf("WARNING: Dictionary.bin unavailable, using text search\n");
+    }
+    if (!dict_trie_open()) {
+        printf("WARNING: Dictionary.trie unavailable, words resolve at silence only\n");
+    }
+    if (!dict_widx_open()) {
+        printf("WARNING: Dictionary.widx unavailable, word searches scan Dictionary.dat\n");
+    }
+    dict_xip_open();
+    return true;
+}
+
+static bool dict_read_word_at(FSIZE_t line_offset, char *word_out, size_t word_out_len) {
+    char line[DICT_LINE_BUF];
+    uint8_t key[DICT_KEY_SIZE];
+    if (!dict_read_line_at(&dict_file, line_offset, line)) return false;
+    return dict_parse_record_line(line, key, word_out, word_out_len);
+}
+
+// Lower-bound search for key inside one language segment. The fences that fall inside the segment
+// narrow it to one block range in RAM before touching the card.
+static const uint8_t *dict_bin_search_segment(const dict_bin_segment_t *seg, const uint8_t *key) {
+    uint32_t first = seg->first_block;
+    uint32_t end = first + seg->blocks;
+    uint32_t low = first;
+    uint32_t high = end;
+    if (seg->count == 0) return NULL;
+
+    if (dict_fence_count > 0) {
+        uint32_t fence_first = (first + dict_fence_stride - 1) / dict_fence_stride;
+        uint32_t fence_end = (end + dict_fence_stride - 1) / dict_fence_stride;
+        if (fence_end > dict_fence_count) fence_end = dict_fence_count;
+
+        uint32_t fence_low = fence_first;
+        uint32_t fence_high = fence_end;
+        while (fence_low < fence_high) {
+            uint32_t mid = fence_low + ((fence_high - fence_low) / 2);
+            if (memcmp(dict_fence_keys[mid], key, DICT_KEY_SIZE) < 0) {
+                fence_low = mid + 1;
+            } else {
+                fence_high = mid;
+            }
+        }
+
+        // Every fence before fence_low sorts below the key, every fence from fence_low on does not.
+        if (fence_low > fence_first) low = (fence_low - 1) * dict_fence_stride + 1;
+        if (fence_low < fence_end) high = fence_low * dict_fence_stride;
+    }
+
+    return dict_blocks_find(dict_bin_load_block, DICT_BIN_BLOCK_SIZE, false, first, end, low, high, key);
+}
+
+// The record points into dict_bin_block, so its line offset is read before anything else loads.
+static bool dict_bin_resolve(const uint8_t *record, char *word_out, size_t word_out_len) {
+    uint32_t line_offset = dict_bin_get_u32(&record[record[0] + 2]);
+    return dict_read_word_at(line_offset, word_out, word_out_len);
+}
+
+// Searches the target language's segment first. On a miss the other segments are tried in
+// directory order (ascending language ID, so LANG_UNKNOWN entries come first), which keeps the
+// cost of a same-language hit independent of how many languages the dictionary holds.
+static bool dict_search_bin(const uint8_t *seq, uint8_t target_lang, char *word_out, size_t word_out_len) {
+    if (!dict_bin_ready || dict_bin_segment_count == 0) return false;
+
+    uint8_t key[DICT_KEY_SIZE];
+    memcpy(key, seq, PHONEME_SEQ_MAX);
+
+    int primary = dict_bin_segment_index(target_lang);
+    if (primary >= 0) {
+        key[PHONEME_SEQ_MAX] = target_lang;
+        const uint8_t *record = dict_bin_search_segment(&dict_bin_segments[primary], key);
+        if (record) {
+            dict_stats.primary_hits++;
+            dict_resolved_lang = target_lang;
+            return dict_bin_resolve(record, word_out, word_out_len);
+        }
+    }
+
+    for (uint16_t i = 0; i < dict_bin_segment_count; i++) {
+        if ((int)i == primary) continue;
+        key[PHONEME_SEQ_MAX] = dict_bin_segments[i].lang;
+        dict_stats.fallback_searches++;
+        const uint8_t *record = dict_bin_search_segment(&dict_bin_segments[i], key);
+        if (record) {
+            dict_stats.fallback_hits++;
+            dict_resolved_lang = dict_bin_segments[i].lang;
+            return dict_bin_resolve(record, word_out, word_out_len);
+        }
+    }
+
+    return false;
+}
+
+// ==============================
+// Flash-resident dictionary (XIP)
+// ==============================
+// Program/erase run with interrupts off and core 1 parked in RAM (it executes from flash); the
+// SDK routines execute from RAM and flush the XIP cache.
+static void dict_xip_flash_erase(uint32_t offset) {
+    if (core1_running) multicore_lockout_start_blocking();
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    restore_interrupts(ints);
+    if (core1_running) multicore_lockout_end_blocking();
+}
+
+static void dict_xip_flash_program(uint32_t offset, const uint8_t *data) {
+    if (core1_running) multicore_lockout_start_blocking();
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_program(offset, data, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+    if (core1_running) multicore_lockout_end_blocking();
+}
+
+static const uint8_t *dict_xip_image(void) {
+    return (const uint8_t *)(XIP_BASE + DICT_XIP_FLASH_OFFSET);
+}
+
+static const uint8_t *dict_xip_block(uint32_t block) {
+    return dict_xip_image() + DICT_XIP_DATA_OFFSET + (size_t)block * DICT_XIP_BLOCK_SIZE;
+}
+
+// The reserved region has to sit above the end of the firmware image.
+static bool dict_xip_region_free(void) {
+    return (uintptr_t)&__flash_binary_end <= XIP_BASE + DICT_XIP_FLASH_OFFSET;
+}
+
+static void dict_xip_sync_abort(void) {
+    dict_xip_sync.active = false;
+}
+
+// Erases the header sector first, so the region reads as empty until dict_xip_sync_finish() runs.
+static bool dict_xip_sync_start(void) {
+    dict_xip_sync_abort();
+    dict_xip_ready = false;
+    if (!dict_xip_region_free()) {
+        printf("ERROR: firmware image overlaps the dictionary flash region\n");
+        return false;
+    }
+    if (!dict_bin_ready) {
+        printf("WARNING: flash dictionary needs Dictionary.bin, staying on SD\n");
+        return false;
+    }
+    // Worst case every block leaves a record's worth of padding, and every segment opens a block.
+    uint64_t blocks = dict_bin_payload_bytes / (DICT_XIP_BLOCK_SIZE - DICT_XIP_RECORD_MAX) + 1 + dict_bin_segment_count;
+    if (DICT_XIP_DATA_OFFSET + blocks * DICT_XIP_BLOCK_SIZE > DICT_XIP_REGION_BYTES) {
+        printf("WARNING: Dictionary.dat (%lu records) does not fit the %lu KB flash region, staying on SD\n",
+               (unsigned long)dict_bin_record_count, (unsigned long)(DICT_XIP_REGION_BYTES / 1024));
+        return false;
+    }
+
+    FILINFO src;
+    if (f_stat("0:/microsd/Dictionary.dat", &src) != FR_OK) return false;
+    dict_source_header_write(dict_xip_sync.stamp, "DXIP", DICT_XIP_VERSION, &src);
+
+    dict_xip_flash_erase(DICT_XIP_FLASH_OFFSET);
+    dict_xip_sync.segment = 0;
+    dict_xip_sync.block = 0;
+    dict_xip_sync.pos = 0;
+    dict_xip_sync.written = 0;
+    dict_xip_sync.fill = 0;
+    dict_xip_sync.records = 0;
+    dict_xip_sync.active = true;
+    return true;
+}
+
+// Appends bytes to the page buffer; full pages are programmed, erasing each sector on first use.
+static bool dict_xip_sync_emit(const uint8_t *data, uint32_t len) {
+    while (len > 0) {
+        uint32_t n = FLASH_PAGE_SIZE - dict_xip_sync.fill;
+        if (n > len) n = len;
+        memcpy(&dict_xip_sync.page[dict_xip_sync.fill], data, n);
+        dict_xip_sync.fill += n;
+        data += n;
+        len -= n;
+
+        if (dict_xip_sync.fill == FLASH_PAGE_SIZE) {
+            if (DICT_XIP_DATA_OFFSET + dict_xip_sync.written + FLASH_PAGE_SIZE > DICT_XIP_REGION_BYTES) return false;
+            uint32_t offset = DICT_XIP_FLASH_OFFSET + DICT_XIP_DATA_OFFSET + dict_xip_sync.written;
+            if (offset % FLASH_SECTOR_SIZE == 0) dict_xip_flash_erase(offset);
+            dict_xip_flash_program(offset, dict_xip_sync.page);
+            dict_xip_sync.written += FLASH_PAGE_SIZE;
+            dict_xip_sync.fill = 0;
+        }
+    }
+    return true;
+}
+
+// Closes the current block; the zero padding reads as the end of its records.
+static bool dict_xip_sync_pad(void) {
+    static const uint8_t zeros[DICT_XIP_BLOCK_SIZE] = {0};
+    if (dict_xip_sync.fill == 0) return true;
+    return dict_xip_sync_emit(zeros, DICT_XIP_BLOCK_SIZE - dict_xip_sync.fill);
+}
+
+static bool dict_xip_sync_finish(void) {
+    if (!dict_xip_sync_pad()) {
+        dict_xip_sync_abort();
+        return false;
+    }
+
+    uint8_t header[DICT_XIP_HEADER_BYTES];
+    memset(header, 0, sizeof(header));
+    memcpy(header, dict_xip_sync.stamp, 16);
+    dict_bin_put_u32(&header[16], dict_xip_sync.records);
+    dict_bin_put_u32(&header[20], dict_bin_segment_count);
+    dict_bin_put_u32(&header[24], DICT_XIP_BLOCK_SIZE);
+    dict_bin_put_u32(&header[28], dict_xip_sync.written / DICT_XIP_BLOCK_SIZE);
+    for (uint16_t i = 0; i < dict_bin_segment_count; i++) {
+        uint8_t *entry = &header[DICT_BIN_DIR_OFFSET + i * DICT_BIN_DIR_ENTRY_SIZE];
+        entry[0] = dict_bin_segments[i].lang;
+        dict_bin_put_u32(&entry[4], dict_xip_sync.seg_first[i]);
+        dict_bin_put_u32(&entry[8], dict_bin_segments[i].count);
+    }
+    for (uint32_t page = 0; page < DICT_XIP_HEADER_BYTES; page += FLASH_PAGE_SIZE) {
+        dict_xip_flash_program(DICT_XIP_FLASH_OFFSET + page, &header[page]);
+    }
+
+    dict_xip_sync.active = false;
+    dict_xip_syncs++;
+    printf("INFO: flash dictionary written (%lu records, %lu KB)\n",
+           (unsigned long)dict_xip_sync.records,
+           (unsigned long)((DICT_XIP_DATA_OFFSET + dict_xip_sync.written) / 1024));
+    return dict_xip_open();
+}
+
+// Copies records in Dictionary.bin segment order until `pages` more flash pages are programmed.
+// The words come from Dictionary.dat, whose offsets rise within a segment, so reads stay sequential.
+static bool dict_xip_sync_step(uint32_t pages) {
+    if (!dict_xip_sync.active) return false;
+
+    uint32_t target = dict_xip_sync.written + pages * FLASH_PAGE_SIZE;
+    while (dict_xip_sync.written < target) {
+        if (dict_xip_sync.segment >= dict_bin_segment_count) return dict_xip_sync_finish();
+
+        const dict_bin_segment_t *seg = &dict_bin_segments[dict_xip_sync.segment];
+        if (dict_xip_sync.block == 0 && dict_xip_sync.pos == 0) {
+            // Every segment starts on a fresh block.
+            if (!dict_xip_sync_pad()) break;
+            dict_xip_sync.seg_first[dict_xip_sync.segment] = dict_xip_sync.written / DICT_XIP_BLOCK_SIZE;
+        }
+        if (dict_xip_sync.block >= seg->blocks) {
+            dict_xip_sync.segment++;
+            dict_xip_sync.block = 0;
+            dict_xip_sync.pos = 0;
+            continue;
+        }
+
+        const uint8_t *data = dict_bin_load_block(seg->first_block + dict_xip_sync.block);
+        if (!data) break;
+        const uint8_t *bin_record = &data[dict_xip_sync.pos];
+        uint16_t size = dict_block_record_size(bin_record, data + DICT_BIN_BLOCK_SIZE, false);
+        if (size == 0) {
+            dict_xip_sync.block++;
+            dict_xip_sync.pos = 0;
+            continue;
+        }
+
+        uint8_t record[DICT_XIP_RECORD_MAX];
+        uint8_t packed = (uint8_t)(bin_record[0] + 2);
+        memcpy(record, bin_record, packed);
+        char word[DICT_WORD_SIZE + 1];
+        if (!dict_bin_resolve(bin_record, word, sizeof(word))) break;
+        uint8_t wlen = (uint8_t)strlen(word);
+        record[packed] = wlen;
+        memcpy(&record[packed + 1], word, wlen);
+        uint32_t rsize = (uint32_t)packed + 1 + wlen;
+
+        if (dict_xip_sync.fill + rsize > DICT_XIP_BLOCK_SIZE && !dict_xip_sync_pad()) break;
+        if (!dict_xip_sync_emit(record, rsize)) break;
+        dict_xip_sync.pos += size;
+        dict_xip_sync.records++;
+    }
+    if (dict_xip_sync.written < target) {
+        printf("ERROR: flash dictionary sync failed at record %lu\n", (unsigned long)dict_xip_sync.records);
+        dict_xip_sync_abort();
+        return false;
+    }
+    return true;
+}
+
+// Uses the flash image when its stamp matches Dictionary.dat; otherwise (re)starts a background sync.
+static bool dict_xip_open(void) {
+    dict_xip_ready = false;
+    dict_xip_segment_count = 0;
+    if (!DICT_XIP_ENABLE || !dict_xip_region_free()) return false;
+
+    FILINFO src;
+    if (f_stat("0:/microsd/Dictionary.dat", &src) != FR_OK) return false;
+
+    const uint8_t *header = dict_xip_image();
+    uint32_t records = dict_bin_get_u32(&header[16]);
+    uint32_t segments = dict_bin_get_u32(&header[20]);
+    uint32_t blocks = dict_bin_get_u32(&header[28]);
+    bool valid = dict_source_header_matches(header, "DXIP", DICT_XIP_VERSION, &src) &&
+                 dict_bin_get_u32(&header[24]) == DICT_XIP_BLOCK_SIZE &&
+                 segments <= DICT_BIN_MAX_SEGMENTS &&
+                 DICT_XIP_DATA_OFFSET + (uint64_t)blocks * DICT_XIP_BLOCK_SIZE <= DICT_XIP_REGION_BYTES;
+
+    uint32_t total = 0;
+    for (uint16_t i = 0; valid && i < segments; i++) {
+        const uint8_t *entry = &header[DICT_BIN_DIR_OFFSET + i * DICT_BIN_DIR_ENTRY_SIZE];
+        dict_xip_segment_t *seg = &dict_xip_segments[i];
+        seg->lang = entry[0];
+        seg->first_block = dict_bin_get_u32(&entry[4]);
+        seg->count = dict_bin_get_u32(&entry[8]);
+        if (seg->first_block > blocks || (i > 0 && seg->first_block < dict_xip_segments[i - 1].first_block)) valid = false;
+        if (i > 0) dict_xip_segments[i - 1].blocks = seg->first_block - dict_xip_segments[i - 1].first_block;
+        seg->blocks = blocks - seg->first_block;
+        total += seg->count;
+    }
+
+    if (!valid || total != records) {
+        if (DICT_XIP_AUTO_SYNC && !dict_xip_sync.active && dict_xip_sync_start()) {
+            printf("INFO: flash dictionary stale, syncing from SD in the background\n");
+        }
+        return false;
+    }
+
+    dict_xip_segment_count = (uint16_t)segments;
+    dict_xip_record_count = records;
+    dict_xip_ready = true;
+    return true;
+}
+
+static const uint8_t *dict_xip_search_segment(const dict_xip_segment_t *seg, const uint8_t *key) {
+    if (seg->count == 0) return NULL;
+    uint32_t end = seg->first_block + seg->blocks;
+    return dict_blocks_find(dict_xip_block, DICT_XIP_BLOCK_SIZE, true, seg->first_block, end, seg->first_block, end, key);
+}
+
+// Same segment order as dict_search_bin(), but every probe is a memory-mapped flash read.
+static bool dict_search_xip(const uint8_t *seq, uint8_t target_lang, char *word_out, size_t word_out_len) {
+    uint8_t key[DICT_KEY_SIZE];
+    memcpy(key, seq, PHONEME_SEQ_MAX);
+
+    int primary = -1;
+    for (uint16_t i = 0; i < dict_xip_segment_count; i++) {
+        if (dict_xip_segments[i].lang == target_lang) primary = i;
+    }
+
+    const uint8_t *record = NULL;
+    if (primary >= 0) {
+        key[PHONEME_SEQ_MAX] = target_lang;
+        record = dict_xip_search_segment(&dict_xip_segments[primary], key);
+        if (record) dict_stats.primary_hits++;
+    }
+    for (uint16_t i = 0; !record && i < dict_xip_segment_count; i++) {
+        if ((int)i == primary) continue;
+        key[PHONEME_SEQ_MAX] = dict_xip_segments[i].lang;
+        dict_stats.fallback_searches++;
+        record = dict_xip_search_segment(&dict_xip_segments[i], key);
+        if (record) dict_stats.fallback_hits++;
+    }
+    if (!record) return false;
+
+    dict_xip_hits++;
+    const uint8_t *word = &record[record[0] + 2];
+    size_t len = word[0];
+    if (len > word_out_len - 1) len = word_out_len - 1;
+    dict_resolved_lang = record[record[0] + 1];
+    memcpy(word_out, &word[1], len);
+    word_out[len] = '\0';
+    return true;
+}
+
+// True when a flash erase can park core 1 without stalling acquisition: no beam is signalling
+// WORD_READY, queued or mid-drain, and core 0 has consumed every entry in the ring.
+static bool stage2_acquisition_idle(void) {
+    if (!core1_running || stage2_acquisition_paused) return true;
+    if (stage2_ready_head != stage2_ready_tail) return false;
+    if (stage2_entry_head != stage2_entry_tail) return false;
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if (stage2_ready_queued[i]) return false;
+        if (((volatile stage2_drain_t *)&stage2_drain[i])->step != STAGE2_DRAIN_IDLE) return false;
+        if (!gpio_get(word_ready_pins[i])) return false;
+    }
+    return true;
+}
+
+// Main-loop hook: programs one flash sector of a pending sync per call, but only while core 1
+// has nothing to drain; XIPSYNC and the boot-time sync run unconditionally.
+static void dict_xip_tick(void) {
+    if (dict_xip_sync.active && stage2_acquisition_idle()) {
+        dict_xip_sync_step(FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE);
+    }
+}
+
+// ==============================
+// Dictionary.trie streaming matcher
+// ==============================
+typedef struct {
+    uint8_t phoneme;
+    uint8_t flags;
+    uint8_t child_count;   // children stored contiguously from first_child
+    uint32_t first_child;
+    uint32_t word_count;   // distinct phoneme sequences ending at or below this node
+    uint32_t line_offset;  // Dictionary.dat byte offset of the first line in the subtree
+} dict_trie_node_t;
+
+static void dict_trie_pack_node(const dict_trie_node_t *node, uint8_t *raw) {
+    raw[0] = node->phoneme;
+    raw[1] = node->flags;
+    raw[2] = node->child_count;
+    raw[3] = 0;
+    dict_bin_put_u32(&raw[4], node->first_child);
+    dict_bin_put_u32(&raw[8], node->word_count);
+    dict_bin_put_u32(&raw[12], node->line_offset);
+}
+
+static bool dict_trie_write_nodes(uint32_t index, const uint8_t *raw, uint32_t count) {
+    UINT len = (UINT)(count * DICT_TRIE_NODE_SIZE);
+    UINT bw = 0;
+    if (f_lseek(&dict_trie_file, DICT_BIN_BLOCK_SIZE + (FSIZE_t)index * DICT_TRIE_NODE_SIZE) != FR_OK) return false;
+    return f_write(&dict_trie_file, raw, len, &bw) == FR_OK && bw == len;
+}
+
+static void dict_trie_unpack_node(const uint8_t *raw, dict_trie_node_t *node) {
+    node->phoneme = raw[0];
+    node->flags = raw[1];
+    node->child_count = raw[2];
+    node->first_child = dict_bin_get_u32(&raw[4]);
+    node->word_count = dict_bin_get_u32(&raw[8]);
+    node->line_offset = dict_bin_get_u32(&raw[12]);
+}
+
+// Reads count consecutive nodes (one child block) in a single f_read.
+static bool dict_trie_read_nodes(uint32_t index, uint8_t *raw, uint32_t count) {
+    if (!dict_trie_ready || index >= dict_trie_node_count || count > dict_trie_node_count - index) return false;
+
+    UINT len = (UINT)(count * DICT_TRIE_NODE_SIZE);
+    UINT br = 0;
+    if (f_lseek(&dict_trie_file, DICT_BIN_BLOCK_SIZE + (FSIZE_t)index * DICT_TRIE_NODE_SIZE) != FR_OK) return false;
+    return f_read(&dict_trie_file, raw, len, &br) == FR_OK && br == len;
+}
+
+// Nodes are 16-byte aligned inside 512-byte sectors, so sibling walks are served from the FIL sector buffer.
+static bool dict_trie_read_node(uint32_t index, dict_trie_node_t *node) {
+    uint8_t raw[DICT_TRIE_NODE_SIZE];
+    if (!dict_trie_read_nodes(index, raw, 1)) return false;
+    dict_trie_unpack_node(raw, node);
+    return true;
+}
+
+// One pass over the sorted Dictionary.dat. Nodes on the current path stay open in RAM together with
+// their finished children, which sit in dict_build_scratch as a stack: the children of path[d] start
+// at kid_base[d] and those of path[d + 1] right after them. When a node closes its child block is
+// appended to the file, so blocks land in post-order and every write except the final root patch is
+// sequential.
+static bool dict_trie_close_node(dict_trie_node_t *path, const uint16_t *kid_base, uint8_t depth, uint32_t *next_index) {
+    uint8_t *kids = dict_build_scratch;
+    dict_trie_node_t *node = &path[depth];
+    node->first_child = *next_index;
+    if (node->child_count > 0) {
+        if (!dict_trie_write_nodes(*next_index, &kids[kid_base[depth] * DICT_TRIE_NODE_SIZE], node->child_count)) {
+            return false;
+        }
+        *next_index += node->child_count;
+    }
+    if (depth == 0) return true;
+
+    dict_trie_node_t *parent = &path[depth - 1];
+    if (parent->child_count >= DICT_TRIE_MAX_CHILDREN) {
+        printf("ERROR: Dictionary.trie node at depth %u has more than %d children\n", depth - 1, DICT_TRIE_MAX_CHILDREN);
+        return false;
+    }
+    parent->word_count += node->word_count;
+    dict_trie_pack_node(node, &kids[(kid_base[depth - 1] + parent->child_count) * DICT_TRIE_NODE_SIZE]);
+    parent->child_count++;
+    return true;
+}
+
+static bool dict_trie_build(const FILINFO *src) {
+    FRESULT res = f_open(&dict_trie_file, "0:/microsd/Dictionary.trie", FA_READ | FA_WRITE | FA_CREATE_ALWAYS);
+    if (res != FR_OK) {
+        printf("ERROR: f_open Dictionary.trie failed with code %d\n", res);
+        return false;
+    }
+
+    // Header block stays zeroed until the root is written, so an interrupted build reads as stale.
+    uint8_t header[DICT_BIN_BLOCK_SIZE];
+    memset(header, 0, sizeof(header));
+    UINT bw = 0;
+    if (f_write(&dict_trie_file, header, sizeof(header), &bw) != FR_OK || bw != sizeof(header)) goto fail;
+
+    static dict_trie_node_t path[PHONEME_SEQ_MAX + 1];
+    uint16_t kid_base[PHONEME_SEQ_MAX + 1];
+    uint8_t prev_seq[PHONEME_SEQ_MAX] = {0};
+    uint8_t prev_len = 0;
+    uint8_t depth = 0;
+    uint32_t next_index = DICT_TRIE_ROOT + 1;
+    dict_reader_t reader;
+    char line[DICT_LINE_BUF];
+    FSIZE_t line_offset = 0;
+
+    memset(&path[0], 0, sizeof(path[0]));
+    kid_base[0] = 0;
+
+    if (!dict_reader_start(&reader, &dict_file, 0)) goto fail;
+    while (dict_reader_next(&reader, line, sizeof(line), &line_offset)) {
+        uint8_t key[DICT_KEY_SIZE];
+        if (!dict_parse_record_key(line, key)) {
+            printf("ERROR: Dictionary.dat line at byte %lu is malformed\n", (unsigned long)line_offset);
+            goto fail;
+        }
+
+        uint8_t len = dict_seq_length(key);
+        if (len == 0) continue;
+        // Same sequence in another language: already counted on the first line.
+        if (len == prev_len && memcmp(key, prev_seq, len) == 0) continue;
+
+        uint8_t common = 0;
+        while (common < len && common < prev_len && key[common] == prev_seq[common]) common++;
+
+        while (depth > common) {
+            if (!dict_trie_close_node(path, kid_base, depth, &next_index)) goto fail;
+            depth--;
+        }
+
+        while (depth < len) {
+            uint32_t base = (uint32_t)kid_base[depth] + path[depth].child_count + 1;
+            if (base + DICT_TRIE_MAX_CHILDREN > DICT_SCRATCH_NODES) {
+                printf("ERROR: Dictionary.trie build needs more than %d open nodes\n", DICT_SCRATCH_NODES);
+                goto fail;
+            }
+            depth++;
+            kid_base[depth] = (uint16_t)base;
+            memset(&path[depth], 0, sizeof(path[depth]));
+            path[depth].phoneme = key[depth - 1];
+            path[depth].line_offset = (uint32_t)line_offset;
+        }
+
+        if (!(path[depth].flags & DICT_TRIE_FLAG_TERMINAL)) {
+            path[depth].flags |= DICT_TRIE_FLAG_TERMINAL;
+            path[depth].word_count++;
+            path[depth].line_offset = (uint32_t)line_offset;
+        }
+
+        memcpy(prev_seq, key, PHONEME_SEQ_MAX);
+        prev_len = len;
+    }
+    if (reader.error) goto fail;
+
+    for (;;) {
+        if (!dict_trie_close_node(path, kid_base, depth, &next_index)) goto fail;
+        if (depth == 0) break;
+        depth--;
+    }
+    uint8_t raw[DICT_TRIE_NODE_SIZE];
+    dict_trie_pack_node(&path[0], raw);
+    if (!dict_trie_write_nodes(DICT_TRIE_ROOT, raw, 1)) goto fail;
+
+    dict_source_header_write(header, "DTRI", DICT_TRIE_VERSION, src);
+    dict_bin_put_u32(&header[16], next_index);
+    if (f_lseek(&dict_trie_file, 0) != FR_OK) goto fail;
+    if (f_write(&dict_trie_file, header, sizeof(header), &bw) != FR_OK || bw != sizeof(header)) goto fail;
+    if (f_sync(&dict_trie_file) != FR_OK) goto fail;
+
+    dict_trie_node_count = next_index;
+    printf("INFO: Dictionary.trie rebuilt (%lu nodes, %lu sequences)\n",
+           (unsigned long)next_index, (unsigned long)path[0].word_count);
+    return true;
+
+fail:
+    f_close(&dict_trie_file);
+    return false;
+}
+
+// Opens Dictionary.trie, rebuilding it when it no longer matches Dictionary.dat.
+static bool dict_trie_open(void) {
+    dict_trie_ready = false;
+    dict_trie_node_count = 0;
+
+    FILINFO src;
+    if (f_stat("0:/microsd/Dictionary.dat", &src) != FR_OK) return false;
+
+    if (f_open(&dict_trie_file, "0:/microsd/Dictionary.trie", FA_READ | FA_WRITE | FA_OPEN_EXISTING) == FR_OK) {
+        uint8_t header[20];
+        UINT br = 0;
+        if (f_read(&dict_trie_file, header, sizeof(header), &br) == FR_OK && br == sizeof(header) &&
+            dict_source_header_matches(header, "DTRI", DICT_TRIE_VERSION, &src)) {
+            dict_trie_node_count = dict_bin_get_u32(&header[16]);
+            dict_trie_ready = true;
+            dict_enable_fast_seek(&dict_trie_file, dict_trie_clmt);
+            return true;
+        }
+        f_close(&dict_trie_file);
+    }
+
+    if (!dict_trie_build(&src)) return false;
+    dict_trie_ready = true;
+    dict_enable_fast_seek(&dict_trie_file, dict_trie_clmt);
+    return true;
+}
+
+// Follows the child edge labelled with phoneme. The sorted child block is scanned in place.
+static uint32_t dict_trie_step(uint32_t parent, uint8_t phoneme) {
+    dict_trie_node_t node;
+    if (parent == DICT_TRIE_NONE || !dict_trie_read_node(parent, &node)) return DICT_TRIE_NONE;
+
+    uint32_t first = node.first_child;
+    for (uint8_t i = 0; i < node.child_count; i++) {
+        dict_trie_node_t child;
+        if (!dict_trie_read_node(first + i, &child)) return DICT_TRIE_NONE;
+        if (child.phoneme == phoneme) return first + i;
+        if (child.phoneme > phoneme) break;
+    }
+    return DICT_TRIE_NONE;
+}
+
+// When exactly one dictionary sequence continues the prefix at index, returns that full sequence.
+static bool dict_trie_unique_completion(uint32_t index, uint8_t *seq_out) {
+    dict_trie_node_t node;
+    if (index == DICT_TRIE_NONE || !dict_trie_read_node(index, &node)) return false;
+    if (node.word_count != 1) return false;
+
+    char line[DICT_LINE_BUF];
+    uint8_t key[DICT_KEY_SIZE];
+    if (!dict_read_line_at(&dict_file, node.line_offset, line)) return false;
+    if (!dict_parse_record_key(line, key)) return false;
+    memcpy(seq_out, key, PHONEME_SEQ_MAX);
+    return true;
+}
+
+// ==============================
+// Phrases.ac phrase spotting
+// ==============================
+typedef struct {
+    uint32_t first_edge;
+    uint8_t edge_count;
+    uint8_t depth;       // phonemes from the root
+    uint32_t fail;       // state of the longest proper suffix that is also a prefix
+    uint32_t output;     // pattern index + 1 of the longest pattern ending here (own or via fail), 0 = none
+} dict_phrase_node_t;
+
+typedef struct {
+    uint8_t length;      // phonemes
+    uint8_t lang;
+    uint8_t words;
+    uint8_t text_len;
+    uint32_t text_offset;
+} dict_phrase_pattern_t;
+
+// Phrases.ac is independent of Dictionary.dat (the compiler copies the words in), so it is opened
+// once at boot and stays valid across compactions. A missing file just disables phrase spotting.
+static bool dict_phrase_open(void) {
+    dict_phrase_ready = false;
+    if (f_open(&dict_phrase_file, DICT_PHRASE_PATH, FA_READ | FA_OPEN_EXISTING) != FR_OK) return false;
+
+    uint8_t header[24];
+    UINT br = 0;
+    if (f_read(&dict_phrase_file, header, sizeof(header), &br) != FR_OK || br != sizeof(header) ||
+        memcmp(header, "DPHR", 4) != 0 || dict_bin_get_u32(&header[4]) != DICT_PHRASE_VERSION) {
+        printf("WARNING: Phrases.ac has an unknown format, phrase spotting disabled\n");
+        f_close(&dict_phrase_file);
+        return false;
+    }
+
+    dict_phrase_node_count = dict_bin_get_u32(&header[8]);
+    dict_phrase_edge_count = dict_bin_get_u32(&header[12]);
+    dict_phrase_pattern_count = dict_bin_get_u32(&header[16]);
+    uint32_t text_bytes = dict_bin_get_u32(&header[20]);
+    dict_phrase_edge_base = DICT_BIN_BLOCK_SIZE + (FSIZE_t)dict_phrase_node_count * DICT_PHRASE_NODE_SIZE;
+    dict_phrase_pattern_base = dict_phrase_edge_base + (FSIZE_t)dict_phrase_edge_count * DICT_PHRASE_EDGE_SIZE;
+    dict_phrase_text_base = dict_phrase_pattern_base + (FSIZE_t)dict_phrase_pattern_count * DICT_PHRASE_PATTERN_SIZE;
+
+    if (dict_phrase_node_count == 0 || f_size(&dict_phrase_file) != dict_phrase_text_base + text_bytes) {
+        printf("WARNING: Phrases.ac is truncated, phrase spotting disabled\n");
+        f_close(&dict_phrase_file);
+        return false;
+    }
+
+    dict_phrase_ready = true;
+    dict_enable_fast_seek(&dict_phrase_file, dict_phrase_clmt);
+    return true;
+}
+
+static bool dict_phrase_read(FSIZE_t offset, void *buf, UINT len) {
+    UINT br = 0;
+    dict_phrase_stats.reads++;
+    if (f_lseek(&dict_phrase_file, offset) != FR_OK) return false;
+    return f_read(&dict_phrase_file, buf, len, &br) == FR_OK && br == len;
+}
+
+static bool dict_phrase_read_node(uint32_t index, dict_phrase_node_t *node) {
+    uint8_t raw[DICT_PHRASE_NODE_SIZE];
+    if (index >= dict_phrase_node_count) return false;
+    if (!dict_phrase_read(DICT_BIN_BLOCK_SIZE + (FSIZE_t)index * DICT_PHRASE_NODE_SIZE, raw, sizeof(raw))) return false;
+    node->first_edge = dict_bin_get_u32(&raw[0]);
+    node->edge_count = raw[4];
+    node->depth = raw[5];
+    node->fail = dict_bin_get_u32(&raw[8]);
+    node->output = dict_bin_get_u32(&raw[12]);
+    return true;
+}
+
+static bool dict_phrase_read_pattern(uint32_t index, dict_phrase_pattern_t *pattern) {
+    uint8_t raw[DICT_PHRASE_PATTERN_SIZE];
+    if (index >= dict_phrase_pattern_count) return false;
+    if (!dict_phrase_read(dict_phrase_pattern_base + (FSIZE_t)index * DICT_PHRASE_PATTERN_SIZE, raw, sizeof(raw))) {
+        return false;
+    }
+    pattern->length = raw[0];
+    pattern->lang = raw[1];
+    pattern->words = raw[2];
+    pattern->text_len = raw[3];
+    pattern->text_offset = dict_bin_get_u32(&raw[4]);
+    return true;
+}
+
+// One automaton transition: the goto edge when the state has one, otherwise failure links
+// towards the root. node_out receives the new state.
+static bool dict_phrase_goto(uint32_t state, uint8_t phoneme, uint32_t *state_out, dict_phrase_node_t *node_out) {
+    uint8_t edges[DICT_PHRASE_MAX_EDGES * DICT_PHRASE_EDGE_SIZE];
+    dict_phrase_node_t node;
+
+    for (;;) {
+        if (!dict_phrase_read_node(state, &node)) return false;
+
+        uint8_t count = node.edge_count;
+        if (count > DICT_PHRASE_MAX_EDGES || (uint64_t)node.first_edge + count > dict_phrase_edge_count) return false;
+        if (count > 0 &&
+            !dict_phrase_read(dict_phrase_edge_base + (FSIZE_t)node.first_edge * DICT_PHRASE_EDGE_SIZE, edges,
+                              (UINT)count * DICT_PHRASE_EDGE_SIZE)) {
+            return false;
+        }
+
+        int low = 0;
+        int high = (int)count - 1;
+        while (low <= high) {
+            int mid = (low + high) / 2;
+            const uint8_t *edge = &edges[mid * DICT_PHRASE_EDGE_SIZE];
+            if (edge[0] == phoneme) {
+                *state_out = (uint32_t)edge[1] | ((uint32_t)edge[2] << 8) | ((uint32_t)edge[3] << 16);
+                return dict_phrase_read_node(*state_out, node_out);
+            }
+            if (edge[0] < phoneme) {
+                low = mid + 1;
+            } else {
+                high = mid - 1;
+            }
+        }
+
+        if (state == DICT_TRIE_ROOT) {
+            *state_out = DICT_TRIE_ROOT;
+            *node_out = node;
+            return true;
+        }
+        state = node.fail;
+        dict_phrase_stats.fail_steps++;
+    }
+}
+
+static void dict_phrase_reset(phrase_cursor_t *cursor) {
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->state = DICT_TRIE_ROOT;
+}
+
+// A final match is emitted only when it continues the emitted ones from the segment start and
+// the caller allows it; otherwise it is dropped and the segment goes to the silence lookup.
+static uint32_t dict_phrase_release(phrase_cursor_t *cursor, bool may_emit) {
+    uint32_t released = cursor->pending;
+    if (released != 0) {
+        cursor->floor = (uint16_t)(cursor->pending_end + 1);
+        if (may_emit && cursor->pending_start == cursor->covered) {
+            cursor->covered = cursor->floor;
+            cursor->hits++;
+        } else {
+            dict_phrase_stats.dropped++;
+            released = 0;
+        }
+    }
+    cursor->pending = 0;
+    return released;
+}
+
+// Feeds one phoneme. Returns the pattern index + 1 of a match that became final, 0 if none.
+// Any match that can still arrive is a suffix of the automaton state, so once that state starts
+// after the held match's start nothing longer from the same start is possible. Patterns in a
+// language other than target_lang (LANG_UNKNOWN = any) are not matches.
+static uint32_t dict_phrase_feed(phrase_cursor_t *cursor, uint8_t phoneme, uint8_t target_lang, bool may_emit) {
+    if (!dict_phrase_ready) return 0;
+
+    uint32_t state = DICT_TRIE_ROOT;
+    dict_phrase_node_t node;
+    dict_phrase_stats.steps++;
+    if (!dict_phrase_goto(cursor->state, phoneme, &state, &node)) {
+        cursor->state = DICT_TRIE_ROOT;
+        return dict_phrase_release(cursor, may_emit);
+    }
+    cursor->state = state;
+    if (cursor->pos == UINT16_MAX) return dict_phrase_release(cursor, may_emit);
+    uint16_t pos = cursor->pos++;
+
+    uint32_t released = 0;
+    dict_phrase_pattern_t pattern;
+    if (node.output != 0 && dict_phrase_read_pattern(node.output - 1, &pattern) && pattern.length > 0 &&
+        pattern.length <= pos + 1 && (target_lang == LANG_UNKNOWN || pattern.lang == target_lang)) {
+        uint16_t start = (uint16_t)(pos + 1 - pattern.length);
+        if (start < cursor->floor) {
+            // Overlaps a match that was already emitted
+        } else if (cursor->pending == 0 || start <= cursor->pending_start) {
+            if (cursor->pending != 0) dict_phrase_stats.superseded++;
+            cursor->pending = node.output;
+            cursor->pending_start = start;
+            cursor->pending_end = pos;
+        } else if (start > cursor->pending_end) {
+            released = dict_phrase_release(cursor, may_emit);
+            cursor->pending = node.output;
+            cursor->pending_start = start;
+            cursor->pending_end = pos;
+        }
+        // A match starting inside the held one loses to it.
+    }
+
+    if (released == 0 && cursor->pending != 0 && pos + 1 - node.depth > cursor->pending_start) {
+        released = dict_phrase_release(cursor, may_emit);
+    }
+    return released;
+}
+
+// Silence: whatever is held is final.
+static uint32_t dict_phrase_flush(phrase_cursor_t *cursor, bool may_emit) {
+    return dict_phrase_release(cursor, may_emit);
+}
+
+// True when the emitted matches spell out the whole segment, so the silence lookup has nothing left.
+static bool dict_phrase_covered(const phrase_cursor_t *cursor) {
+    return cursor->hits > 0 && cursor->covered == cursor->pos;
+}
+
+static bool dict_phrase_text(uint32_t match, char *text_out, size_t text_out_len, bool *phrase_out) {
+    dict_phrase_pattern_t pattern;
+    if (match == 0 || text_out_len < 2 || !dict_phrase_read_pattern(match - 1, &pattern)) return false;
+
+    size_t len = pattern.text_len;
+    if (len > text_out_len - 1) len = text_out_len - 1;
+    if (!dict_phrase_read(dict_phrase_text_base + pattern.text_offset, text_out, (UINT)len)) return false;
+    text_out[len] = '\0';
+    if (phrase_out) *phrase_out = pattern.words > 1;
+
+    dict_phrase_stats.hits++;
+    if (pattern.words > 1) dict_phrase_stats.phrase_hits++;
+    return true;
+}
+
+// ==============================
+// Dictionary.widx word index
+// ==============================
+// FNV-1a over the lower-cased word, so the hash agrees with strcasecmp_local().
+static uint32_t dict_word_hash(const char *word) {
+    uint32_t h = 2166136261u;
+    while (*word) {
+        h ^= (uint8_t)tolower((unsigned char)*word++);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Linear probing inside one bucket; false when the bucket is already full. Slots with the same hash
+// stay in line order whatever order they arrive in, so a word present in several languages
+// resolves to its first line.
+static bool dict_widx_place(uint8_t *bucket, uint32_t hash, uint32_t stored_offset) {
+    uint32_t start = (hash >> 16) % DICT_WIDX_SLOTS_PER_BUCKET;
+    for (uint32_t i = 0; i < DICT_WIDX_SLOTS_PER_BUCKET; i++) {
+        uint8_t *slot = &bucket[((start + i) % DICT_WIDX_SLOTS_PER_BUCKET) * DICT_WIDX_SLOT_SIZE];
+        uint32_t slot_offset = dict_bin_get_u32(&slot[4]);
+        if (slot_offset == 0) {
+            dict_bin_put_u32(&slot[0], hash);
+            dict_bin_put_u32(&slot[4], stored_offset);
+            return true;
+        }
+        if (dict_bin_get_u32(&slot[0]) == hash && slot_offset > stored_offset) {
+            dict_bin_put_u32(&slot[4], stored_offset);
+            stored_offset = slot_offset;
+        }
+    }
+    return false;
+}
+
+// Splits the pairs for chunks [first_chunk, first_chunk + chunks) into up to DICT_WIDX_RUNS runs
+// of narrower chunk ranges, appended as blocks after everything written so far.
+typedef struct {
+    uint32_t buckets;
+    uint32_t first_chunk;
+    uint32_t chunks;
+    uint32_t runs;
+    uint32_t *next_block;
+    uint32_t heads[DICT_WIDX_RUNS];  // last block written per run, 0 = none
+} dict_widx_split_t;
+
+static void dict_widx_split_begin(dict_widx_split_t *split, uint32_t buckets, uint32_t first_chunk,
+                                  uint32_t chunks, uint32_t *next_block) {
+    split->buckets = buckets;
+    split->first_chunk = first_chunk;
+    split->chunks = chunks;
+    split->runs = chunks < DICT_WIDX_RUNS ? chunks : DICT_WIDX_RUNS;
+    split->next_block = next_block;
+    memset(split->heads, 0, sizeof(split->heads));
+    for (uint32_t r = 0; r < split->runs; r++) {
+        dict_bin_put_u32(&dict_build_scratch[r * DICT_BIN_BLOCK_SIZE + 4], 0);
+    }
+}
+
+static uint32_t dict_widx_run_first_chunk(const dict_widx_split_t *split, uint32_t run) {
+    return split->first_chunk + (run * split->chunks + split->runs - 1) / split->runs;
+}
+
+static bool dict_widx_run_flush(dict_widx_split_t *split, uint32_t run) {
+    uint8_t *block = &dict_build_scratch[run * DICT_BIN_BLOCK_SIZE];
+    if (dict_bin_get_u32(&block[4]) == 0) return true;
+
+    dict_bin_put_u32(&block[0], split->heads[run]);
+    UINT bw = 0;
+    if (f_lseek(&dict_widx_file, (FSIZE_t)*split->next_block * DICT_BIN_BLOCK_SIZE) != FR_OK) return false;
+    if (f_write(&dict_widx_file, block, DICT_BIN_BLOCK_SIZE, &bw) != FR_OK || bw != DICT_BIN_BLOCK_SIZE) return false;
+    split->heads[run] = (*split->next_block)++;
+    dict_bin_put_u32(&block[4], 0);
+    return true;
+}
+
+static bool dict_widx_run_add(dict_widx_split_t *split, uint32_t hash, uint32_t stored_offset) {
+    uint32_t chunk = (hash % split->buckets) / DICT_WIDX_CHUNK_BUCKETS;
+    if (chunk < split->first_chunk || chunk >= split->first_chunk + split->chunks) return false;
+    uint32_t run = (uint32_t)((uint64_t)(chunk - split->first_chunk) * split->runs / split->chunks);
+
+    uint8_t *block = &dict_build_scratch[run * DICT_BIN_BLOCK_SIZE];
+    uint32_t count = dict_bin_get_u32(&block[4]);
+    dict_bin_put_u32(&block[8 + count * DICT_WIDX_SLOT_SIZE], hash);
+    dict_bin_put_u32(&block[12 + count * DICT_WIDX_SLOT_SIZE], stored_offset);
+    dict_bin_put_u32(&block[4], count + 1);
+    return count + 1 < DICT_WIDX_RUN_PAIRS || dict_widx_run_flush(split, run);
+}
+
+// Reads one run block into the last scratch block, which neither the run buffers nor the chunk's
+// buckets use.
+static const uint8_t *dict_widx_run_read(uint32_t block_index) {
+    uint8_t *block = &dict_build_scratch[DICT_WIDX_RUNS * DICT_BIN_BLOCK_SIZE];
+    UINT br = 0;
+    if (f_lseek(&dict_widx_file, (FSIZE_t)block_index * DICT_BIN_BLOCK_SIZE) != FR_OK) return NULL;
+    if (f_read(&dict_widx_file, block, DICT_BIN_BLOCK_SIZE, &br) != FR_OK || br != DICT_BIN_BLOCK_SIZE) return NULL;
+    if (dict_bin_get_u32(&block[4]) > DICT_WIDX_RUN_PAIRS) return NULL;
+    return block;
+}
+
+// Places one chunk's run into its DICT_WIDX_BUILD_BYTES of buckets and writes them once.
+static bool dict_widx_fill_chunk(uint32_t buckets, uint32_t chunk, uint32_t head, bool *overflow) {
+    uint32_t first = chunk * DICT_WIDX_CHUNK_BUCKETS;
+    uint32_t count = buckets - first;
+    if (count > DICT_WIDX_CHUNK_BUCKETS) count = DICT_WIDX_CHUNK_BUCKETS;
+    memset(dict_build_scratch, 0, count * DICT_BIN_BLOCK_SIZE);
+
+    for (uint32_t block_index = head; block_index != 0;) {
+        const uint8_t *block = dict_widx_run_read(block_index);
+        if (!block) return false;
+        uint32_t pairs = dict_bin_get_u32(&block[4]);
+        for (uint32_t p = 0; p < pairs; p++) {
+            uint32_t hash = dict_bin_get_u32(&block[8 + p * DICT_WIDX_SLOT_SIZE]);
+            uint32_t bucket = hash % buckets;
+            if (bucket < first || bucket >= first + count) return false;
+            if (!dict_widx_place(&dict_build_scratch[(bucket - first) * DICT_BIN_BLOCK_SIZE], hash,
+                                 dict_bin_get_u32(&block[12 + p * DICT_WIDX_SLOT_SIZE]))) {
+                *overflow = true;
+                return true;
+            }
+        }
+        block_index = dict_bin_get_u32(&block[0]);
+    }
+
+    UINT bw = 0;
+    UINT len = (UINT)(count * DICT_BIN_BLOCK_SIZE);
+    if (f_lseek(&dict_widx_file, (FSIZE_t)(1 + first) * DICT_BIN_BLOCK_SIZE) != FR_OK) return false;
+    return f_write(&dict_widx_file, dict_build_scratch, len, &bw) == FR_OK && bw == len;
+}
+
+static bool dict_widx_fill_range(uint32_t buckets, uint32_t first_chunk, uint32_t chunks, uint32_t head,
+                                 uint32_t *next_block, bool *overflow);
+
+static bool dict_widx_split_flush(dict_widx_split_t *split) {
+    for (uint32_t r = 0; r < split->runs; r++) {
+        if (!dict_widx_run_flush(split, r)) return false;
+    }
+    return true;
+}
+
+// Fills each flushed run's chunk range in turn; the runs' scratch blocks are free again by then, so
+// the next level reuses them.
+static bool dict_widx_split_fill(dict_widx_split_t *split, bool *overflow) {
+    for (uint32_t r = 0; r < split->runs && !*overflow; r++) {
+        uint32_t first = dict_widx_run_first_chunk(split, r);
+        uint32_t next = r + 1 < split->runs ? dict_widx_run_first_chunk(split, r + 1) : split->first_chunk + split->chunks;
+        if (!dict_widx_fill_range(split->buckets, first, next - first, split->heads[r], split->next_block, overflow)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Every level reads and writes each pair once and narrows the chunk range up to DICT_WIDX_RUNS
+// times, so a chunk only ever reads its own pairs and the build stays linear in the record count.
+static bool dict_widx_fill_range(uint32_t buckets, uint32_t first_chunk, uint32_t chunks, uint32_t head,
+                                 uint32_t *next_block, bool *overflow) {
+    if (chunks == 1) return dict_widx_fill_chunk(buckets, first_chunk, head, overflow);
+
+    dict_widx_split_t split;
+    dict_widx_split_begin(&split, buckets, first_chunk, chunks, next_block);
+    for (uint32_t block_index = head; block_index != 0;) {
+        const uint8_t *block = dict_widx_run_read(block_index);
+        if (!block) return false;
+        uint32_t pairs = dict_bin_get_u32(&block[4]);
+        for (uint32_t p = 0; p < pairs; p++) {
+            if (!dict_widx_run_add(&split, dict_bin_get_u32(&block[8 + p * DICT_WIDX_SLOT_SIZE]),
+                                   dict_bin_get_u32(&block[12 + p * DICT_WIDX_SLOT_SIZE]))) {
+                return false;
+            }
+        }
+        block_index = dict_bin_get_u32(&block[0]);
+    }
+    return dict_widx_split_flush(&split) && dict_widx_split_fill(&split, overflow);
+}
+
+// One pass over Dictionary.dat splits the (hash, line offset) pairs into runs after the bucket area;
+// dict_widx_fill_range() narrows them down to single chunks, so no bucket is rewritten on the card.
+static bool dict_widx_fill(uint32_t buckets, uint32_t *pairs_out) {
+    uint32_t chunks = (buckets + DICT_WIDX_CHUNK_BUCKETS - 1) / DICT_WIDX_CHUNK_BUCKETS;
+    uint32_t next_block = 1 + buckets;
+    dict_widx_split_t split;
+    dict_widx_split_begin(&split, buckets, 0, chunks, &next_block);
+
+    dict_reader_t reader;
+    char line[DICT_LINE_BUF];
+    char word[DICT_WORD_SIZE + 1];
+    uint8_t key[DICT_KEY_SIZE];
+    FSIZE_t line_offset = 0;
+    uint32_t pairs = 0;
+    if (!dict_reader_start(&reader, &dict_file, 0)) return false;
+    while (dict_reader_next(&reader, line, sizeof(line), &line_offset)) {
+        if (!dict_parse_record_line(line, key, word, sizeof(word)) || word[0] == '\0') continue;
+        if (!dict_widx_run_add(&split, dict_word_hash(word), (uint32_t)line_offset + 1)) return false;
+        pairs++;
+    }
+    if (reader.error) return false;
+
+    if (!dict_widx_split_flush(&split)) return false;
+
+    // The later levels seek back and forth between runs. Size the file for all of them now, so
+    // those seeks go through a cluster link map instead of walking the FAT from the start: each
+    // level writes every pair once more, plus at most one part-filled block per chunk range.
+    uint32_t levels = 0;
+    for (uint32_t span = chunks; span > 1; span = (span + DICT_WIDX_RUNS - 1) / DICT_WIDX_RUNS) levels++;
+    uint32_t reserve = next_block + (levels > 1 ? levels - 1 : 0) * ((pairs + DICT_WIDX_RUN_PAIRS - 1) / DICT_WIDX_RUN_PAIRS) +
+                       2 * chunks;
+    if (f_lseek(&dict_widx_file, (FSIZE_t)reserve * DICT_BIN_BLOCK_SIZE) != FR_OK) return false;
+    dict_enable_fast_seek(&dict_widx_file, dict_widx_clmt);
+
+    bool overflow = false;
+    bool ok = dict_widx_split_fill(&split, &overflow);
+    dict_widx_file.cltbl = NULL;  // dict_widx_build() truncates the runs away
+    if (!ok) return false;
+    if (overflow) {
+        *pairs_out = 0;
+        return true;  // bucket overflow, caller retries with more buckets
+    }
+    *pairs_out = pairs == 0 ? UINT32_MAX : pairs;
+    return true;
+}
+
+static bool dict_widx_build(const FILINFO *src) {
+    FRESULT res = f_open(&dict_widx_file, "0:/microsd/Dictionary.widx", FA_READ | FA_WRITE | FA_CREATE_ALWAYS);
+    if (res != FR_OK) {
+        printf("ERROR: f_open Dictionary.widx failed with code %d\n", res);
+        return false;
+    }
+
+    // Header block stays zeroed until the buckets are complete, so an interrupted build reads as stale.
+    uint8_t header[DICT_BIN_BLOCK_SIZE];
+    memset(header, 0, sizeof(header));
+    UINT bw = 0;
+    if (f_write(&dict_widx_file, header, sizeof(header), &bw) != FR_OK || bw != sizeof(header)) goto fail;
+
+    // Half-full buckets on average; a (rare) full bucket doubles the bucket count and retries.
+    // Without Dictionary.bin the record count is estimated from the shortest plausible line.
+    uint32_t records = dict_bin_ready ? dict_bin_record_count : (uint32_t)(src->fsize / 16);
+    uint32_t buckets = (records * 2 + DICT_WIDX_SLOTS_PER_BUCKET - 1) / DICT_WIDX_SLOTS_PER_BUCKET;
+    if (buckets == 0) buckets = 1;
+
+    uint32_t pairs = 0;
+    for (int attempt = 0; attempt < 3 && pairs == 0; attempt++) {
+        if (attempt > 0) buckets *= 2;
+        if (!dict_widx_fill(buckets, &pairs)) goto fail;
+    }
+    if (pairs == 0) {
+        printf("ERROR: Dictionary.widx bucket overflow\n");
+        goto fail;
+    }
+    if (pairs == UINT32_MAX) pairs = 0;
+
+    // Drop the runs that followed the buckets.
+    if (f_lseek(&dict_widx_file, (FSIZE_t)(1 + buckets) * DICT_BIN_BLOCK_SIZE) != FR_OK) goto fail;
+    if (f_truncate(&dict_widx_file) != FR_OK) goto fail;
+
+    dict_source_header_write(header, "DWIX", DICT_WIDX_VERSION, src);
+    dict_bin_put_u32(&header[16], buckets);
+    dict_bin_put_u32(&header[20], pairs);
+    if (f_lseek(&dict_widx_file, 0) != FR_OK) goto fail;
+    if (f_write(&dict_widx_file, header, sizeof(header), &bw) != FR_OK || bw != sizeof(header)) goto fail;
+    if (f_sync(&dict_widx_file) != FR_OK) goto fail;
+
+    dict_widx_buckets = buckets;
+    printf("INFO: Dictionary.widx rebuilt (%lu words, %lu buckets)\n", (unsigned long)pairs, (unsigned long)buckets);
+    return true;
+
+fail:
+    f_close(&dict_widx_file);
+    return false;
+}
+
+// Opens Dictionary.widx, rebuilding it when it no longer matches Dictionary.dat.
+static bool dict_widx_open(void) {
+    dict_widx_ready = false;
+    dict_widx_buckets = 0;
+
+    FILINFO src;
+    if (f_stat("0:/microsd/Dictionary.dat", &src) != FR_OK) return false;
+
+    if (f_open(&dict_widx_file, "0:/microsd/Dictionary.widx", FA_READ | FA_WRITE | FA_OPEN_EXISTING) == FR_OK) {
+        uint8_t header[24];
+        UINT br = 0;
+        if (f_read(&dict_widx_file, header, sizeof(header), &br) == FR_OK && br == sizeof(header) &&
+            dict_source_header_matches(header, "DWIX", DICT_WIDX_VERSION, &src) &&
+            dict_bin_get_u32(&header[16]) > 0) {
+            dict_widx_buckets = dict_bin_get_u32(&header[16]);
+            dict_widx_ready = true;
+            dict_enable_fast_seek(&dict_widx_file, dict_widx_clmt);
+            return true;
+        }
+        f_close(&dict_widx_file);
+    }
+
+    if (!dict_widx_build(&src)) return false;
+    dict_widx_ready = true;
+    dict_enable_fast_seek(&dict_widx_file, dict_widx_clmt);
+    return true;
+}
+
+// One bucket read plus one line read per candidate with a matching hash (normally exactly one).
+static bool dict_widx_find(const char *word, uint8_t *key_out) {
+    if (!dict_widx_ready || !word || word[0] == '\0') return false;
+
+    uint32_t hash = dict_word_hash(word);
+    uint8_t bucket[DICT_BIN_BLOCK_SIZE];
+    UINT br = 0;
+    FSIZE_t offset = (FSIZE_t)(1 + (hash % dict_widx_buckets)) * DICT_BIN_BLOCK_SIZE;
+    if (f_lseek(&dict_widx_file, offset) != FR_OK) return false;
+    if (f_read(&dict_widx_file, bucket, sizeof(bucket), &br) != FR_OK || br != sizeof(bucket)) return false;
+
+    uint32_t start = (hash >> 16) % DICT_WIDX_SLOTS_PER_BUCKET;
+    char line[DICT_LINE_BUF];
+    char line_word[DICT_WORD_SIZE + 1];
+    for (uint32_t i = 0; i < DICT_WIDX_SLOTS_PER_BUCKET; i++) {
+        const uint8_t *slot = &bucket[((start + i) % DICT_WIDX_SLOTS_PER_BUCKET) * DICT_WIDX_SLOT_SIZE];
+        uint32_t ref = dict_bin_get_u32(&slot[4]);
+        if (ref == 0) return false;
+        if (dict_bin_get_u32(&slot[0]) != hash) continue;
+
+        if (!dict_read_line_at(&dict_file, ref - 1, line)) return false;
+        if (dict_parse_record_line(line, key_out, line_word, sizeof(line_word)) &&
+            strcasecmp_local(line_word, word) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Loads NewWords.dat into the hash table and Bloom filter at boot; appends keep both current and a merge clears them.
+static bool dict_newwords_load(void) {
+    dict_bloom_ready = false;
+    dict_bloom_clear();
+    dict_newwords_reset();
+
+    FIL newwords;
+    FRESULT res = f_open(&newwords, "0:/microsd/NewWords.dat", FA_READ | FA_OPEN_EXISTING);
+    if (res == FR_NO_FILE) {
+        dict_bloom_ready = true;
+        return true;
+    }
+    if (res != FR_OK) return false;
+
+    dict_reader_t reader;
+    char line[DICT_LINE_BUF];
+    char word[DICT_WORD_SIZE + 1];
+    dict_reader_start(&reader, &newwords, 0);
+    while (dict_reader_next(&reader, line, sizeof(line), NULL)) {
+        uint8_t key[DICT_KEY_SIZE];
+        if (dict_parse_record_line(line, key, word, sizeof(word))) {
+            dict_bloom_add(key);
+            dict_newwords_insert(key, word);
+        }
+    }
+    f_close(&newwords);
+    if (reader.error) return false;
+
+    dict_bloom_ready = true;
+    printf("INFO: NewWords.dat loaded (%lu entries, %u in RAM table)\n",
+           (unsigned long)dict_bloom_entries, (unsigned)dict_newwords_used);
+    return true;
+}
+
+// ==============================
+// Dictionary LSM (memtable + delta)
+// ==============================
+// New words never rewrite Dictionary.dat in place. They are appended to Dictionary.delta and kept
+// sorted in the RAM memtable (the memtable always mirrors every pending record, so lookups only
+// check RAM and the base file). A compaction renames the delta to Dictionary.flush, streams the
+// base file and the frozen memtable entries into Dictionary.tmp in one merge pass, and commits by
+// renaming it to Dictionary.new; dict_lsm_install() then swaps it in (also at boot after a reset).
+#define DICT_DELTA_PATH "0:/microsd/Dictionary.delta"
+#define DICT_FLUSH_PATH "0:/microsd/Dictionary.flush"
+#define DICT_TMP_PATH "0:/microsd/Dictionary.tmp"
+#define DICT_NEW_PATH "0:/microsd/Dictionary.new"
+
+static uint16_t dict_memtable_lower_bound(const uint8_t *key, size_t key_len) {
+    uint16_t low = 0;
+    uint16_t high = dict_memtable_count;
+    while (low < high) {
+        uint16_t mid = (uint16_t)(low + ((high - low) / 2));
+        if (memcmp(dict_memtable[mid].key, key, key_len) < 0) {
+            low = (uint16_t)(mid + 1);
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Equal records keep arrival order, so the insert position is the upper bound.
+static bool dict_memtable_insert(const uint8_t *key, const char *word, bool frozen) {
+    if (dict_memtable_count >= DICT_MEMTABLE_MAX) return false;
+
+    uint16_t low = 0;
+    uint16_t high = dict_memtable_count;
+    while (low < high) {
+        uint16_t mid = (uint16_t)(low + ((high - low) / 2));
+        if (dict_compare_key_word(dict_memtable[mid].key, dict_memtable[mid].word, key, word) <= 0) {
+            low = (uint16_t)(mid + 1);
+        } else {
+            high = mid;
+        }
+    }
+
+    memmove(&dict_memtable[low + 1], &dict_memtable[low], (size_t)(dict_memtable_count - low) * sizeof(dict_mem_entry_t));
+    memcpy(dict_memtable[low].key, key, DICT_KEY_SIZE);
+    size_t word_len = strnlen(word, DICT_WORD_SIZE);
+    memcpy(dict_memtable[low].word, word, word_len);
+    dict_memtable[low].word[word_len] = '\0';
+    dict_memtable[low].frozen = frozen;
+    dict_memtable_count++;
+    if (frozen) dict_memtable_frozen++;
+
+    // Keep the running merge pointed at the same entry.
+    if (dict_compaction.active && low < dict_compaction.mem_cursor) dict_compaction.mem_cursor++;
+    return true;
+}
+
+static void dict_memtable_drop_frozen(void) {
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < dict_memtable_count; i++) {
+        if (dict_memtable[i].frozen) continue;
+        if (kept != i) dict_memtable[kept] = dict_memtable[i];
+        kept++;
+    }
+    dict_memtable_count = kept;
+    dict_memtable_frozen = 0;
+}
+
+// Exact (sequence, language) match, else the same sequence in another language.
+static bool dict_memtable_find(const uint8_t *seq, uint8_t target_lang, char *word_out, size_t word_out_len,
+                               bool *exact_out, uint8_t *lang_out) {
+    uint8_t key[DICT_KEY_SIZE];
+    memcpy(key, seq, PHONEME_SEQ_MAX);
+    key[PHONEME_SEQ_MAX] = target_lang;
+
+    uint16_t i = dict_memtable_lower_bound(key, DICT_KEY_SIZE);
+    const dict_mem_entry_t *match = NULL;
+    bool exact = false;
+    if (i < dict_memtable_count && memcmp(dict_memtable[i].key, key, DICT_KEY_SIZE) == 0) {
+        match = &dict_memtable[i];
+        exact = true;
+    } else if (i < dict_memtable_count && memcmp(dict_memtable[i].key, seq, PHONEME_SEQ_MAX) == 0) {
+        match = &dict_memtable[i];
+    } else if (i > 0 && memcmp(dict_memtable[i - 1].key, seq, PHONEME_SEQ_MAX) == 0) {
+        match = &dict_memtable[i - 1];
+    }
+
+    if (!match) return false;
+    size_t word_len = strnlen(match->word, word_out_len - 1);
+    memcpy(word_out, match->word, word_len);
+    word_out[word_len] = '\0';
+    if (exact_out) *exact_out = exact;
+    if (lang_out) *lang_out = match->key[PHONEME_SEQ_MAX];
+    return true;
+}
+
+// True when a pending word starts with the given phonemes (the trie only knows the base file).
+static bool dict_memtable_has_prefix(const uint8_t *prefix, uint8_t len) {
+    if (dict_memtable_count == 0 || len == 0) return false;
+    uint16_t i = dict_memtable_lower_bound(prefix, len);
+    return i < dict_memtable_count && memcmp(dict_memtable[i].key, prefix, len) == 0;
+}
+
+static const dict_mem_entry_t *dict_memtable_find_word(const char *word) {
+    for (uint16_t i = 0; i < dict_memtable_count; i++) {
+        if (strcasecmp_local(dict_memtable[i].word, word) == 0) return &dict_memtable[i];
+    }
+    return NULL;
+}
+
+static void dict_delta_close(void) {
+    if (dict_delta_ready) {
+        f_close(&dict_delta_file);
+        dict_delta_ready = false;
+    }
+}
+
+static bool dict_delta_append(const char *record_line, size_t len) {
+    if (!dict_delta_ready) {
+        FRESULT res = f_open(&dict_delta_file, DICT_DELTA_PATH, FA_WRITE | FA_OPEN_APPEND);
+        if (res != FR_OK) {
+            printf("ERROR: f_open Dictionary.delta failed with code %d\n", res);
+            return false;
+        }
+        dict_delta_ready = true;
+    }
+
+    UINT bw = 0;
+    FRESULT res = f_write(&dict_delta_file, record_line, (UINT)len, &bw);
+    if (res == FR_OK) res = f_sync(&dict_delta_file);
+    if (res != FR_OK || bw != (UINT)len) {
+        printf("ERROR: failed to append Dictionary.delta record\n");
+        dict_delta_close();
+        return false;
+    }
+    return true;
+}
+
+// Replaces Dictionary.dat with a committed Dictionary.new and reopens the lookup structures.
+static bool dict_lsm_install(void) {
+    FRESULT res = f_unlink(DICT_FLUSH_PATH);
+    if (res != FR_OK && res != FR_NO_FILE) {
+        printf("ERROR: failed to remove Dictionary.flush (code %d)\n", res);
+        return false;
+    }
+
+    dict_close_files();
+    res = f_unlink("0:/microsd/Dictionary.dat");
+    if (res != FR_OK && res != FR_NO_FILE) {
+        printf("ERROR: failed to remove old Dictionary.dat (code %d)\n", res);
+        return false;
+    }
+    res = f_rename(DICT_NEW_PATH, "0:/microsd/Dictionary.dat");
+    if (res != FR_OK) {
+        printf("ERROR: failed to install Dictionary.new (code %d)\n", res);
+        return false;
+    }
+    return true;
+}
+
+// Swaps a committed Dictionary.new in. The frozen memtable entries are only dropped once it is
+// Dictionary.dat, so until then they keep answering for the flushed words; a failed swap is
+// retried from dict_compaction_tick().
+static bool dict_lsm_install_pending(void) {
+    if (!dict_install_pending) return true;
+    bool ok = dict_lsm_install();
+    if (ok) {
+        dict_install_pending = false;
+        dict_memtable_drop_frozen();
+    } else {
+        dict_install_failed_at = get_absolute_time();
+    }
+    // A swap that failed after closing the files reopens whatever Dictionary.dat is left
+    if (ok || !dict_ready) dict_reload();
+    return ok;
+}
+
+static void dict_compaction_abort(void) {
+    f_close(&dict_compaction.out);
+    f_close(&dict_compaction.base);
+    f_unlink(DICT_TMP_PATH);
+    dict_compaction.active = false;
+    printf("WARNING: Dictionary compaction aborted after %lu records\n", (unsigned long)dict_compaction.written);
+}
+
+static bool dict_compaction_commit(void) {
+    FRESULT res = f_close(&dict_compaction.out);
+    f_close(&dict_compaction.base);
+    dict_compaction.active = false;
+    if (res != FR_OK) {
+        f_unlink(DICT_TMP_PATH);
+        printf("ERROR: failed to finish Dictionary.tmp (code %d)\n", res);
+        return false;
+    }
+
+    // Commit point: from here on the merged file wins, even if power is lost before the swap.
+    res = f_rename(DICT_TMP_PATH, DICT_NEW_PATH);
+    if (res != FR_OK) {
+        f_unlink(DICT_TMP_PATH);
+        printf("ERROR: failed to commit Dictionary.new (code %d)\n", res);
+        return false;
+    }
+
+    uint16_t flushed = dict_memtable_frozen;
+    dict_compactions++;
+    dict_install_pending = true;
+
+    bool ok = dict_lsm_install_pending();
+    printf("INFO: Dictionary compaction wrote %lu records (%u from memtable)\n",
+           (unsigned long)dict_compaction.written, (unsigned)flushed);
+    return ok;
+}
+
+// Advances to the next well-formed base line; malformed lines are dropped by the merge. False on a
+// read error, which must not be mistaken for the end of the base.
+static bool dict_compaction_next_base(void) {
+    char line[DICT_LINE_BUF];
+    dict_compaction.base_valid = false;
+    while (dict_reader_next(&dict_compaction.reader, line, sizeof(line), NULL)) {
+        if (dict_parse_record_line(line, dict_compaction.base_key, dict_compaction.base_word, sizeof(dict_compaction.base_word))) {
+            dict_compaction.base_valid = true;
+            return true;
+        }
+    }
+    return !dict_compaction.reader.error;
+}
+
+static bool dict_compaction_start(void) {
+    if (dict_compaction.active) return true;
+    if (!dict_lsm_ready || !dict_ready || dict_install_pending) return false;
+
+    FILINFO fno;
+    if (f_stat(DICT_FLUSH_PATH, &fno) != FR_OK) {
+        if (dict_memtable_count == 0) return true;
+
+        // Rotate: the current delta becomes the immutable input, later words start a fresh delta.
+        dict_delta_close();
+        FRESULT res = f_rename(DICT_DELTA_PATH, DICT_FLUSH_PATH);
+        if (res != FR_OK) {
+            printf("ERROR: failed to rotate Dictionary.delta (code %d)\n", res);
+            return false;
+        }
+        for (uint16_t i = 0; i < dict_memtable_count; i++) {
+            dict_memtable[i].frozen = true;
+        }
+        dict_memtable_frozen = dict_memtable_count;
+    }
+
+    if (f_open(&dict_compaction.base, "0:/microsd/Dictionary.dat", FA_READ | FA_OPEN_EXISTING) != FR_OK) return false;
+    if (f_open(&dict_compaction.out, DICT_TMP_PATH, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+        f_close(&dict_compaction.base);
+        return false;
+    }
+
+    dict_compaction.mem_cursor = 0;
+    dict_compaction.written = 0;
+    dict_reader_start(&dict_compaction.reader, &dict_compaction.base, 0);
+    if (!dict_compaction_next_base()) {
+        dict_compaction_abort();
+        return false;
+    }
+    dict_compaction.active = true;
+    printf("INFO: Dictionary compaction started (%u memtable records)\n", (unsigned)dict_memtable_frozen);
+    return true;
+}
+
+// Two sorted inputs, one output: each step writes the smaller head record. Base records win ties,
+// so older entries stay ahead of newer ones with the same key and word. Every record is written in
+// the current line layout, so the first compaction also converts a fixed-width Dictionary.dat.
+static bool dict_compaction_step(uint16_t budget) {
+    if (!dict_compaction.active) return true;
+
+    for (uint16_t n = 0; n < budget; n++) {
+        while (dict_compaction.mem_cursor < dict_memtable_count &&
+               !dict_memtable[dict_compaction.mem_cursor].frozen) {
+            dict_compaction.mem_cursor++;
+        }
+        bool mem_valid = dict_compaction.mem_cursor < dict_memtable_count;
+        if (!dict_compaction.base_valid && !mem_valid) {
+            return dict_compaction_commit();
+        }
+
+        const dict_mem_entry_t *mem = mem_valid ? &dict_memtable[dict_compaction.mem_cursor] : NULL;
+        bool take_mem = mem && (!dict_compaction.base_valid ||
+                                dict_compare_key_word(dict_compaction.base_key, dict_compaction.base_word, mem->key, mem->word) > 0);
+
+        char line[DICT_LINE_BUF];
+        size_t len = take_mem
+            ? dict_format_record_line(mem->key, mem->key[PHONEME_SEQ_MAX], mem->word, line)
+            : dict_format_record_line(dict_compaction.base_key, dict_compaction.base_key[PHONEME_SEQ_MAX],
+                                      dict_compaction.base_word, line);
+
+        // A fixed-width line with a gap in its sequence has no place in the new layout and is dropped.
+        UINT bw = 0;
+        if (len > 0) {
+            if (f_write(&dict_compaction.out, line, (UINT)len, &bw) != FR_OK || bw != (UINT)len) {
+                dict_compaction_abort();
+                return false;
+            }
+            dict_compaction.written++;
+        }
+
+        if (take_mem) {
+            dict_compaction.mem_cursor++;
+        } else if (!dict_compaction_next_base()) {
+            printf("ERROR: failed to read Dictionary.dat during compaction\n");
+            dict_compaction_abort();
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool dict_compact_now(void) {
+    if (!dict_lsm_install_pending() || !dict_compaction_start()) return false;
+    while (dict_compaction.active) {
+        if (!dict_compaction_step(DICT_COMPACT_BATCH)) return false;
+    }
+    return true;
+}
+
+// Called from the main loop; a running compaction advances DICT_COMPACT_BATCH records per call.
+static void dict_compaction_tick(void) {
+    if (dict_install_pending) {
+        if (absolute_time_diff_us(dict_install_failed_at, get_absolute_time()) >= (int64_t)DICT_INSTALL_RETRY_MS * 1000) {
+            dict_lsm_install_pending();
+        }
+        return;
+    }
+    if (dict_compaction.active) {
+        dict_compaction_step(DICT_COMPACT_BATCH);
+    }
+}
+
+static bool dict_lsm_add(const uint8_t *key, const char *word) {
+    if (!dict_lsm_ready || !dict_ready) return false;
+
+    char record_line[DICT_LINE_BUF];
+    size_t len = dict_format_record_line(key, key[PHONEME_SEQ_MAX], word, record_line);
+    if (len == 0) return false;
+
+    // A full memtable has to be flushed before it can take the record.
+    while (dict_memtable_count >= DICT_MEMTABLE_MAX) {
+        if (!dict_compact_now()) return false;
+    }
+
+    if (!dict_delta_append(record_line, len)) return false;
+    dict_memtable_insert(key, word, false);
+    dict_cache_forget(key);
+
+    if (!dict_compaction.active && dict_memtable_count >= DICT_MEMTABLE_COMPACT_AT) {
+        dict_compaction_start();
+    }
+    return true;
+}
+
+static bool dict_lsm_load_file(const char *path, bool frozen, uint32_t *count_out) {
+    FIL file;
+    FRESULT res = f_open(&file, path, FA_READ | FA_OPEN_EXISTING);
+    if (res == FR_NO_FILE) return true;
+    if (res != FR_OK) return false;
+
+    dict_reader_t reader;
+    char line[DICT_LINE_BUF];
+    char word[DICT_WORD_SIZE + 1];
+    bool ok = true;
+    dict_reader_start(&reader, &file, 0);
+    while (dict_reader_next(&reader, line, sizeof(line), NULL)) {
+        uint8_t key[DICT_KEY_SIZE];
+        if (!dict_parse_record_line(line, key, word, sizeof(word))) continue;
+        if (!dict_memtable_insert(key, word, frozen)) {
+            ok = false;
+            break;
+        }
+        (*count_out)++;
+    }
+    f_close(&file);
+    return ok && !reader.error;
+}
+
+// Finishes or discards an interrupted compaction. Runs before Dictionary.dat is opened.
+static void dict_lsm_recover(void) {
+    FILINFO fno;
+    if (f_stat(DICT_NEW_PATH, &fno) == FR_OK) {
+        printf("INFO: Completing interrupted dictionary compaction\n");
+        // Retried from dict_compaction_tick() if the card still refuses the swap
+        dict_install_pending = !dict_lsm_install();
+        if (dict_install_pending) dict_install_failed_at = get_absolute_time();
+    } else {
+        f_unlink(DICT_TMP_PATH);
+    }
+}
+
+// Rebuilds the memtable from Dictionary.flush (a compaction that did not finish) and Dictionary.delta.
+static bool dict_lsm_load(void) {
+    dict_lsm_ready = false;
+    dict_memtable_count = 0;
+    dict_memtable_frozen = 0;
+
+    uint32_t pending = 0;
+    if (!dict_lsm_load_file(DICT_FLUSH_PATH, true, &pending) ||
+        !dict_lsm_load_file(DICT_DELTA_PATH, false, &pending)) {
+        printf("ERROR: pending dictionary records exceed the memtable (%u); raise DICT_MEMTABLE_MAX\n",
+               (unsigned)DICT_MEMTABLE_MAX);
+        return false;
+    }
+
+    dict_lsm_ready = true;
+    if (pending > 0) {
+        printf("INFO: Dictionary memtable loaded (%lu pending records)\n", (unsigned long)pending);
+    }
+    if (dict_memtable_frozen > 0) {
+        dict_compaction_start();
+    }
+    return true;
+}
+
+static bool dict_add_word_with_language(const uint8_t *seq, uint8_t language_id, const char *word) {
+    if (!sd_ready || !seq || !word || word[0] == '\0') return false;
+
+    uint8_t key[DICT_KEY_SIZE];
+    memcpy(key, seq, PHONEME_SEQ_MAX);
+    key[PHONEME_SEQ_MAX] = language_id;
+    return dict_lsm_add(key, word);
+}
+
+// Binary search over the variable-length lines of Dictionary.dat itself, used only while
+// Dictionary.bin is unavailable. Each probe reads from a byte offset, skips to the next line start
+// and parses that line, all in one f_read(). Returns the offset of the first line not below key.
+static bool dict_text_lower_bound(const uint8_t *key, FSIZE_t *offset_out) {
+    char buf[2 * DICT_LINE_BUF];
+    FSIZE_t low = 0;                   // a line start; every line before it sorts below key
+    FSIZE_t high = f_size(&dict_file);  // the first line starting at or after high does not
+
+    while (low < high) {
+        FSIZE_t mid = low + ((high - low) / 2);
+        FSIZE_t from = mid > 0 ? mid - 1 : 0;
+        UINT br = 0;
+        dict_lookup_probes++;
+        if (f_lseek(&dict_file, from) != FR_OK) return false;
+        if (f_read(&dict_file, buf, sizeof(buf) - 1, &br) != FR_OK) return false;
+        buf[br] = '\0';
+
+        // mid is a line start when it is 0 or follows a newline; otherwise skip to the next one.
+        const char *line = buf;
+        if (mid > 0) {
+            line = memchr(buf, '\n', br);
+            line = line ? line + 1 : &buf[br];
+        }
+        FSIZE_t start = from + (FSIZE_t)(line - buf);
+        if (start >= high) {
+            high = mid;
+            continue;
+        }
+
+        uint8_t line_key[DICT_KEY_SIZE];
+        size_t len = strcspn(line, "\n");
+        if (!dict_parse_record_key(line, line_key)) return false;
+        if (memcmp(line_key, key, DICT_KEY_SIZE) < 0) {
+            low = start + len + 1;
+        } else {
+            high = start;
+        }
+    }
+    *offset_out = low;
+    return true;
+}
+
+// Text fallback: the lines for seq are adjacent and ordered by language, so they are read in turn
+// from the lower bound; the target language wins, otherwise the first language found is used.
+static bool dict_search_text(const uint8_t *seq, uint8_t target_lang, char *word_out, size_t word_out_len) {
+    uint8_t key[DICT_KEY_SIZE];
+    memcpy(key, seq, PHONEME_SEQ_MAX);
+    key[PHONEME_SEQ_MAX] = 0x00;
+
+    FSIZE_t offset = 0;
+    if (!dict_text_lower_bound(key, &offset)) return false;
+
+    dict_reader_t reader;
+    char line[DICT_LINE_BUF];
+    char word[DICT_WORD_SIZE + 1];
+    bool found = false;
+    if (!dict_reader_start(&reader, &dict_file, offset)) return false;
+    while (dict_reader_next(&reader, line, sizeof(line), NULL)) {
+        uint8_t line_key[DICT_KEY_SIZE];
+        if (!dict_parse_record_line(line, line_key, word, sizeof(word))) break;
+        if (memcmp(line_key, seq, PHONEME_SEQ_MAX) != 0) break;
+        if (!found || line_key[PHONEME_SEQ_MAX] == target_lang) {
+            found = true;
+            dict_resolved_lang = line_key[PHONEME_SEQ_MAX];
+            strncpy(word_out, word, word_out_len - 1);
+            word_out[word_out_len - 1] = '\0';
+        }
+        if (line_key[PHONEME_SEQ_MAX] >= target_lang) break;
+    }
+    return found;
+}
+
+static bool dict_resolve_word(const uint8_t *seq, uint8_t target_lang, char *word_out, size_t word_out_len) {
+    if (!dict_ready || word_out_len < 2) return false;
+
+    // Dictionary.dat is sorted by (phoneme sequence, language): the flash image or Dictionary.bin
+    // answers with packed keys, the text lines are only searched when neither could be built.
+    // NewWords.dat is sequential (RAM table, or a linear scan once that is full).
+    //
+    // Pending additions in the memtable win on an exact language match, otherwise they are
+    // only used when the base file has no entry for the sequence at all.
+    char mem_word[DICT_WORD_SIZE + 1];
+    bool mem_exact = false;
+    uint8_t mem_lang = LANG_UNKNOWN;
+    bool mem_found = dict_memtable_find(seq, target_lang, mem_word, sizeof(mem_word), &mem_exact, &mem_lang);
+    if (mem_found && mem_exact) {
+        dict_resolved_lang = mem_lang;
+        strncpy(word_out, mem_word, word_out_len - 1);
+        word_out[word_out_len - 1] = '\0';
+        return true;
+    }
+
+    if (dict_xip_ready) {
+        if (dict_search_xip(seq, target_lang, word_out, word_out_len)) return true;
+    } else if (dict_bin_ready) {
+        if (dict_search_bin(seq, target_lang, word_out, word_out_len)) return true;
+    } else if (dict_search_text(seq, target_lang, word_out, word_out_len)) {
+        return true;
+    }
+
+    if (mem_found) {
+        dict_resolved_lang = mem_lang;
+        strncpy(word_out, mem_word, word_out_len - 1);
+        word_out[word_out_len - 1] = '\0';
+        return true;
+    }
+
+    // Not found in Dictionary.dat, try NewWords.dat: the RAM table answers outright while it holds
+    // every record, otherwise the Bloom filter decides whether the file has to be scanned.
+    uint8_t key[DICT_KEY_SIZE];
+    memcpy(key, seq, PHONEME_SEQ_MAX);
+    key[PHONEME_SEQ_MAX] = target_lang;
+    dict_resolved_lang = target_lang;
+
+    if (dict_bloom_ready && dict_newwords_complete) {
+        return dict_newwords_find(key, word_out, word_out_len);
+    }
+
+    if (dict_bloom_ready && !dict_bloom_may_contain(key)) {
+        dict_stats.newwords_skips++;
+        return false;
+    }
+    dict_stats.newwords_scans++;
+
+    FIL newwords;
+    if (f_open(&newwords, "0:/microsd/NewWords.dat", FA_READ | FA_OPEN_EXISTING) != FR_OK) {
+        // NewWords.dat doesn't exist yet, word truly not found
+        return false;
+    }
+
+    dict_reader_t reader;
+    char line[DICT_LINE_BUF];
+    char word[DICT_WORD_SIZE + 1];
+    bool found = false;
+    dict_reader_start(&reader, &newwords, 0);
+    while (dict_reader_next(&reader, line, sizeof(line), NULL)) {
+        uint8_t line_key[DICT_KEY_SIZE];
+        if (!dict_parse_record_line(line, line_key, word, sizeof(word))) break;
+        if (memcmp(line_key, key, DICT_KEY_SIZE) == 0) {
+            strncpy(word_out, word, word_out_len - 1);
+            word_out[word_out_len - 1] = '\0';
+            found = true;
+            break;
+        }
+    }
+
+    f_close(&newwords);
+    if (!found && dict_bloom_ready) dict_stats.bloom_false_positives++;
+    return found;
+}
+
+static bool dict_lookup_word(const uint8_t *seq, char *word_out, size_t word_out_len) {
+    if (!dict_ready || word_out_len < 2) return false;
+
+    uint8_t key[DICT_KEY_SIZE];
+    memcpy(key, seq, PHONEME_SEQ_MAX);
+    key[PHONEME_SEQ_MAX] = dict_target_language();
+    if (dict_cache_get(key, word_out, word_out_len)) return true;
+
+    uint32_t sectors_before = sd_sector_reads;
+    dict_lookup_probes = 0;
+    dict_lookup_block_reads = 0;
+
+    bool found = dict_resolve_word(seq, key[PHONEME_SEQ_MAX], word_out, word_out_len);
+    if (found) dict_cache_put(key, dict_resolved_lang, word_out, 1);
+
+    uint16_t sectors = (uint16_t)(sd_sector_reads - sectors_before);
+    dict_stats.lookups++;
+    dict_stats.probes += dict_lookup_probes;
+    dict_stats.block_reads += dict_lookup_block_reads;
+    dict_stats.sector_reads += sectors;
+    if (dict_lookup_block_reads <= 1) dict_stats.single_block_lookups++;
+    dict_stats.last_probes = dict_lookup_probes;
+    dict_stats.last_block_reads = dict_lookup_block_reads;
+    dict_stats.last_sector_reads = sectors;
+
+#if DICT_LOOKUP_TRACE
+    printf("DICT lookup %s probes=%u blocks=%u sectors=%u\n",
+           found ? "hit" : "miss",
+           (unsigned)dict_lookup_probes,
+           (unsigned)dict_lookup_block_reads,
+           (unsigned)sectors);
+#endif
+    return found;
+}
+
+// Writes the DICT_CACHE_PERSIST most-hit entries, coldest first, so a preload in file order leaves
+// the hottest words most recently used. The count in the header stays 0 until the records are down.
+static bool dict_cache_save(void) {
+    uint8_t order[DICT_CACHE_ENTRIES];
+    uint16_t used = 0;
+    for (uint16_t i = 0; i < DICT_CACHE_ENTRIES; i++) {
+        if (dict_cache[i].hash == 0) continue;
+        uint16_t pos = used++;
+        while (pos > 0 && dict_cache[order[pos - 1]].hits < dict_cache[i].hits) {
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        order[pos] = (uint8_t)i;
+    }
+    uint16_t count = used < DICT_CACHE_PERSIST ? used : DICT_CACHE_PERSIST;
+
+    FIL file;
+    FRESULT res = f_open(&file, "0:/microsd/DictCache.bin", FA_WRITE | FA_CREATE_ALWAYS);
+    if (res != FR_OK) {
+        printf("ERROR: f_open DictCache.bin failed with code %d\n", res);
+        return false;
+    }
+
+    uint8_t header[16] = {'D', 'H', 'O', 'T'};
+    dict_bin_put_u32(&header[4], DICT_CACHE_VERSION);
+    UINT bw = 0;
+    bool ok = f_write(&file, header, sizeof(header), &bw) == FR_OK && bw == sizeof(header);
+
+    for (int16_t n = (int16_t)count - 1; ok && n >= 0; n--) {
+        const dict_cache_entry_t *entry = &dict_cache[order[n]];
+        uint8_t record[DICT_CACHE_RECORD_SIZE];
+        memcpy(record, entry->key, DICT_KEY_SIZE);
+        dict_bin_put_u32(&record[DICT_KEY_SIZE], entry->hits);
+        ok = f_write(&file, record, sizeof(record), &bw) == FR_OK && bw == sizeof(record);
+    }
+
+    if (ok) {
+        dict_bin_put_u32(&header[8], count);
+        ok = f_lseek(&file, 0) == FR_OK && f_write(&file, header, sizeof(header), &bw) == FR_OK && bw == sizeof(header);
+    }
+    f_close(&file);
+    if (!ok) {
+        printf("ERROR: failed to write DictCache.bin\n");
+        return false;
+    }
+    dict_cache_stats.saves++;
     return true;
 }
 
-static bool dict_add_word_with_language(const uint8_t *seq, uint8_t language_id, const char *word) {
-    if (!sd_ready || !seq || !word || word[0] == '\0') return false;
+// Warms the cache from DictCache.bin. Only keys and hit counts are stored; each key is resolved
+// again so the preloaded words always match the current Dictionary.dat and delta.
+static void dict_cache_preload(void) {
+    dict_cache_clear();
+    dict_cache_dirty = false;
 
-    FIL dict;
-    FRESULT res = f_open(&dict, "0:/microsd/Dictionary.dat", FA_READ | FA_WRITE | FA_OPEN_EXISTING);
-    if (res != FR_OK) return false;
+    FIL file;
+    if (f_open(&file, "0:/microsd/DictCache.bin", FA_READ | FA_OPEN_EXISTING) != FR_OK) return;
 
-    char record_line[DICT_RECORD_SIZE + 1] = {0};
-    if (!dict_format_record_line(seq, language_id, word, record_line)) {
-        f_close(&dict);
-        return false;
+    uint8_t header[16];
+    UINT br = 0;
+    uint32_t count = 0;
+    if (f_read(&file, header, sizeof(header), &br) == FR_OK && br == sizeof(header) &&
+        memcmp(header, "DHOT", 4) == 0 && dict_bin_get_u32(&header[4]) == DICT_CACHE_VERSION) {
+        count = dict_bin_get_u32(&header[8]);
+    }
+    if (count > DICT_CACHE_PERSIST || f_size(&file) != sizeof(header) + (FSIZE_t)count * DICT_CACHE_RECORD_SIZE) {
+        count = 0;
     }
 
-    bool ok = dict_insert_sorted_record(&dict, record_line);
-    f_close(&dict);
-    return ok;
-}
-
-static bool dict_lookup_word(const uint8_t *seq, char *word_out, size_t word_out_len) {
-    if (!dict_ready || word_out_len < 2) return false;
+    for (uint32_t n = 0; n < count; n++) {
+        uint8_t record[DICT_CACHE_RECORD_SIZE];
+        if (f_read(&file, record, sizeof(record), &br) != FR_OK || br != sizeof(record)) break;
 
-    // Record format: 15 hex values (45 chars) + 2-char language ID + space + 26-char word + CRLF
-    // Dictionary.dat is sorted by phoneme sequence (binary search possible)
-    // NewWords.dat is sequential (linear search required)
+        char word[DICT_WORD_SIZE + 1];
+        if (!dict_resolve_word(record, record[PHONEME_SEQ_MAX], word, sizeof(word))) continue;
+        dict_cache_put(record, dict_resolved_lang, word, dict_bin_get_u32(&record[DICT_KEY_SIZE]));
+        dict_cache_stats.preloaded++;
+    }
+    f_close(&file);
 
-    char record[DICT_RECORD_SIZE + 1];
-    uint8_t record_seq[PHONEME_SEQ_LEN];
-    char record_word[DICT_WORD_SIZE + 1];
-    uint8_t record_lang = LANG_UNKNOWN;
-    UINT br;
-    FRESULT res;
-    uint8_t target_lang = LANG_UNKNOWN;
-    if (current_user.set && current_user.language[0] != '\0') {
-        uint8_t lang_id = language_id_from_name(current_user.language);
-        target_lang = lang_id;
+    if (dict_cache_stats.preloaded > 0) {
+        printf("INFO: Dictionary cache preloaded %u hot words\n", (unsigned)dict_cache_stats.preloaded);
     }
+}
 
-    // First, search Dictionary.dat using binary search (Dictionary.dat is sorted).
-    uint32_t record_count = (uint32_t)(f_size(&dict_file) / DICT_RECORD_SIZE);
-    if (record_count > 0) {
-        int32_t low = 0;
-        int32_t high = (int32_t)record_count - 1;
+// Main-loop hook: persists the hot set at most once per DICT_CACHE_SAVE_MS, and only after new hits.
+static void dict_cache_tick(void) {
+    static absolute_time_t last_save = {0};
+    if (!dict_ready || !dict_cache_dirty) return;
+    if (absolute_time_diff_us(last_save, get_absolute_time()) < (int64_t)DICT_CACHE_SAVE_MS * 1000) return;
 
-        while (low <= high) {
-            int32_t mid = low + ((high - low) / 2);
-            FSIZE_t offset = (FSIZE_t)mid * (FSIZE_t)DICT_RECORD_SIZE;
+    last_save = get_absolute_time();
+    if (dict_cache_save()) dict_cache_dirty = false;
+}
 
-            res = f_lseek(&dict_file, offset);
-            if (res != FR_OK) break;
+// ==============================
+// Approximate dictionary match
+// ==============================
+// Runs after an exact miss: a depth-first walk of Dictionary.trie carries one edit-distance row per
+// depth and skips any subtree whose row minimum already exceeds the best cost found so far. Each
+// surviving node costs one read of its contiguous child block; pruned subtrees are never touched.
+static bool dict_approx_load_costs(void) {
+    for (int a = 0; a < DICT_APPROX_PHONEMES; a++) {
+        for (int b = 0; b < DICT_APPROX_PHONEMES; b++) {
+            dict_approx_sub_cost[a][b] = (a == b) ? 0 : DICT_APPROX_UNIT;
+        }
+    }
 
-            res = f_read(&dict_file, record, DICT_RECORD_SIZE, &br);
-            if (res != FR_OK || br < DICT_RECORD_SIZE) break;
-            record[DICT_RECORD_SIZE] = '\0';
+    // Optional "AA BB C" lines: two hex phoneme IDs and a substitution cost in tenths of an edit.
+    FIL file;
+    if (f_open(&file, "0:/microsd/PhonemeCosts.txt", FA_READ | FA_OPEN_EXISTING) != FR_OK) return false;
+
+    char line[48];
+    uint16_t loaded = 0;
+    while (f_gets(line, sizeof(line), &file)) {
+        if (line[0] == '#') continue;
+        unsigned a = 0;
+        unsigned b = 0;
+        unsigned cost = 0;
+        if (sscanf(line, "%x %x %u", &a, &b, &cost) != 3) continue;
+        if (a < DICT_APPROX_FIRST_ID || b < DICT_APPROX_FIRST_ID) continue;
+        a -= DICT_APPROX_FIRST_ID;
+        b -= DICT_APPROX_FIRST_ID;
+        if (a >= DICT_APPROX_PHONEMES || b >= DICT_APPROX_PHONEMES || cost > 255) continue;
+        dict_approx_sub_cost[a][b] = (uint8_t)cost;
+        dict_approx_sub_cost[b][a] = (uint8_t)cost;
+        loaded++;
+    }
+    f_close(&file);
 
-            if (!dict_parse_record_line(record, record_seq, &record_lang, record_word, sizeof(record_word))) {
-                break;
-            }
+    printf("INFO: PhonemeCosts.txt loaded (%u substitution costs)\n", (unsigned)loaded);
+    return true;
+}
 
-            int cmp = compare_seq_to_record(seq, record_seq);
-            if (cmp == 0) {
-                if (record_lang == target_lang) {
-                    strncpy(word_out, record_word, word_out_len - 1);
-                    word_out[word_out_len - 1] = '\0';
-                    return true;
-                }
+static uint16_t dict_approx_sub(uint8_t a, uint8_t b) {
+    if (a == b) return 0;
+    if (a < DICT_APPROX_FIRST_ID || b < DICT_APPROX_FIRST_ID) return DICT_APPROX_UNIT;
+    a -= DICT_APPROX_FIRST_ID;
+    b -= DICT_APPROX_FIRST_ID;
+    if (a >= DICT_APPROX_PHONEMES || b >= DICT_APPROX_PHONEMES) return DICT_APPROX_UNIT;
+    return dict_approx_sub_cost[a][b];
+}
+
+// next[j] = cost of aligning the path plus `phoneme` with the first j query phonemes; returns the row minimum.
+static uint16_t dict_approx_row(const uint16_t *prev, uint16_t *next, uint8_t phoneme, const uint8_t *query, uint8_t len) {
+    next[0] = prev[0] + DICT_APPROX_UNIT;
+    uint16_t row_min = next[0];
+    for (uint8_t j = 1; j <= len; j++) {
+        uint16_t best = prev[j - 1] + dict_approx_sub(phoneme, query[j - 1]);
+        uint16_t del = prev[j] + DICT_APPROX_UNIT;
+        uint16_t ins = next[j - 1] + DICT_APPROX_UNIT;
+        if (del < best) best = del;
+        if (ins < best) best = ins;
+        next[j] = best;
+        if (best < row_min) row_min = best;
+    }
+    return row_min;
+}
+
+// The build scratch is idle once the indexes are open; the search stacks the child block of every
+// depth there, each one starting right after its parent's block.
+static uint8_t *dict_approx_block(uint16_t first_node) {
+    return &dict_build_scratch[(size_t)first_node * DICT_TRIE_NODE_SIZE];
+}
+
+// Finds the dictionary sequence nearest to seq (len phonemes) within dict_approx_max_cost and
+// resolves it like an exact hit. Ties keep the first sequence in dictionary order.
+static bool dict_approx_lookup(const uint8_t *seq, uint8_t len, char *word_out, size_t word_out_len, uint16_t *cost_out) {
+    if (dict_approx_max_cost == 0 || len < DICT_APPROX_MIN_PHONEMES || len > PHONEME_SEQ_MAX) return false;
+
+    static uint16_t rows[PHONEME_SEQ_MAX + 1][PHONEME_SEQ_MAX + 1];
+    // Per depth: the child block being scanned (held in dict_build_scratch) and the next sibling to score.
+    uint16_t block_base[PHONEME_SEQ_MAX + 1];
+    uint8_t block_count[PHONEME_SEQ_MAX + 1];
+    uint8_t block_next[PHONEME_SEQ_MAX + 1];
+    uint16_t bound = dict_approx_max_cost;
+    uint16_t best_cost = UINT16_MAX;
+    uint8_t best_seq[PHONEME_SEQ_MAX] = {0};
+    uint32_t best_line = DICT_TRIE_NONE;
+    uint32_t visited = 0;
+    uint32_t reads = 0;
+
+    dict_approx_stats.attempts++;
+
+    // Pending memtable words are few and in RAM: score them directly.
+    for (uint16_t i = 0; i < dict_memtable_count; i++) {
+        const uint8_t *cand = dict_memtable[i].key;
+        uint8_t cand_len = dict_seq_length(cand);
+        if (cand_len == 0) continue;
+        for (uint8_t j = 0; j <= len; j++) rows[0][j] = (uint16_t)(j * DICT_APPROX_UNIT);
+        uint16_t row_min = 0;
+        for (uint8_t d = 1; d <= cand_len && row_min <= bound; d++) {
+            row_min = dict_approx_row(rows[d - 1], rows[d], cand[d - 1], seq, len);
+        }
+        if (row_min <= bound && rows[cand_len][len] <= bound && rows[cand_len][len] < best_cost) {
+            best_cost = rows[cand_len][len];
+            bound = best_cost;
+            memcpy(best_seq, cand, PHONEME_SEQ_MAX);
+        }
+    }
 
-                char fallback_word[DICT_WORD_SIZE + 1];
-                strncpy(fallback_word, record_word, sizeof(fallback_word) - 1);
-                fallback_word[sizeof(fallback_word) - 1] = '\0';
-
-                bool exact_lang_found = false;
-
-                for (int32_t left = mid - 1; left >= low; left--) {
-                    FSIZE_t left_offset = (FSIZE_t)left * (FSIZE_t)DICT_RECORD_SIZE;
-                    if (f_lseek(&dict_file, left_offset) != FR_OK) break;
-                    if (f_read(&dict_file, record, DICT_RECORD_SIZE, &br) != FR_OK || br < DICT_RECORD_SIZE) break;
-                    record[DICT_RECORD_SIZE] = '\0';
-                    if (!dict_parse_record_line(record, record_seq, &record_lang, record_word, sizeof(record_word))) break;
-                    if (compare_seq_to_record(seq, record_seq) != 0) break;
-                    if (record_lang == target_lang) {
-                        strncpy(word_out, record_word, word_out_len - 1);
-                        word_out[word_out_len - 1] = '\0';
-                        return true;
-                    }
-                }
+    dict_trie_node_t node;
+    if (dict_trie_ready && dict_trie_read_node(DICT_TRIE_ROOT, &node)) {
+        int depth = 0;
+        for (uint8_t j = 0; j <= len; j++) rows[0][j] = (uint16_t)(j * DICT_APPROX_UNIT);
+        block_base[0] = 0;
+        block_count[0] = node.child_count;
+        block_next[0] = 0;
+        if (!dict_trie_read_nodes(node.first_child, dict_approx_block(0), node.child_count)) {
+            depth = -1;
+        }
+        reads++;
 
-                for (int32_t right = mid + 1; right <= high; right++) {
-                    FSIZE_t right_offset = (FSIZE_t)right * (FSIZE_t)DICT_RECORD_SIZE;
-                    if (f_lseek(&dict_file, right_offset) != FR_OK) break;
-                    if (f_read(&dict_file, record, DICT_RECORD_SIZE, &br) != FR_OK || br < DICT_RECORD_SIZE) break;
-                    record[DICT_RECORD_SIZE] = '\0';
-                    if (!dict_parse_record_line(record, record_seq, &record_lang, record_word, sizeof(record_word))) break;
-                    if (compare_seq_to_record(seq, record_seq) != 0) break;
-                    if (record_lang == target_lang) {
-                        exact_lang_found = true;
-                        strncpy(word_out, record_word, word_out_len - 1);
-                        word_out[word_out_len - 1] = '\0';
-                        break;
-                    }
-                }
+        // Depth-first over the child blocks; a subtree is dropped once every cell of its row exceeds the bound.
+        while (depth >= 0) {
+            if (block_next[depth] >= block_count[depth]) {
+                depth--;
+                continue;
+            }
+            dict_trie_unpack_node(dict_approx_block(block_base[depth] + block_next[depth]++), &node);
+            visited++;
 
-                if (exact_lang_found) return true;
+            int d = depth + 1;
+            uint16_t row_min = dict_approx_row(rows[depth], rows[d], node.phoneme, seq, len);
+            if (row_min > bound) continue;
 
-                strncpy(word_out, fallback_word, word_out_len - 1);
-                word_out[word_out_len - 1] = '\0';
-                return true;
+            if ((node.flags & DICT_TRIE_FLAG_TERMINAL) && rows[d][len] <= bound && rows[d][len] < best_cost) {
+                best_cost = rows[d][len];
+                bound = best_cost;
+                best_line = node.line_offset;
             }
 
-            if (cmp < 0) {
-                high = mid - 1;
-            } else {
-                low = mid + 1;
+            if (node.child_count > 0 && d < PHONEME_SEQ_MAX) {
+                uint32_t base = (uint32_t)block_base[depth] + block_count[depth];
+                if (reads >= DICT_APPROX_READ_BUDGET || base + node.child_count > DICT_SCRATCH_NODES) {
+                    dict_approx_stats.truncated++;
+                    break;
+                }
+                reads++;
+                if (!dict_trie_read_nodes(node.first_child, dict_approx_block((uint16_t)base), node.child_count)) break;
+                block_base[d] = (uint16_t)base;
+                block_count[d] = node.child_count;
+                block_next[d] = 0;
+                depth = d;
             }
         }
     }
 
-    // Not found in Dictionary.dat, try NewWords.dat
-    FIL newwords;
-    res = f_open(&newwords, "0:/microsd/NewWords.dat", FA_READ | FA_OPEN_EXISTING);
-    if (res != FR_OK) {
-        // NewWords.dat doesn't exist yet, word truly not found
-        return false;
+    dict_approx_stats.nodes += visited;
+    dict_approx_stats.reads += reads;
+    if (best_cost == UINT16_MAX) return false;
+
+    if (best_line != DICT_TRIE_NONE) {
+        char line[DICT_LINE_BUF];
+        uint8_t key[DICT_KEY_SIZE];
+        if (!dict_read_line_at(&dict_file, best_line, line)) return false;
+        if (!dict_parse_record_key(line, key)) return false;
+        memcpy(best_seq, key, PHONEME_SEQ_MAX);
     }
 
-    while (1) {
-        res = f_read(&newwords, record, DICT_RECORD_SIZE, &br);
-        if (res != FR_OK || br < DICT_RECORD_SIZE) break;
-        record[DICT_RECORD_SIZE] = '\0';
+    if (!dict_lookup_word(best_seq, word_out, word_out_len)) return false;
+    dict_approx_stats.hits++;
+    if (cost_out) *cost_out = best_cost;
+    return true;
+}
 
-        if (!dict_parse_record_line(record, record_seq, &record_lang, record_word, sizeof(record_word))) {
-            break;
-        }
+static void dict_report_stats(void) {
+    char line[160];
+    uint32_t n = dict_stats.lookups ? dict_stats.lookups : 1;
+    snprintf(line,
+             sizeof(line),
+             "DICTSTATS lookups=%lu probes/lookup=%lu.%02lu blocks/lookup=%lu.%02lu sectors/lookup=%lu.%02lu single_block=%lu%%",
+             (unsigned long)dict_stats.lookups,
+             (unsigned long)(dict_stats.probes / n), (unsigned long)((dict_stats.probes * 100u / n) % 100u),
+             (unsigned long)(dict_stats.block_reads / n), (unsigned long)((dict_stats.block_reads * 100u / n) % 100u),
+             (unsigned long)(dict_stats.sector_reads / n), (unsigned long)((dict_stats.sector_reads * 100u / n) % 100u),
+             (unsigned long)(dict_stats.single_block_lookups * 100u / n));
+    output_send_line(line);
 
-        int match = (compare_seq_to_record(seq, record_seq) == 0) && (record_lang == target_lang);
+    snprintf(line,
+             sizeof(line),
+             "DICTSTATS last: probes=%u blocks=%u sectors=%u fences=%lu stride=%lu budget=%u",
+             (unsigned)dict_stats.last_probes,
+             (unsigned)dict_stats.last_block_reads,
+             (unsigned)dict_stats.last_sector_reads,
+             (unsigned long)dict_fence_count,
+             (unsigned long)dict_fence_stride,
+             (unsigned)DICT_FENCE_BUDGET_BYTES);
+    output_send_line(line);
 
-        if (match) {
-            strncpy(word_out, record_word, word_out_len - 1);
-            word_out[word_out_len - 1] = '\0';
-            f_close(&newwords);
-            return true;
-        }
-    }
+    snprintf(line,
+             sizeof(line),
+             "DICTSTATS xip: state=%s records=%lu segments=%u hits=%lu syncs=%lu region=%luKB",
+             dict_xip_ready ? "ready" : (dict_xip_sync.active ? "syncing" : "off"),
+             (unsigned long)dict_xip_record_count,
+             (unsigned)dict_xip_segment_count,
+             (unsigned long)dict_xip_hits,
+             (unsigned long)dict_xip_syncs,
+             (unsigned long)(DICT_XIP_REGION_BYTES / 1024));
+    output_send_line(line);
 
-    f_close(&newwords);
-    return false;
+    snprintf(line,
+             sizeof(line),
+             "DICTSTATS languages: segments=%u primary_hits=%lu fallback_hits=%lu fallback_searches=%lu",
+             (unsigned)dict_bin_segment_count,
+             (unsigned long)dict_stats.primary_hits,
+             (unsigned long)dict_stats.fallback_hits,
+             (unsigned long)dict_stats.fallback_searches);
+    output_send_line(line);
+
+    snprintf(line,
+             sizeof(line),
+             "DICTSTATS newwords: entries=%lu scans=%lu skipped=%lu false_pos=%lu filter=%s",
+             (unsigned long)dict_bloom_entries,
+             (unsigned long)dict_stats.newwords_scans,
+             (unsigned long)dict_stats.newwords_skips,
+             (unsigned long)dict_stats.bloom_false_positives,
+             dict_bloom_ready ? "on" : "off");
+    output_send_line(line);
+
+    uint32_t table_lookups = dict_newwords_stats.lookups ? dict_newwords_stats.lookups : 1;
+    snprintf(line,
+             sizeof(line),
+             "DICTSTATS newwords table: used=%u/%u slots=%u load=%u%% probes/lookup=%lu.%02lu max_probe=%u max_insert_probe=%u hits=%lu complete=%s",
+             (unsigned)dict_newwords_used,
+             (unsigned)DICT_NEWWORDS_POOL,
+             (unsigned)DICT_NEWWORDS_SLOTS,
+             (unsigned)(dict_newwords_used * 100u / DICT_NEWWORDS_SLOTS),
+             (unsigned long)(dict_newwords_stats.probes / table_lookups),
+             (unsigned long)((dict_newwords_stats.probes * 100u / table_lookups) % 100u),
+             (unsigned)dict_newwords_stats.max_probe,
+             (unsigned)dict_newwords_stats.max_insert_probe,
+             (unsigned long)dict_newwords_stats.hits,
+             dict_newwords_complete ? "yes" : "no");
+    output_send_line(line);
+
+    snprintf(line,
+             sizeof(line),
+             "DICTSTATS lsm: memtable=%u/%u frozen=%u compaction=%s written=%lu compactions=%lu",
+             (unsigned)dict_memtable_count,
+             (unsigned)DICT_MEMTABLE_MAX,
+             (unsigned)dict_memtable_frozen,
+             dict_compaction.active ? "running" : "idle",
+             (unsigned long)dict_compaction.written,
+             (unsigned long)dict_compactions);
+    output_send_line(line);
+
+    uint32_t attempts = dict_approx_stats.attempts ? dict_approx_stats.attempts : 1;
+    snprintf(line,
+             sizeof(line),
+             "DICTSTATS approx: max=%u.%u attempts=%lu hits=%lu nodes/attempt=%lu reads/attempt=%lu truncated=%lu",
+             (unsigned)(dict_approx_max_cost / DICT_APPROX_UNIT),
+             (unsigned)(dict_approx_max_cost % DICT_APPROX_UNIT),
+             (unsigned long)dict_approx_stats.attempts,
+             (unsigned long)dict_approx_stats.hits,
+             (unsigned long)(dict_approx_stats.nodes / attempts),
+             (unsigned long)(dict_approx_stats.reads / attempts),
+             (unsigned long)dict_approx_stats.truncated);
+    output_send_line(line);
+
+    uint32_t steps = dict_phrase_stats.steps ? dict_phrase_stats.steps : 1;
+    snprintf(line,
+             sizeof(line),
+             "DICTSTATS phrases: state=%s states=%lu patterns=%lu steps=%lu hits=%lu phrase_hits=%lu superseded=%lu dropped=%lu fails/step=%lu.%02lu reads/step=%lu.%02lu",
+             dict_phrase_ready ? "ready" : "off",
+             (unsigned long)dict_phrase_node_count,
+             (unsigned long)dict_phrase_pattern_count,
+             (unsigned long)dict_phrase_stats.steps,
+             (unsigned long)dict_phrase_stats.hits,
+             (unsigned long)dict_phrase_stats.phrase_hits,
+             (unsigned long)dict_phrase_stats.superseded,
+             (unsigned long)dict_phrase_stats.dropped,
+             (unsigned long)(dict_phrase_stats.fail_steps / steps),
+             (unsigned long)((dict_phrase_stats.fail_steps * 100u / steps) % 100u),
+             (unsigned long)(dict_phrase_stats.reads / steps),
+             (unsigned long)((dict_phrase_stats.reads * 100u / steps) % 100u));
+    output_send_line(line);
+
+    uint16_t cached = 0;
+    for (uint16_t i = 0; i < DICT_CACHE_ENTRIES; i++) {
+        if (dict_cache[i].hash != 0) cached++;
+    }
+    uint32_t cache_lookups = dict_cache_stats.hits + dict_cache_stats.misses;
+    snprintf(line,
+             sizeof(line),
+             "DICTSTATS cache: entries=%u/%u hit_rate=%lu%% hits=%lu misses=%lu evictions=%lu invalidated=%lu preloaded=%u saves=%lu",
+             (unsigned)cached,
+             (unsigned)DICT_CACHE_ENTRIES,
+             (unsigned long)(cache_lookups ? (uint64_t)dict_cache_stats.hits * 100u / cache_lookups : 0),
+             (unsigned long)dict_cache_stats.hits,
+             (unsigned long)dict_cache_stats.misses,
+             (unsigned long)dict_cache_stats.evictions,
+             (unsigned long)dict_cache_stats.invalidations,
+             (unsigned)dict_cache_stats.preloaded,
+             (unsigned long)dict_cache_stats.saves);
+    output_send_line(line);
 }
 
 // ==============================
@@ -1776,17 +5643,11 @@ static bool load_ann_to_all_stage2(uint8_t version) {
     char path[80];
     if (!ann_path_from_version(version, path, sizeof(path))) return false;
 
-    bool ok = true;
-    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
-        uint8_t addr = (uint8_t)(STAGE2_BASE_ADDR + i);
-        menu_render_load_ann_progress(version, (uint8_t)(i + 1), STAGE2_COUNT);
-
-        if (!stage2_load_nn_from_sd(addr, path)) {
-            ok = false;
-        }
-    }
-
-    return ok;
+    uint8_t all = (uint8_t)((1u << STAGE2_COUNT) - 1u);
+    menu_render_load_ann_progress(version, 0, STAGE2_COUNT);
+    uint8_t loaded = stage2_load_nn_broadcast(path, all);
+    menu_render_load_ann_progress(version, (uint8_t)__builtin_popcount(loaded), STAGE2_COUNT);
+    return loaded == all;
 }
 
 static bool load_ann_menu_start(void) {
@@ -1870,7 +5731,7 @@ static bool word_is_short(const char *word, size_t len) {
 
 static int phoneme_count(const uint8_t *seq) {
     int count = 0;
-    for (int i = 0; i < PHONEME_SEQ_LEN; i++) {
+    for (int i = 0; i < PHONEME_SEQ_MAX; i++) {
         uint8_t id = seq[i];
         if (id >= 0x05 && id <= 0x2C) count++;
     }
@@ -1905,26 +5766,21 @@ static bool generate_sample_words(void) {
     bool progress = true;
     while (progress) {
         progress = false;
-        uint8_t best_seq[PHONEME_SEQ_LEN] = {0};
+        uint8_t best_seq[PHONEME_SEQ_MAX] = {0};
         int best_gain = 0;
         char best_word[DICT_WORD_SIZE + 1] = {0};
 
-        f_lseek(&dict, 0);
-        UINT br = 0;
-        char record[DICT_RECORD_SIZE + 1];
-        uint8_t parsed_seq[PHONEME_SEQ_LEN];
-        uint8_t parsed_lang = LANG_UNKNOWN;
+        dict_reader_t reader;
+        char line[DICT_LINE_BUF];
+        uint8_t parsed_seq[DICT_KEY_SIZE];
         char parsed_word[DICT_WORD_SIZE + 1];
-        while (1) {
-            res = f_read(&dict, record, DICT_RECORD_SIZE, &br);
-            if (res != FR_OK || br < DICT_RECORD_SIZE) break;
-            record[DICT_RECORD_SIZE] = '\0';
-
-            if (!dict_parse_record_line(record, parsed_seq, &parsed_lang, parsed_word, sizeof(parsed_word))) {
+        if (!dict_reader_start(&reader, &dict, 0)) break;
+        while (dict_reader_next(&reader, line, sizeof(line), NULL)) {
+            if (!dict_parse_record_line(line, parsed_seq, parsed_word, sizeof(parsed_word))) {
                 continue;
             }
 
-            if (parsed_lang != target_language_id) continue;
+            if (parsed_seq[PHONEME_SEQ_MAX] != target_language_id) continue;
 
             int pcount = phoneme_count(parsed_seq);
             if (pcount == 0 || pcount > MAX_PHONEMES_PER_WORD) continue;
@@ -1933,7 +5789,7 @@ static bool generate_sample_words(void) {
             if (!word_is_short(parsed_word, wlen)) continue;
 
             int gain = 0;
-            for (int i = 0; i < PHONEME_SEQ_LEN; i++) {
+            for (int i = 0; i < PHONEME_SEQ_MAX; i++) {
                 uint8_t id = parsed_seq[i];
                 if (id >= phoneme_min && id <= phoneme_max) {
                     int idx = id - phoneme_min;
@@ -1944,7 +5800,9 @@ static bool generate_sample_words(void) {
             if (gain > best_gain) {
                 best_gain = gain;
                 memcpy(best_seq, parsed_seq, sizeof(best_seq));
-                strncpy(best_word, parsed_word, sizeof(best_word) - 1);
+                size_t word_len = strnlen(parsed_word, sizeof(best_word) - 1);
+                memcpy(best_word, parsed_word, word_len);
+                best_word[word_len] = '\0';
             }
         }
 
@@ -1953,7 +5811,7 @@ static bool generate_sample_words(void) {
             f_write(&out, best_word, (UINT)strlen(best_word), &bw);
             f_write(&out, "\r\n", 2, &bw);
 
-            for (int i = 0; i < PHONEME_SEQ_LEN; i++) {
+            for (int i = 0; i < PHONEME_SEQ_MAX; i++) {
                 uint8_t id = best_seq[i];
                 if (id >= phoneme_min && id <= phoneme_max) {
                     int idx = id - phoneme_min;
@@ -1985,6 +5843,9 @@ static bool dict_merge_new_words(void) {
         return false;
     }
 
+    // The append handle must not stay open across the unlink below
+    dict_newwords_close();
+
     // Check if NewWords.dat exists
     FILINFO fno;
     FRESULT res = f_stat("0:/microsd/NewWords.dat", &fno);
@@ -1993,52 +5854,55 @@ static bool dict_merge_new_words(void) {
         return true;  // Not an error, just nothing to do
     }
 
-    // Open Dictionary.dat in read/write mode for sorted insertion
-    FIL dict;
-    res = f_open(&dict, "0:/microsd/Dictionary.dat", FA_READ | FA_WRITE | FA_OPEN_EXISTING);
-    if (res != FR_OK) {
-        printf("ERROR: Failed to open Dictionary.dat for update (code %d)\\n", res);
-        return false;
-    }
-
     // Open NewWords.dat for reading
     FIL newwords;
     res = f_open(&newwords, "0:/microsd/NewWords.dat", FA_READ | FA_OPEN_EXISTING);
     if (res != FR_OK) {
-        f_close(&dict);
         printf("ERROR: Failed to open NewWords.dat (code %d)\\n", res);
         return false;
     }
 
-    uint8_t record[DICT_RECORD_SIZE];
-    UINT br;
+    dict_reader_t reader;
+    char line[DICT_LINE_BUF];
+    uint8_t key[DICT_KEY_SIZE];
+    char word[DICT_WORD_SIZE + 1];
     uint32_t merged_count = 0;
 
-    // Insert all NewWords.dat records into Dictionary.dat with reverse-bubble sorted placement
-    while (1) {
-        res = f_read(&newwords, record, DICT_RECORD_SIZE, &br);
-        if (res != FR_OK || br < DICT_RECORD_SIZE) break;
+    // Each record goes to the memtable + Dictionary.delta; the memtable flushes itself when full
+    dict_reader_start(&reader, &newwords, 0);
+    while (dict_reader_next(&reader, line, sizeof(line), NULL)) {
+        if (!dict_parse_record_line(line, key, word, sizeof(word))) continue;
 
-        if (!dict_insert_sorted_record(&dict, (const char *)record)) {
-            printf("ERROR: Failed to insert merged record in sorted order\\n");
-            f_close(&dict);
+        if (!dict_lsm_add(key, word)) {
+            printf("ERROR: Failed to add merged record %lu\n", (unsigned long)merged_count);
             f_close(&newwords);
             return false;
         }
         merged_count++;
     }
 
-    f_close(&dict);
     f_close(&newwords);
+    if (reader.error) {
+        printf("ERROR: Failed to read NewWords.dat after %lu records\n", (unsigned long)merged_count);
+        return false;
+    }
 
-    // Delete NewWords.dat after successful merge
+    // Every record is durable in Dictionary.delta now, so NewWords.dat can go before the merge pass
     res = f_unlink("0:/microsd/NewWords.dat");
     if (res != FR_OK) {
         printf("WARNING: Failed to delete NewWords.dat after merge (code %d)\\n", res);
         // Not fatal, continue
+    } else {
+        dict_bloom_clear();
+        dict_newwords_reset();
+    }
+
+    // One streaming pass writes Dictionary.dat with all pending records in place
+    if (!dict_compact_now()) {
+        printf("WARNING: Dictionary compaction deferred, merged words stay in Dictionary.delta\n");
     }
 
-    printf("INFO: Merged %lu new words into Dictionary.dat\\n", merged_count);
+    printf("INFO: Merged %lu new words into Dictionary.dat\n", (unsigned long)merged_count);
     return true;
 }
 
@@ -2051,24 +5915,20 @@ static uint8_t load_unrecognised_preview(void) {
         return 0;
     }
 
-    char record[DICT_RECORD_SIZE + 1];
-    uint8_t parsed_seq[PHONEME_SEQ_LEN];
+    dict_reader_t reader;
+    char line[DICT_LINE_BUF];
+    uint8_t parsed_seq[DICT_KEY_SIZE];
     char parsed_word[DICT_WORD_SIZE + 1];
-    UINT br;
-    while (unrec_preview_count < UNREC_PREVIEW_COUNT) {
-        res = f_read(&newwords, record, DICT_RECORD_SIZE, &br);
-        if (res != FR_OK || br < DICT_RECORD_SIZE) {
-            break;
-        }
-        record[DICT_RECORD_SIZE] = '\0';
-
-        if (!dict_parse_record_line(record, parsed_seq, NULL, parsed_word, sizeof(parsed_word))) {
+    dict_reader_start(&reader, &newwords, 0);
+    while (unrec_preview_count < UNREC_PREVIEW_COUNT &&
+           dict_reader_next(&reader, line, sizeof(line), NULL)) {
+        if (!dict_parse_record_line(line, parsed_seq, parsed_word, sizeof(parsed_word))) {
             continue;
         }
 
-        strncpy(unrec_preview[unrec_preview_count], parsed_word,
-                sizeof(unrec_preview[unrec_preview_count]) - 1);
-        unrec_preview[unrec_preview_count][sizeof(unrec_preview[unrec_preview_count]) - 1] = '\0';
+        size_t word_len = strnlen(parsed_word, sizeof(unrec_preview[unrec_preview_count]) - 1);
+        memcpy(unrec_preview[unrec_preview_count], parsed_word, word_len);
+        unrec_preview[unrec_preview_count][word_len] = '\0';
         unrec_preview_count++;
     }
 
@@ -2076,65 +5936,40 @@ static uint8_t load_unrecognised_preview(void) {
     return unrec_preview_count;
 }
 
-static bool dict_target_from_word(const char *word, uint8_t *target_out) {
-    if (!dict_ready) return false;
+static bool dict_seq_from_word(const char *word, uint8_t *seq_out) {
+    if (!dict_ready || !word || !seq_out) return false;
 
-    FIL dict;
-    if (f_open(&dict, "0:/microsd/Dictionary.dat", FA_READ | FA_OPEN_EXISTING) != FR_OK) return false;
+    const dict_mem_entry_t *pending = dict_memtable_find_word(word);
+    if (pending) {
+        memcpy(seq_out, pending->key, PHONEME_SEQ_MAX);
+        return true;
+    }
 
-    UINT br = 0;
-    char record[DICT_RECORD_SIZE + 1];
-    uint8_t parsed_seq[PHONEME_SEQ_LEN];
+    uint8_t parsed_seq[DICT_KEY_SIZE];
     char parsed_word[DICT_WORD_SIZE + 1];
-    bool found = false;
-
-    while (1) {
-        if (f_read(&dict, record, DICT_RECORD_SIZE, &br) != FR_OK || br < DICT_RECORD_SIZE) break;
-        record[DICT_RECORD_SIZE] = '\0';
-
-        if (!dict_parse_record_line(record, parsed_seq, NULL, parsed_word, sizeof(parsed_word))) {
-            continue;
-        }
 
-        if (strcasecmp_local(parsed_word, word) == 0) {
-            for (int i = 0; i < PHONEME_SEQ_LEN; i++) {
-                uint8_t id = parsed_seq[i];
-                if (id >= 0x05 && id <= 0x2C) {
-                    *target_out = id;
-                    found = true;
-                    break;
-                }
-            }
-            break;
-        }
+    // Dictionary.widx answers with one bucket read; the full scan is only the fallback without it.
+    if (dict_widx_ready) {
+        if (!dict_widx_find(word, parsed_seq)) return false;
+        memcpy(seq_out, parsed_seq, PHONEME_SEQ_MAX);
+        return true;
     }
 
-    f_close(&dict);
-    return found;
-}
-
-static bool dict_seq_from_word(const char *word, uint8_t *seq_out) {
-    if (!dict_ready || !word || !seq_out) return false;
-
     FIL dict;
     if (f_open(&dict, "0:/microsd/Dictionary.dat", FA_READ | FA_OPEN_EXISTING) != FR_OK) return false;
 
-    UINT br = 0;
-    char record[DICT_RECORD_SIZE + 1];
-    uint8_t parsed_seq[PHONEME_SEQ_LEN];
-    char parsed_word[DICT_WORD_SIZE + 1];
+    dict_reader_t reader;
+    char line[DICT_LINE_BUF];
     bool found = false;
 
-    while (1) {
-        if (f_read(&dict, record, DICT_RECORD_SIZE, &br) != FR_OK || br < DICT_RECORD_SIZE) break;
-        record[DICT_RECORD_SIZE] = '\0';
-
-        if (!dict_parse_record_line(record, parsed_seq, NULL, parsed_word, sizeof(parsed_word))) {
+    dict_reader_start(&reader, &dict, 0);
+    while (dict_reader_next(&reader, line, sizeof(line), NULL)) {
+        if (!dict_parse_record_line(line, parsed_seq, parsed_word, sizeof(parsed_word))) {
             continue;
         }
 
         if (strcasecmp_local(parsed_word, word) == 0) {
-            memcpy(seq_out, parsed_seq, PHONEME_SEQ_LEN);
+            memcpy(seq_out, parsed_seq, PHONEME_SEQ_MAX);
             found = true;
             break;
         }
@@ -2144,11 +5979,26 @@ static bool dict_seq_from_word(const char *word, uint8_t *seq_out) {
     return found;
 }
 
+// The target neuron is the first real phoneme of the word's sequence.
+static bool dict_target_from_word(const char *word, uint8_t *target_out) {
+    uint8_t seq[PHONEME_SEQ_MAX];
+    if (!target_out || !dict_seq_from_word(word, seq)) return false;
+
+    for (int i = 0; i < PHONEME_SEQ_MAX; i++) {
+        uint8_t id = seq[i];
+        if (id >= 0x05 && id <= 0x2C) {
+            *target_out = id;
+            return true;
+        }
+    }
+    return false;
+}
+
 static uint8_t build_expected_phoneme_list(const uint8_t *seq, uint8_t *expected_out, uint8_t expected_max) {
     if (!seq || !expected_out || expected_max == 0) return 0;
 
     uint8_t count = 0;
-    for (uint8_t i = 0; i < PHONEME_SEQ_LEN && count < expected_max; i++) {
+    for (uint8_t i = 0; i < PHONEME_SEQ_MAX && count < expected_max; i++) {
         uint8_t id = seq[i];
         if (id >= 0x05 && id <= 0x2C) {
             expected_out[count++] = id;
@@ -2182,52 +6032,179 @@ static uint8_t sequence_order_match_percent(const uint8_t *expected,
 
 static bool stage2_write_reg8(uint8_t addr, uint8_t reg, uint8_t value) {
     uint8_t buf[2] = {reg, value};
-    return i2c_write_blocking(I2C_STAGE2_PORT, addr, buf, 2, false) == 2;
+    return i2c_transfer(addr, I2C_CLASS_TRAINING, buf, 2, NULL, 0);
 }
 
 static bool stage2_write_reg16(uint8_t addr, uint8_t reg, uint16_t value) {
     uint8_t buf[3] = {reg, (uint8_t)(value & 0xFF), (uint8_t)((value >> 8) & 0xFF)};
-    return i2c_write_blocking(I2C_STAGE2_PORT, addr, buf, 3, false) == 3;
+    return i2c_transfer(addr, I2C_CLASS_TRAINING, buf, 3, NULL, 0);
 }
 
 static bool stage2_read_reg8(uint8_t addr, uint8_t reg, uint8_t *value_out) {
-    if (i2c_write_blocking(I2C_STAGE2_PORT, addr, &reg, 1, true) != 1) return false;
-    return i2c_read_blocking(I2C_STAGE2_PORT, addr, value_out, 1, false) == 1;
+    return i2c_transfer(addr, I2C_CLASS_TRAINING, &reg, 1, value_out, 1);
+}
+
+// Capability bits of a Stage 2 beam (0 for other addresses). A beam that does not answer counts
+// as having none, which keeps the register-by-register path that every firmware supports.
+static bool stage2_has_cap(uint8_t addr, uint8_t cap) {
+    if (addr < STAGE2_BASE_ADDR || addr >= STAGE2_BASE_ADDR + STAGE2_COUNT) return false;
+    uint8_t beam = (uint8_t)(addr - STAGE2_BASE_ADDR);
+    if (!stage2_caps_known[beam]) {
+        uint8_t caps = 0;
+        if (!stage2_read_reg8(addr, STAGE2_REG_CAPS, &caps) || caps == 0xFF) caps = 0;
+        stage2_caps[beam] = caps;
+        stage2_caps_known[beam] = true;
+    }
+    return (stage2_caps[beam] & cap) != 0;
+}
+
+// Writes two patterns to a register and reads them back at each tier from the fastest down. The
+// first tier that returns both intact is kept; a device that never does (absent, or without a
+// readable register) stays at I2C_STAGE2_BAUD.
+static void i2c_speed_probe(uint8_t addr) {
+    i2c_device_t *dev = i2c_device(addr);
+    if (!dev) return;
+    bool stage4 = addr == STAGE4_ADDR;
+    uint8_t reg = stage4 ? STAGE4_REG_IMAGE_LINE_PTR : STAGE2_REG_PAGE_ADDR;
+    // Stage 4 checks its line pointer against the image height, so its patterns stay small
+    const uint16_t patterns[2] = {stage4 ? 0x0055 : 0x55AA, stage4 ? 0x002A : 0xAA55};
+
+    for (uint8_t tier = 0; tier < I2C_SPEED_TIER_COUNT; tier++) {
+        dev->tier = tier;
+        bool ok = true;
+        for (int i = 0; i < 2 && ok; i++) {
+            uint8_t back[2] = {0};
+            ok = stage2_write_reg16(addr, reg, patterns[i]) &&
+                 i2c_transfer(addr, I2C_CLASS_TRAINING, &reg, 1, back, 2) &&
+                 (uint16_t)(back[0] | (back[1] << 8)) == patterns[i];
+        }
+        if (ok) {
+            stage2_write_reg16(addr, reg, 0);
+            dev->probed = true;
+            i2c_device_reset_health(dev);
+            printf("INFO: I2C 0x%02X runs at %lu kHz\n", addr, (unsigned long)(i2c_speed_tiers[tier] / 1000u));
+            return;
+        }
+    }
+    dev->tier = I2C_SPEED_DEFAULT_TIER;
+    dev->probed = false;
+    i2c_device_reset_health(dev);
+    printf("WARNING: I2C 0x%02X failed the speed probe; using %lu kHz\n", addr, (unsigned long)(I2C_STAGE2_BAUD / 1000u));
 }
 
-static bool stage2_page_read(uint8_t addr, uint8_t page_mode, uint16_t page_addr, uint16_t len, uint8_t *dst) {
-    if (!stage2_write_reg8(addr, STAGE2_REG_PAGE_MODE, page_mode)) return false;
-    if (!stage2_write_reg16(addr, STAGE2_REG_PAGE_ADDR, page_addr)) return false;
-    if (!stage2_write_reg16(addr, STAGE2_REG_PAGE_LEN, len)) return false;
-
-    uint16_t remaining = len;
-    while (remaining > 0) {
-        uint16_t chunk = remaining > 128 ? 128 : remaining;
-        uint8_t reg = STAGE2_REG_PAGE_DATA;
-        if (i2c_write_blocking(I2C_STAGE2_PORT, addr, &reg, 1, true) != 1) return false;
-        if (i2c_read_blocking(I2C_STAGE2_PORT, addr, dst, chunk, false) != chunk) return false;
-        dst += chunk;
-        remaining -= chunk;
+static void i2c_speed_probe_all(void) {
+    for (uint8_t i = 0; i < I2C_DEVICE_COUNT; i++) {
+        i2c_speed_probe((uint8_t)(STAGE2_BASE_ADDR + i));
     }
-    return true;
 }
 
-static bool stage2_page_write(uint8_t addr, uint8_t page_mode, uint16_t page_addr, uint16_t len, const uint8_t *src) {
-    if (!stage2_write_reg8(addr, STAGE2_REG_PAGE_MODE, page_mode)) return false;
-    if (!stage2_write_reg16(addr, STAGE2_REG_PAGE_ADDR, page_addr)) return false;
-    if (!stage2_write_reg16(addr, STAGE2_REG_PAGE_LEN, len)) return false;
+// ==============================
+// Batched page transfers
+// ==============================
+static void stage2_batch_begin(stage2_batch_t *batch) {
+    batch->group.failed = false;
+    batch->submitted = 0;
+    batch->ok = true;
+}
+
+// Next free descriptor; once all are in flight, waits for the oldest.
+static i2c_async_desc_t *stage2_batch_next(stage2_batch_t *batch, uint8_t addr) {
+    i2c_async_desc_t *desc = &batch->desc[batch->submitted % STAGE2_BATCH_DEPTH];
+    if (batch->submitted >= STAGE2_BATCH_DEPTH && !i2c_async_wait(desc)) batch->ok = false;
+    *desc = (i2c_async_desc_t){.addr = addr, .bus_class = I2C_CLASS_TRAINING, .group = &batch->group};
+    return desc;
+}
+
+static void stage2_batch_submit(stage2_batch_t *batch, i2c_async_desc_t *desc) {
+    if (batch->ok && !i2c_async_submit(desc)) batch->ok = false;
+    batch->submitted++;
+}
+
+static void stage2_batch_reg(stage2_batch_t *batch, uint8_t addr, uint8_t reg, uint16_t value, uint8_t size) {
+    i2c_async_desc_t *desc = stage2_batch_next(batch, addr);
+    desc->header[0] = reg;
+    desc->header[1] = (uint8_t)(value & 0xFF);
+    desc->header[2] = (uint8_t)((value >> 8) & 0xFF);
+    desc->header_len = (uint8_t)(1 + size);
+    stage2_batch_submit(batch, desc);
+}
+
+static void stage2_batch_read(stage2_batch_t *batch, uint8_t addr, uint8_t reg, uint8_t *dst, uint16_t len) {
+    i2c_async_desc_t *desc = stage2_batch_next(batch, addr);
+    desc->header[0] = reg;
+    desc->header_len = 1;
+    desc->rx = dst;
+    desc->rx_len = len;
+    stage2_batch_submit(batch, desc);
+}
+
+// Register-block write of page mode, address and length (STAGE2_CAP_REG_BLOCK).
+static void stage2_page_header(i2c_async_desc_t *desc, uint8_t page_mode, uint16_t page_addr, uint16_t len) {
+    desc->header[0] = STAGE2_REG_PAGE_MODE;
+    desc->header[1] = page_mode;
+    desc->header[2] = (uint8_t)(page_addr & 0xFF);
+    desc->header[3] = (uint8_t)(page_addr >> 8);
+    desc->header[4] = (uint8_t)(len & 0xFF);
+    desc->header[5] = (uint8_t)(len >> 8);
+    desc->header_len = STAGE2_PAGE_HEADER_SIZE;
+}
+
+// Queues a page read (src NULL) or write (dst NULL) in 128-byte chunks; src/dst must stay valid
+// until stage2_batch_finish(). With STAGE2_CAP_REG_BLOCK the page setup travels as the header of
+// the first chunk; otherwise mode, address and length are three writes of their own.
+static void stage2_batch_page(stage2_batch_t *batch,
+                              uint8_t addr,
+                              uint8_t page_mode,
+                              uint16_t page_addr,
+                              uint16_t len,
+                              const uint8_t *src,
+                              uint8_t *dst) {
+    bool block = stage2_has_cap(addr, STAGE2_CAP_REG_BLOCK);
+    if (!block) {
+        stage2_batch_reg(batch, addr, STAGE2_REG_PAGE_MODE, page_mode, 1);
+        stage2_batch_reg(batch, addr, STAGE2_REG_PAGE_ADDR, page_addr, 2);
+        stage2_batch_reg(batch, addr, STAGE2_REG_PAGE_LEN, len, 2);
+    }
+
+    for (uint16_t offset = 0; offset < len; offset += 128) {
+        uint16_t chunk = (uint16_t)(len - offset > 128 ? 128 : len - offset);
+        i2c_async_desc_t *desc = stage2_batch_next(batch, addr);
+        if (block && offset == 0) {
+            stage2_page_header(desc, page_mode, page_addr, len);
+        } else {
+            desc->header[0] = STAGE2_REG_PAGE_DATA;
+            desc->header_len = 1;
+        }
+        if (dst) {
+            desc->rx = dst + offset;
+            desc->rx_len = chunk;
+        } else {
+            desc->tx = src + offset;
+            desc->tx_len = chunk;
+        }
+        stage2_batch_submit(batch, desc);
+    }
+}
 
-    uint16_t remaining = len;
-    while (remaining > 0) {
-        uint16_t chunk = remaining > 128 ? 128 : remaining;
-        uint8_t buf[129];
-        buf[0] = STAGE2_REG_PAGE_DATA;
-        memcpy(&buf[1], src, chunk);
-        if (i2c_write_blocking(I2C_STAGE2_PORT, addr, buf, (int)(chunk + 1), false) != (int)(chunk + 1)) return false;
-        src += chunk;
-        remaining -= chunk;
+static bool stage2_batch_finish(stage2_batch_t *batch) {
+    for (uint32_t i = 0; i < STAGE2_BATCH_DEPTH && i < batch->submitted; i++) {
+        if (!i2c_async_wait(&batch->desc[i])) batch->ok = false;
     }
-    return true;
+    return batch->ok && !batch->group.failed;
+}
+
+static bool stage2_page_read(uint8_t addr, uint8_t page_mode, uint16_t page_addr, uint16_t len, uint8_t *dst) {
+    stage2_batch_t batch;
+    stage2_batch_begin(&batch);
+    stage2_batch_page(&batch, addr, page_mode, page_addr, len, NULL, dst);
+    return stage2_batch_finish(&batch);
+}
+
+static bool stage2_page_write(uint8_t addr, uint8_t page_mode, uint16_t page_addr, uint16_t len, const uint8_t *src) {
+    stage2_batch_t batch;
+    stage2_batch_begin(&batch);
+    stage2_batch_page(&batch, addr, page_mode, page_addr, len, src, NULL);
+    return stage2_batch_finish(&batch);
 }
 
 static bool stage2_clear_input(uint8_t addr) {
@@ -2428,179 +6405,1081 @@ static bool stage2_save_nn_to_sd(uint8_t addr, char *path_out, size_t path_len,
     if (!stage2_write_reg16(addr, STAGE2_REG_CONTROL, STAGE2_CTRL_FREEZE_PAUSE)) return false;
     sleep_ms(5);
 
-    uint8_t buffer[NN_TOTAL_SIZE];
+    uint8_t *buffer = stage2_nn_work.weights;
     uint8_t *ptr = buffer;
+    stage2_batch_t batch;
+    stage2_batch_begin(&batch);
 
     if (show_progress) menu_render_save_ann_progress(version, "Read W1", 20);
-    if (!stage2_page_read(addr, STAGE2_PAGE_W1, 0, W1_SIZE, ptr)) goto cleanup;
+    stage2_batch_page(&batch, addr, STAGE2_PAGE_W1, 0, W1_SIZE, NULL, ptr);
     ptr += W1_SIZE;
     if (show_progress) menu_render_save_ann_progress(version, "Read B1", 40);
-    if (!stage2_page_read(addr, STAGE2_PAGE_B1, 0, B1_SIZE, ptr)) goto cleanup;
+    stage2_batch_page(&batch, addr, STAGE2_PAGE_B1, 0, B1_SIZE, NULL, ptr);
     ptr += B1_SIZE;
     if (show_progress) menu_render_save_ann_progress(version, "Read W2", 60);
-    if (!stage2_page_read(addr, STAGE2_PAGE_W2, 0, W2_SIZE, ptr)) goto cleanup;
+    stage2_batch_page(&batch, addr, STAGE2_PAGE_W2, 0, W2_SIZE, NULL, ptr);
     ptr += W2_SIZE;
     if (show_progress) menu_render_save_ann_progress(version, "Read B2", 80);
-    if (!stage2_page_read(addr, STAGE2_PAGE_B2, 0, B2_SIZE, ptr)) goto cleanup;
+    stage2_batch_page(&batch, addr, STAGE2_PAGE_B2, 0, B2_SIZE, NULL, ptr);
+    if (!stage2_batch_finish(&batch)) goto cleanup;
+    stage2_nn_manifest_read_back(addr, buffer);
+
+    if (!stage2_nn_write_file(path_out, version, buffer)) goto cleanup;
+
+    if (show_progress) menu_render_save_ann_progress(version, "Saved", 100);
+    stage2_write_reg16(addr, STAGE2_REG_CONTROL, 0x0000);
+    return true;
+
+cleanup:
+    stage2_write_reg16(addr, STAGE2_REG_CONTROL, 0x0000);
+    return false;
+}
+
+// ==============================
+// ANN files
+// ==============================
+// Sections of an ANN file after its header, in file order.
+static const struct {
+    uint8_t page_mode;
+    uint16_t size;
+} stage2_nn_sections[] = {
+    {STAGE2_PAGE_W1, W1_SIZE},
+    {STAGE2_PAGE_B1, B1_SIZE},
+    {STAGE2_PAGE_W2, W2_SIZE},
+    {STAGE2_PAGE_B2, B2_SIZE},
+};
+#define STAGE2_NN_SECTION_COUNT (sizeof(stage2_nn_sections) / sizeof(stage2_nn_sections[0]))
+
+// Opens an ANN file and checks its header; the file is left at the first section. Files with a
+// format byte other than NN_FILE_V2 are read as format 1, which never checked it.
+static bool nn_stream_open(nn_stream_t *stream, const char *path) {
+    if (!sd_ready) return false;
+    if (f_open(&stream->file, path, FA_READ | FA_OPEN_EXISTING) != FR_OK) return false;
+
+    uint8_t header[NN_FILE_HEADER_SIZE];
+    UINT br = 0;
+    FRESULT res = f_read(&stream->file, header, sizeof(header), &br);
+    uint16_t in_n = (uint16_t)(header[8] | (header[9] << 8));
+    uint16_t hid_n = (uint16_t)(header[10] | (header[11] << 8));
+    uint16_t out_n = (uint16_t)(header[12] | (header[13] << 8));
+    stream->version = header[4] == NN_FILE_V2 ? NN_FILE_V2 : NN_FILE_V1;
+    stream->flags = stream->version == NN_FILE_V2 ? header[5] : 0;
+    stream->parent = header[6];
+    if (res != FR_OK || br != sizeof(header) || memcmp(header, "NNDT", 4) != 0 || in_n != INPUT_NEURONS ||
+        hid_n != HIDDEN_NEURONS || out_n != OUTPUT_NEURONS ||
+        (stream->version == NN_FILE_V1 && f_size(&stream->file) < sizeof(header) + NN_TOTAL_SIZE)) {
+        f_close(&stream->file);
+        return false;
+    }
+    return true;
+}
+
+static bool nn_stream_begin_section(nn_stream_t *stream, uint16_t size) {
+    stream->run_left = 0;
+    stream->in_pos = 0;
+    stream->in_len = 0;
+    if (stream->version == NN_FILE_V1) {
+        stream->coding = NN_CODING_STORED;
+        stream->coded_left = size;
+        return true;
+    }
+
+    uint8_t header[NN_SECTION_HEADER_SIZE];
+    UINT br = 0;
+    if (f_read(&stream->file, header, sizeof(header), &br) != FR_OK || br != sizeof(header)) return false;
+    stream->coding = header[0];
+    stream->coded_left = (uint32_t)header[1] | ((uint32_t)header[2] << 8) | ((uint32_t)header[3] << 16) |
+                         ((uint32_t)header[4] << 24);
+    if (stream->coding == NN_CODING_STORED) return stream->coded_left == size;
+    return stream->coding == NN_CODING_RLE;
+}
+
+// Next coded byte of the current section, read ahead in small blocks that never cross into the
+// next section.
+static bool nn_stream_byte(nn_stream_t *stream, uint8_t *out) {
+    if (stream->coded_left == 0) return false;
+    if (stream->in_pos == stream->in_len) {
+        UINT want = stream->coded_left < sizeof(stream->in) ? (UINT)stream->coded_left : (UINT)sizeof(stream->in);
+        UINT br = 0;
+        if (f_read(&stream->file, stream->in, want, &br) != FR_OK || br != want) return false;
+        stream->in_pos = 0;
+        stream->in_len = (uint16_t)br;
+    }
+    stream->coded_left--;
+    *out = stream->in[stream->in_pos++];
+    return true;
+}
+
+// Decodes the next len bytes of the current section.
+static bool nn_stream_read(nn_stream_t *stream, uint8_t *dst, uint16_t len) {
+    if (stream->coding == NN_CODING_STORED) {
+        UINT br = 0;
+        if (len > stream->coded_left || f_read(&stream->file, dst, len, &br) != FR_OK || br != len) return false;
+        stream->coded_left -= len;
+        return true;
+    }
+    while (len) {
+        if (stream->run_left == 0) {
+            uint8_t control = 0;
+            if (!nn_stream_byte(stream, &control)) return false;
+            stream->run_literal = control < 128;
+            stream->run_left = (uint8_t)(stream->run_literal ? control + 1 : control - 126);
+            if (!stream->run_literal && !nn_stream_byte(stream, &stream->run_value)) return false;
+        }
+        if (stream->run_literal) {
+            if (!nn_stream_byte(stream, dst)) return false;
+        } else {
+            *dst = stream->run_value;
+        }
+        dst++;
+        stream->run_left--;
+        len--;
+    }
+    return true;
+}
+
+// A section must decode to exactly its size.
+static bool nn_stream_end_section(nn_stream_t *stream) {
+    return stream->coded_left == 0 && stream->run_left == 0;
+}
+
+// Opens an ANN file for stage2_nn_read_section(); a delta file also opens its parent, which must be
+// a keyframe (a file that is not a delta itself).
+static bool stage2_nn_open(stage2_nn_reader_t *reader, const char *path) {
+    if (!nn_stream_open(&reader->file, path)) return false;
+    if (!(reader->file.flags & NN_FILE_FLAG_DELTA)) return true;
+
+    char parent_path[48];
+    if (ann_path_from_version(reader->file.parent, parent_path, sizeof(parent_path)) &&
+        nn_stream_open(&reader->parent, parent_path)) {
+        if (!(reader->parent.flags & NN_FILE_FLAG_DELTA)) return true;
+        f_close(&reader->parent.file);
+    }
+    printf("ERROR: %s needs keyframe RecognizerANN%02u.dat\n", path, (unsigned)reader->file.parent);
+    f_close(&reader->file.file);
+    return false;
+}
+
+static void stage2_nn_close(stage2_nn_reader_t *reader) {
+    if (reader->file.flags & NN_FILE_FLAG_DELTA) f_close(&reader->parent.file);
+    f_close(&reader->file.file);
+}
+
+// Decodes the next section of the file into dst: the parent's section is decoded first and the
+// residuals are added to it as they stream in.
+static bool stage2_nn_read_section(stage2_nn_reader_t *reader, size_t section, uint8_t *dst) {
+    uint16_t size = stage2_nn_sections[section].size;
+    if (!nn_stream_begin_section(&reader->file, size)) return false;
+    if (!(reader->file.flags & NN_FILE_FLAG_DELTA)) {
+        return nn_stream_read(&reader->file, dst, size) && nn_stream_end_section(&reader->file);
+    }
+
+    if (!nn_stream_begin_section(&reader->parent, size) || !nn_stream_read(&reader->parent, dst, size) ||
+        !nn_stream_end_section(&reader->parent)) {
+        return false;
+    }
+    uint8_t residual[64];
+    for (uint16_t offset = 0; offset < size; offset += sizeof(residual)) {
+        uint16_t len = (uint16_t)(size - offset);
+        if (len > sizeof(residual)) len = sizeof(residual);
+        if (!nn_stream_read(&reader->file, residual, len)) return false;
+        for (uint16_t i = 0; i < len; i++) dst[offset + i] = (uint8_t)(dst[offset + i] + residual[i]);
+    }
+    return nn_stream_end_section(&reader->file);
+}
+
+// Buffered file output; with file NULL it only counts the bytes.
+typedef struct {
+    FIL *file;
+    uint32_t count;
+    bool ok;
+    uint16_t len;
+    uint8_t buf[64];
+} nn_writer_t;
+
+static void nn_writer_flush(nn_writer_t *writer) {
+    UINT bw = 0;
+    if (writer->file && writer->len &&
+        (f_write(writer->file, writer->buf, writer->len, &bw) != FR_OK || bw != writer->len)) {
+        writer->ok = false;
+    }
+    writer->len = 0;
+}
+
+static void nn_writer_put(nn_writer_t *writer, uint8_t value) {
+    writer->count++;
+    if (!writer->file) return;
+    writer->buf[writer->len++] = value;
+    if (writer->len == sizeof(writer->buf)) nn_writer_flush(writer);
+}
+
+// PackBits: repeats of three or more bytes become runs, everything else literal blocks.
+static void nn_rle_encode(nn_writer_t *writer, const uint8_t *data, uint16_t size) {
+    uint16_t i = 0;
+    while (i < size) {
+        uint16_t run = 1;
+        while (i + run < size && run < 129 && data[i + run] == data[i]) run++;
+        if (run >= 3) {
+            nn_writer_put(writer, (uint8_t)(run + 126));
+            nn_writer_put(writer, data[i]);
+            i = (uint16_t)(i + run);
+            continue;
+        }
+        uint16_t start = i;
+        while (i < size && i - start < 128) {
+            if (i + 2 < size && data[i] == data[i + 1] && data[i] == data[i + 2]) break;
+            i++;
+        }
+        nn_writer_put(writer, (uint8_t)(i - start - 1));
+        for (uint16_t k = start; k < i; k++) nn_writer_put(writer, data[k]);
+    }
+}
+
+// Bytes a section takes in a format 2 file (without its header) and the coding that gets there.
+static uint32_t nn_section_coded_size(const uint8_t *data, uint16_t size, uint8_t *coding_out) {
+    nn_writer_t counter = {.file = NULL, .ok = true};
+    nn_rle_encode(&counter, data, size);
+    *coding_out = counter.count < size ? NN_CODING_RLE : NN_CODING_STORED;
+    return counter.count < size ? counter.count : size;
+}
+
+static uint32_t nn_coded_size(const uint8_t *weights) {
+    uint32_t total = 0;
+    uint8_t coding = 0;
+    for (size_t i = 0; i < STAGE2_NN_SECTION_COUNT; i++) {
+        total += NN_SECTION_HEADER_SIZE + nn_section_coded_size(weights, stage2_nn_sections[i].size, &coding);
+        weights += stage2_nn_sections[i].size;
+    }
+    return total;
+}
+
+// Adds (sign 1) or subtracts (sign -1) the weights of a keyframe, streamed from the card. With
+// weights NULL it only checks that the keyframe decodes completely.
+static bool nn_apply_keyframe(uint8_t keyframe, uint8_t *weights, int sign) {
+    char path[48];
+    nn_stream_t stream;
+    if (!ann_path_from_version(keyframe, path, sizeof(path)) || !nn_stream_open(&stream, path)) return false;
+    bool ok = !(stream.flags & NN_FILE_FLAG_DELTA);
+    for (size_t i = 0; i < STAGE2_NN_SECTION_COUNT && ok; i++) {
+        uint16_t size = stage2_nn_sections[i].size;
+        ok = nn_stream_begin_section(&stream, size);
+        uint8_t chunk[64];
+        for (uint16_t offset = 0; offset < size && ok; offset += sizeof(chunk)) {
+            uint16_t len = (uint16_t)(size - offset);
+            if (len > sizeof(chunk)) len = sizeof(chunk);
+            ok = nn_stream_read(&stream, chunk, len);
+            for (uint16_t k = 0; weights && k < len && ok; k++) {
+                weights[offset + k] = (uint8_t)(weights[offset + k] + sign * chunk[k]);
+            }
+        }
+        ok = ok && nn_stream_end_section(&stream);
+        if (weights) weights += size;
+    }
+    f_close(&stream.file);
+    return ok;
+}
 
-    FIL file;
-    FRESULT res = f_open(&file, path_out, FA_WRITE | FA_CREATE_NEW);
-    if (res != FR_OK) goto cleanup;
+// Saves weights as a format 2 file. After a fine-tune most weights equal the previous version's,
+// so the file holds residuals against the keyframe behind the previous version while those stay
+// under NN_DELTA_MAX_PERCENT of a keyframe; once the weights have drifted further it becomes a
+// keyframe itself, so later deltas are small again. Each section is PackBits-coded unless that
+// would make it larger. weights is left holding the residuals when a delta is written.
+static bool stage2_nn_write_file(const char *path, uint8_t version, uint8_t *weights) {
+    uint8_t flags = 0;
+    uint8_t keyframe = 0;
+    if (version > 0) {
+        char prev_path[48];
+        nn_stream_t prev;
+        if (ann_path_from_version((uint8_t)(version - 1), prev_path, sizeof(prev_path)) &&
+            nn_stream_open(&prev, prev_path)) {
+            keyframe = (prev.flags & NN_FILE_FLAG_DELTA) ? prev.parent : (uint8_t)(version - 1);
+            f_close(&prev.file);
+            uint32_t key_size = nn_coded_size(weights);
+            // A keyframe that does not decode means a keyframe is written instead. Once weights
+            // is touched, a failed pass fails the save, since weights is then half-applied.
+            if (nn_apply_keyframe(keyframe, NULL, -1)) {
+                if (!nn_apply_keyframe(keyframe, weights, -1)) return false;
+                if (nn_coded_size(weights) * 100u < key_size * NN_DELTA_MAX_PERCENT) {
+                    flags = NN_FILE_FLAG_DELTA;
+                } else if (!nn_apply_keyframe(keyframe, weights, 1)) {
+                    return false;
+                }
+            }
+        }
+    }
 
-    UINT bw = 0;
-    uint8_t header[16] = {'N','N','D','T', 0x01, 0x00, 0x00, 0x00,
-                          (uint8_t)(INPUT_NEURONS & 0xFF), (uint8_t)(INPUT_NEURONS >> 8),
-                          (uint8_t)(HIDDEN_NEURONS & 0xFF), (uint8_t)(HIDDEN_NEURONS >> 8),
-                          (uint8_t)(OUTPUT_NEURONS & 0xFF), (uint8_t)(OUTPUT_NEURONS >> 8),
-                          0x00, 0x00};
-    res = f_write(&file, header, sizeof(header), &bw);
-    if (res != FR_OK || bw != sizeof(header)) {
-        f_close(&file);
-        goto cleanup;
+    FIL file;
+    if (f_open(&file, path, FA_WRITE | FA_CREATE_NEW) != FR_OK) return false;
+    uint8_t header[NN_FILE_HEADER_SIZE] = {'N', 'N', 'D', 'T', NN_FILE_V2, flags, flags ? keyframe : 0, 0x00,
+                                           (uint8_t)(INPUT_NEURONS & 0xFF), (uint8_t)(INPUT_NEURONS >> 8),
+                                           (uint8_t)(HIDDEN_NEURONS & 0xFF), (uint8_t)(HIDDEN_NEURONS >> 8),
+                                           (uint8_t)(OUTPUT_NEURONS & 0xFF), (uint8_t)(OUTPUT_NEURONS >> 8),
+                                           0x00, 0x00};
+    nn_writer_t writer = {.file = &file, .ok = true};
+    for (size_t i = 0; i < sizeof(header); i++) nn_writer_put(&writer, header[i]);
+    for (size_t i = 0; i < STAGE2_NN_SECTION_COUNT; i++) {
+        uint16_t size = stage2_nn_sections[i].size;
+        uint8_t coding = 0;
+        uint32_t coded = nn_section_coded_size(weights, size, &coding);
+        nn_writer_put(&writer, coding);
+        for (int k = 0; k < 4; k++) nn_writer_put(&writer, (uint8_t)(coded >> (8 * k)));
+        if (coding == NN_CODING_RLE) {
+            nn_rle_encode(&writer, weights, size);
+        } else {
+            for (uint16_t k = 0; k < size; k++) nn_writer_put(&writer, weights[k]);
+        }
+        weights += size;
     }
+    nn_writer_flush(&writer);
+    bool ok = f_close(&file) == FR_OK && writer.ok;
+    if (!ok) f_unlink(path);
+    return ok;
+}
 
-    res = f_write(&file, buffer, NN_TOTAL_SIZE, &bw);
-    f_close(&file);
-    if (res != FR_OK || bw != NN_TOTAL_SIZE) goto cleanup;
+static uint16_t crc16_ccitt(const uint8_t *data, size_t len, uint16_t crc) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
 
-    if (show_progress) menu_render_save_ann_progress(version, "Saved", 100);
-    stage2_write_reg16(addr, STAGE2_REG_CONTROL, 0x0000);
+// Reads the beam's CRC of len bytes of a page from page_addr (STAGE2_CAP_BROADCAST).
+static bool stage2_page_crc(uint8_t addr, uint8_t page_mode, uint16_t page_addr, uint16_t len, uint16_t *crc_out) {
+    uint8_t crc[2] = {0};
+    stage2_batch_t batch;
+    stage2_batch_begin(&batch);
+    if (stage2_has_cap(addr, STAGE2_CAP_REG_BLOCK)) {
+        i2c_async_desc_t *desc = stage2_batch_next(&batch, addr);
+        stage2_page_header(desc, page_mode, page_addr, len);
+        stage2_batch_submit(&batch, desc);
+    } else {
+        stage2_batch_reg(&batch, addr, STAGE2_REG_PAGE_MODE, page_mode, 1);
+        stage2_batch_reg(&batch, addr, STAGE2_REG_PAGE_ADDR, page_addr, 2);
+        stage2_batch_reg(&batch, addr, STAGE2_REG_PAGE_LEN, len, 2);
+    }
+    stage2_batch_read(&batch, addr, STAGE2_REG_PAGE_CRC, crc, 2);
+    if (!stage2_batch_finish(&batch)) return false;
+    *crc_out = (uint16_t)(crc[0] | (crc[1] << 8));
     return true;
+}
 
-cleanup:
-    stage2_write_reg16(addr, STAGE2_REG_CONTROL, 0x0000);
+// ==============================
+// Delta weight uploads
+// ==============================
+// FNV-1a of each 128-byte page of one section; hash gets STAGE2_NN_PAGES(size) entries.
+static void stage2_nn_hash_pages(const uint8_t *data, uint16_t size, uint32_t *hash) {
+    for (uint16_t offset = 0; offset < size; offset += STAGE2_NN_PAGE_SIZE) {
+        uint16_t end = (uint16_t)(size - offset > STAGE2_NN_PAGE_SIZE ? offset + STAGE2_NN_PAGE_SIZE : size);
+        uint32_t h = 2166136261u;
+        for (uint16_t i = offset; i < end; i++) {
+            h ^= data[i];
+            h *= 16777619u;
+        }
+        *hash++ = h;
+    }
+}
+
+// True when any beam of beam_mask may hold something else than the new page (no manifest, or a
+// different hash).
+static bool stage2_nn_page_stale(uint8_t beam_mask, uint16_t page, uint32_t hash) {
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if (!(beam_mask & (1u << i))) continue;
+        if (!stage2_nn_manifests[i].valid || stage2_nn_manifests[i].page_hash[page] != hash) return true;
+    }
     return false;
 }
 
-static bool stage2_load_nn_from_sd(uint8_t addr, const char *path) {
-    if (!sd_ready) return false;
+// Queues the pages of one section that are stale on any beam of beam_mask, sending each run of
+// consecutive stale pages as one page transfer to addr (a beam or STAGE2_GROUP_ADDR). hash holds
+// the new hashes of all pages, first_page is the section's first index into it. Returns the number
+// of pages queued.
+static uint16_t stage2_nn_batch_stale(stage2_batch_t *batch,
+                                      uint8_t addr,
+                                      uint8_t beam_mask,
+                                      size_t section,
+                                      const uint8_t *data,
+                                      const uint32_t *hash,
+                                      uint16_t first_page) {
+    uint16_t size = stage2_nn_sections[section].size;
+    uint16_t pages = STAGE2_NN_PAGES(size);
+    uint16_t queued = 0;
+    uint16_t page = 0;
+    while (page < pages) {
+        if (!stage2_nn_page_stale(beam_mask, (uint16_t)(first_page + page), hash[first_page + page])) {
+            page++;
+            continue;
+        }
+        uint16_t run = page;
+        while (page < pages && stage2_nn_page_stale(beam_mask, (uint16_t)(first_page + page), hash[first_page + page])) {
+            page++;
+        }
+        uint16_t start = (uint16_t)(run * STAGE2_NN_PAGE_SIZE);
+        uint16_t end = (uint16_t)(page * STAGE2_NN_PAGE_SIZE < size ? page * STAGE2_NN_PAGE_SIZE : size);
+        stage2_batch_page(batch, addr, stage2_nn_sections[section].page_mode, start, (uint16_t)(end - start), data + start, NULL);
+        queued = (uint16_t)(queued + page - run);
+    }
+    stage2_nn_upload_stats.pages_sent += queued;
+    stage2_nn_upload_stats.pages_skipped += (uint32_t)(pages - queued);
+    return queued;
+}
+
+// Checks each section of the beam with one CRC read (STAGE2_CAP_BROADCAST). In a section that
+// does not match, every 128-byte page gets a CRC read of its own and only the pages that differ are
+// written again, on the beam's own address.
+static bool stage2_nn_verify_beam(uint8_t addr, const uint8_t *weights) {
+    const uint8_t *ptr = weights;
+    for (size_t k = 0; k < STAGE2_NN_SECTION_COUNT; k++) {
+        uint8_t page_mode = stage2_nn_sections[k].page_mode;
+        uint16_t size = stage2_nn_sections[k].size;
+        uint16_t crc = 0;
+        if (stage2_page_crc(addr, page_mode, 0, size, &crc) && crc == crc16_ccitt(ptr, size, 0xFFFF)) {
+            ptr += size;
+            continue;
+        }
+        for (uint16_t offset = 0; offset < size; offset += STAGE2_NN_PAGE_SIZE) {
+            uint16_t len = (uint16_t)(size - offset);
+            if (len > STAGE2_NN_PAGE_SIZE) len = STAGE2_NN_PAGE_SIZE;
+            uint16_t expected = crc16_ccitt(ptr + offset, len, 0xFFFF);
+            if (stage2_page_crc(addr, page_mode, offset, len, &crc) && crc == expected) continue;
+            stage2_page_write(addr, page_mode, offset, len, ptr + offset);
+            if (!stage2_page_crc(addr, page_mode, offset, len, &crc) || crc != expected) return false;
+            stage2_nn_upload_stats.page_retries++;
+        }
+        ptr += size;
+    }
+    return true;
+}
 
-    FIL file;
-    FRESULT res = f_open(&file, path, FA_READ | FA_OPEN_EXISTING);
-    if (res != FR_OK) return false;
+// Records what beam_mask now holds: the pages in hash, or nothing known when hash is NULL.
+static void stage2_nn_manifest_store(uint8_t beam_mask, const uint32_t *hash) {
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if (!(beam_mask & (1u << i))) continue;
+        stage2_nn_manifests[i].valid = hash != NULL;
+        if (hash) memcpy(stage2_nn_manifests[i].page_hash, hash, sizeof(stage2_nn_manifests[i].page_hash));
+    }
+}
 
-    uint8_t header[16];
-    UINT br = 0;
-    res = f_read(&file, header, sizeof(header), &br);
-    if (res != FR_OK || br != sizeof(header)) {
-        f_close(&file);
-        return false;
+// The weights just read from a beam become its manifest.
+static void stage2_nn_manifest_read_back(uint8_t addr, const uint8_t *weights) {
+    stage2_nn_manifest_t *manifest = &stage2_nn_manifests[addr - STAGE2_BASE_ADDR];
+    uint16_t page = 0;
+    for (size_t i = 0; i < STAGE2_NN_SECTION_COUNT; i++) {
+        stage2_nn_hash_pages(weights, stage2_nn_sections[i].size, manifest->page_hash + page);
+        weights += stage2_nn_sections[i].size;
+        page = (uint16_t)(page + STAGE2_NN_PAGES(stage2_nn_sections[i].size));
     }
-    if (memcmp(header, "NNDT", 4) != 0) {
-        f_close(&file);
+    manifest->valid = true;
+}
+
+static bool stage2_load_nn_from_sd(uint8_t addr, const char *path) {
+    stage2_nn_reader_t *reader = &stage2_nn_work.reader;
+    if (!stage2_nn_open(reader, path)) return false;
+
+    if (!stage2_write_reg16(addr, STAGE2_REG_CONTROL, STAGE2_CTRL_FREEZE_PAUSE)) {
+        stage2_nn_close(reader);
         return false;
     }
+    sleep_ms(5);
 
-    uint16_t in_n = (uint16_t)(header[8] | (header[9] << 8));
-    uint16_t hid_n = (uint16_t)(header[10] | (header[11] << 8));
-    uint16_t out_n = (uint16_t)(header[12] | (header[13] << 8));
-    if (in_n != INPUT_NEURONS || hid_n != HIDDEN_NEURONS || out_n != OUTPUT_NEURONS) {
-        f_close(&file);
-        return false;
+    // Each section is queued as soon as it is read, so the SD read of the next one overlaps the
+    // upload of this one. Pages the beam already holds are left out.
+    uint8_t beam_bit = (uint8_t)(1u << (addr - STAGE2_BASE_ADDR));
+    uint8_t *buffer = stage2_nn_work.weights;
+    uint32_t *hash = stage2_nn_work.hash;
+    uint8_t *ptr = buffer;
+    uint16_t page = 0;
+    uint16_t sent = 0;
+    stage2_batch_t batch;
+    stage2_batch_begin(&batch);
+    bool ok = true;
+    for (size_t i = 0; i < STAGE2_NN_SECTION_COUNT && ok; i++) {
+        ok = stage2_nn_read_section(reader, i, ptr);
+        if (ok) {
+            stage2_nn_hash_pages(ptr, stage2_nn_sections[i].size, hash + page);
+            sent = (uint16_t)(sent + stage2_nn_batch_stale(&batch, addr, beam_bit, i, ptr, hash, page));
+        }
+        ptr += stage2_nn_sections[i].size;
+        page = (uint16_t)(page + STAGE2_NN_PAGES(stage2_nn_sections[i].size));
     }
+    ok = stage2_batch_finish(&batch) && ok;
+    stage2_nn_close(reader);
 
-    uint8_t buffer[NN_TOTAL_SIZE];
-    res = f_read(&file, buffer, NN_TOTAL_SIZE, &br);
-    f_close(&file);
-    if (res != FR_OK || br != NN_TOTAL_SIZE) return false;
+    // A beam that was reset since its manifest was made is caught here when it has page CRCs
+    bool delta = ok && sent < STAGE2_NN_PAGE_COUNT;
+    if (delta && stage2_has_cap(addr, STAGE2_CAP_BROADCAST)) ok = stage2_nn_verify_beam(addr, buffer);
+    if (delta && ok) stage2_nn_upload_stats.delta_beams++;
+    stage2_nn_manifest_store(beam_bit, ok ? hash : NULL);
 
-    if (!stage2_write_reg16(addr, STAGE2_REG_CONTROL, STAGE2_CTRL_FREEZE_PAUSE)) return false;
+    stage2_write_reg16(addr, STAGE2_REG_CONTROL, 0x0000);
+    return ok;
+}
+
+// Writes the pages of an ANN file that any beam of group_mask lacks once to STAGE2_GROUP_ADDR, then
+// checks every beam with stage2_nn_verify_beam(), which resends a page that did not arrive to that
+// beam alone. Returns the mask of beams whose pages all match.
+static uint8_t stage2_nn_group_upload(const char *path, uint8_t group_mask) {
+    uint8_t loaded = 0;
+    stage2_nn_reader_t *reader = &stage2_nn_work.reader;
+    if (!stage2_nn_open(reader, path)) return 0;
+
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if (!(group_mask & (1u << i))) continue;
+        if (!stage2_write_reg16((uint8_t)(STAGE2_BASE_ADDR + i), STAGE2_REG_CONTROL, STAGE2_CTRL_FREEZE_PAUSE)) {
+            group_mask &= (uint8_t)~(1u << i);
+        }
+    }
     sleep_ms(5);
 
-    const uint8_t *ptr = buffer;
-    bool ok = stage2_page_write(addr, STAGE2_PAGE_W1, 0, W1_SIZE, ptr);
-    ptr += W1_SIZE;
-    ok = ok && stage2_page_write(addr, STAGE2_PAGE_B1, 0, B1_SIZE, ptr);
-    ptr += B1_SIZE;
-    ok = ok && stage2_page_write(addr, STAGE2_PAGE_W2, 0, W2_SIZE, ptr);
-    ptr += W2_SIZE;
-    ok = ok && stage2_page_write(addr, STAGE2_PAGE_B2, 0, B2_SIZE, ptr);
+    uint8_t *buffer = stage2_nn_work.weights;
+    uint32_t *hash = stage2_nn_work.hash;
+    uint8_t *ptr = buffer;
+    uint16_t page = 0;
+    uint16_t sent = 0;
+    stage2_batch_t batch;
+    stage2_batch_begin(&batch);
+    bool read_ok = true;
+    for (size_t i = 0; i < STAGE2_NN_SECTION_COUNT && read_ok; i++) {
+        read_ok = stage2_nn_read_section(reader, i, ptr);
+        if (read_ok) {
+            stage2_nn_hash_pages(ptr, stage2_nn_sections[i].size, hash + page);
+            sent = (uint16_t)(sent + stage2_nn_batch_stale(&batch, STAGE2_GROUP_ADDR, group_mask, i, ptr, hash, page));
+        }
+        ptr += stage2_nn_sections[i].size;
+        page = (uint16_t)(page + STAGE2_NN_PAGES(stage2_nn_sections[i].size));
+    }
+    // A NACK only means no beam answered; the CRC reads below tell which copies arrived
+    stage2_batch_finish(&batch);
+    stage2_nn_close(reader);
 
-    stage2_write_reg16(addr, STAGE2_REG_CONTROL, 0x0000);
-    return ok;
+    for (uint8_t i = 0; i < STAGE2_COUNT && read_ok; i++) {
+        if (!(group_mask & (1u << i))) continue;
+        if (stage2_nn_verify_beam((uint8_t)(STAGE2_BASE_ADDR + i), buffer)) loaded |= (uint8_t)(1u << i);
+    }
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if (group_mask & (1u << i)) stage2_write_reg16((uint8_t)(STAGE2_BASE_ADDR + i), STAGE2_REG_CONTROL, 0x0000);
+    }
+    // Every beam with the capability heard the group writes, members or not
+    uint8_t heard = 0;
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if (stage2_has_cap((uint8_t)(STAGE2_BASE_ADDR + i), STAGE2_CAP_BROADCAST)) heard |= (uint8_t)(1u << i);
+    }
+    stage2_nn_manifest_store((uint8_t)(heard & ~loaded), NULL);
+    stage2_nn_manifest_store(loaded, hash);
+    if (sent < STAGE2_NN_PAGE_COUNT) stage2_nn_upload_stats.delta_beams += (uint32_t)__builtin_popcount(loaded);
+    stage2_nn_upload_stats.uploads++;
+    return loaded;
+}
+
+// Loads one ANN file into every beam of beam_mask (bit n = beam n) and returns the mask of beams
+// that took it: beams with STAGE2_CAP_BROADCAST through the group address, the rest (and any that
+// still fail) one at a time.
+static uint8_t stage2_load_nn_broadcast(const char *path, uint8_t beam_mask) {
+    uint8_t group_mask = 0;
+    uint8_t group_count = 0;
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if ((beam_mask & (1u << i)) && stage2_has_cap((uint8_t)(STAGE2_BASE_ADDR + i), STAGE2_CAP_BROADCAST)) {
+            group_mask |= (uint8_t)(1u << i);
+            group_count++;
+        }
+    }
+
+    // With a single capable beam the group write saves nothing
+    uint8_t loaded = group_count >= 2 ? stage2_nn_group_upload(path, group_mask) : 0;
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if (loaded & (1u << i)) stage2_nn_upload_stats.group_beams++;
+    }
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if (!(beam_mask & (1u << i)) || (loaded & (1u << i))) continue;
+        if (stage2_load_nn_from_sd((uint8_t)(STAGE2_BASE_ADDR + i), path)) {
+            loaded |= (uint8_t)(1u << i);
+            stage2_nn_upload_stats.unicast_beams++;
+        }
+    }
+    return loaded;
 }
 
 // ==============================
 // I2C helpers
 // ==============================
-static bool stage2_read_fifo_len(uint8_t addr, uint16_t *len_out) {
-    uint8_t reg = STAGE2_REG_FIFO_LEN;
-    uint8_t buf[2] = {0};
-    int w = i2c_write_blocking(I2C_STAGE2_PORT, addr, &reg, 1, true);
-    if (w != 1) return false;
-    int r = i2c_read_blocking(I2C_STAGE2_PORT, addr, buf, 2, false);
-    if (r != 2) return false;
-    *len_out = (uint16_t)(buf[0] | (buf[1] << 8));
-    return true;
-}
-
-static bool stage2_read_fifo_entry(uint8_t addr, stage2_entry_t *entry) {
-    uint8_t reg = STAGE2_REG_FIFO_READ;
-    uint8_t buf[5] = {0};
-    int w = i2c_write_blocking(I2C_STAGE2_PORT, addr, &reg, 1, true);
-    if (w != 1) return false;
-    int r = i2c_read_blocking(I2C_STAGE2_PORT, addr, buf, 5, false);
-    if (r != 5) return false;
+static void stage2_unpack_entry(const uint8_t *buf, stage2_entry_t *entry) {
     entry->max_id = buf[0];
     entry->max_val = buf[1];
     entry->female_val = buf[2];
     entry->male_val = buf[3];
     entry->user_id = buf[4];
+}
+
+static void stage2_ready_push_from_loop(uint8_t beam_idx);
+static void stage2_drain_step(i2c_async_desc_t *desc);
+
+// Room left for new reads: free slots minus those reserved by reads still on the bus.
+static uint32_t stage2_entry_ring_free(void) {
+    uint32_t free_slots = STAGE2_ENTRY_RING_SIZE - (stage2_entry_head - stage2_entry_tail);
+    return free_slots > stage2_entry_reserved ? free_slots - stage2_entry_reserved : 0;
+}
+
+// Core 1 side; the caller has checked stage2_entry_ring_free().
+static void stage2_entry_push(uint8_t beam_idx, const uint8_t *buf) {
+    uint32_t head = stage2_entry_head;
+    stage2_entry_record_t *record = &stage2_entry_ring[head & (STAGE2_ENTRY_RING_SIZE - 1)];
+    record->time_us = time_us_32();
+    record->beam = beam_idx;
+    stage2_unpack_entry(buf, &record->entry);
+    __mem_fence_release();
+    stage2_entry_head = head + 1;
+
+    uint32_t used = head + 1 - stage2_entry_tail;
+    stage2_entry_stats.pushed++;
+    if (used > stage2_entry_stats.high_water) stage2_entry_stats.high_water = used;
+}
+
+// A failed beam is not queued again here: the sweep picks it up once its backoff allows.
+static void stage2_drain_finish(uint8_t beam_idx, bool ok) {
+    stage2_drain[beam_idx].step = STAGE2_DRAIN_IDLE;
+    gpio_put(stage2_fault_pins[beam_idx], ok ? 0 : 1);
+    if (ok && !gpio_get(word_ready_pins[beam_idx])) stage2_ready_push_from_loop(beam_idx);
+}
+
+static void stage2_drain_submit(uint8_t beam_idx, stage2_drain_step_t step, uint8_t reg, uint16_t rx_len) {
+    stage2_drain_t *drain = &stage2_drain[beam_idx];
+    drain->step = step;
+    bool reads_entries = step == STAGE2_DRAIN_BURST || step == STAGE2_DRAIN_ENTRY;
+    if (reads_entries) stage2_entry_reserved += drain->count;
+    drain->desc = (i2c_async_desc_t){
+        .addr = (uint8_t)(STAGE2_BASE_ADDR + beam_idx),
+        .bus_class = I2C_CLASS_REALTIME,
+        .header = {reg},
+        .header_len = 1,
+        .rx = drain->buf,
+        .rx_len = rx_len,
+        .done = stage2_drain_step,
+        .ctx = drain,
+    };
+    stage2_fifo[beam_idx].transactions++;
+    if (!i2c_async_submit(&drain->desc)) {
+        if (reads_entries) stage2_entry_reserved -= drain->count;
+        stage2_drain_finish(beam_idx, false);
+    }
+}
+
+// Next read of a drain: a burst of up to STAGE2_FIFO_BURST_MAX entries from the auto-advancing
+// FIFO register, or a single entry. Entries that do not fit the ring stay in the Stage 2 FIFO;
+// the beam is queued again because its pin is still low.
+static void stage2_drain_next(uint8_t beam_idx) {
+    stage2_drain_t *drain = &stage2_drain[beam_idx];
+    if (drain->remaining == 0) {
+        stage2_drain_finish(beam_idx, true);
+        return;
+    }
+    uint32_t room = stage2_entry_ring_free();
+    if (room == 0) {
+        stage2_entry_stats.full_stalls++;
+        stage2_drain_finish(beam_idx, true);
+        return;
+    }
+    if (stage2_fifo[beam_idx].mode == STAGE2_FIFO_BURST) {
+        uint16_t limit = room < STAGE2_FIFO_BURST_MAX ? (uint16_t)room : STAGE2_FIFO_BURST_MAX;
+        drain->count = drain->remaining > limit ? limit : drain->remaining;
+        stage2_drain_submit(beam_idx, STAGE2_DRAIN_BURST, STAGE2_REG_FIFO_READ,
+                            (uint16_t)(drain->count * STAGE2_ENTRY_SIZE));
+    } else {
+        drain->count = 1;
+        stage2_drain_submit(beam_idx, STAGE2_DRAIN_ENTRY, STAGE2_REG_FIFO_READ, STAGE2_ENTRY_SIZE);
+    }
+}
+
+// Completion callback of every drain read (core 1); entries go to the ring in FIFO order while
+// the other beams' reads are on the bus.
+static void stage2_drain_step(i2c_async_desc_t *desc) {
+    stage2_drain_t *drain = (stage2_drain_t *)desc->ctx;
+    uint8_t beam_idx = (uint8_t)(drain - stage2_drain);
+    stage2_fifo_stats_t *stats = &stage2_fifo[beam_idx];
+    bool ok = desc->state == I2C_ASYNC_DONE;
+
+    switch (drain->step) {
+        case STAGE2_DRAIN_LEN:
+            if (!ok) break;
+            drain->remaining = (uint16_t)(drain->buf[0] | (drain->buf[1] << 8));
+            if (drain->remaining == 0) {
+                stage2_drain_finish(beam_idx, true);
+                return;
+            }
+            stats->drains++;
+            if (stats->mode == STAGE2_FIFO_UNPROBED) {
+                // Asked once per device (and again after a failed burst); a device that does not
+                // answer keeps the per-entry path, which works with every Stage 2 firmware.
+                stage2_drain_submit(beam_idx, STAGE2_DRAIN_CAPS, STAGE2_REG_CAPS, 1);
+                return;
+            }
+            stage2_drain_next(beam_idx);
+            return;
+        case STAGE2_DRAIN_CAPS: {
+            uint8_t caps = drain->buf[0];
+            stage2_caps[beam_idx] = (ok && caps != 0xFF) ? caps : 0;
+            stage2_caps_known[beam_idx] = true;
+            bool burst = (stage2_caps[beam_idx] & STAGE2_CAP_FIFO_BURST) != 0;
+            stats->mode = burst ? STAGE2_FIFO_BURST : STAGE2_FIFO_SINGLE;
+            printf("INFO: Stage 2 beam %u FIFO drain: %s\n", beam_idx, burst ? "burst" : "per entry");
+            stage2_drain_next(beam_idx);
+            return;
+        }
+        case STAGE2_DRAIN_BURST:
+        case STAGE2_DRAIN_ENTRY:
+            stage2_entry_reserved -= drain->count;
+            if (!ok) {
+                if (drain->step == STAGE2_DRAIN_BURST) {
+                    // How many entries left the FIFO is unknown; probe again before the next burst.
+                    stats->burst_failures++;
+                    stats->mode = STAGE2_FIFO_UNPROBED;
+                }
+                break;
+            }
+            for (uint16_t n = 0; n < drain->count; n++) {
+                stage2_entry_push(beam_idx, &drain->buf[n * STAGE2_ENTRY_SIZE]);
+            }
+            stats->entries += drain->count;
+            drain->remaining = (uint16_t)(drain->remaining - drain->count);
+            stage2_drain_next(beam_idx);
+            return;
+        default:
+            break;
+    }
+    stage2_drain_finish(beam_idx, false);
+}
+
+// Starts reading every pending entry of one beam. Returns false if a drain of that beam is still
+// running; it re-queues the beam itself if the pin is still low when it ends.
+static bool stage2_drain_start(uint8_t beam_idx) {
+    if (stage2_drain[beam_idx].step != STAGE2_DRAIN_IDLE) return false;
+    stage2_drain_submit(beam_idx, STAGE2_DRAIN_LEN, STAGE2_REG_FIFO_LEN, 2);
+    return true;
+}
+
+// ==============================
+// Word-ready events
+// ==============================
+// Producer side: called from the GPIO interrupt, or from the acquisition loop with interrupts
+// disabled.
+static void stage2_ready_push(uint8_t beam_idx, uint32_t edge_us) {
+    if (stage2_ready_queued[beam_idx]) return;
+
+    uint32_t head = stage2_ready_head;
+    if (head - stage2_ready_tail >= STAGE2_READY_QUEUE_SIZE) {
+        stage2_ready_overflows++;
+        return;
+    }
+    stage2_ready_queue[head & (STAGE2_READY_QUEUE_SIZE - 1)].beam = beam_idx;
+    stage2_ready_queue[head & (STAGE2_READY_QUEUE_SIZE - 1)].edge_us = edge_us;
+    stage2_ready_queued[beam_idx] = true;
+    __mem_fence_release();
+    stage2_ready_head = head + 1;
+}
+
+static bool stage2_ready_pop(stage2_ready_event_t *event) {
+    uint32_t tail = stage2_ready_tail;
+    if (tail == stage2_ready_head) return false;
+    __mem_fence_acquire();
+    *event = stage2_ready_queue[tail & (STAGE2_READY_QUEUE_SIZE - 1)];
+    __mem_fence_release();
+    stage2_ready_tail = tail + 1;
     return true;
 }
 
+static void stage2_ready_push_from_loop(uint8_t beam_idx) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    stage2_ready_push(beam_idx, time_us_32());
+    restore_interrupts(irq_state);
+}
+
+static void stage2_ready_irq(uint gpio, uint32_t events) {
+    if (!(events & GPIO_IRQ_EDGE_FALL)) return;
+    uint32_t now = time_us_32();
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if (word_ready_pins[i] == gpio) {
+            stage2_ready_push(i, now);
+            return;
+        }
+    }
+}
+
+// Catches a pin that went low while its beam was being drained (no new edge) or before the
+// interrupt was enabled.
+static void stage2_ready_sweep(void) {
+    static absolute_time_t last_sweep = {0};
+    if (absolute_time_diff_us(last_sweep, get_absolute_time()) < STAGE2_READY_SWEEP_MS * 1000) return;
+    last_sweep = get_absolute_time();
+
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        if (!stage2_ready_queued[i] && !gpio_get(word_ready_pins[i])) {
+            stage2_fifo[i].swept++;
+            stage2_ready_push_from_loop(i);
+        }
+    }
+}
+
+// Starts drains for the beams that were ready when the call started, in the order their pins
+// went low (core 1). Events wait in the queue while the entry ring is short of a burst of room.
+static void stage2_service_ready(void) {
+    stage2_ready_sweep();
+
+    stage2_ready_event_t event;
+    for (uint8_t n = 0; n < STAGE2_COUNT; n++) {
+        if (stage2_ready_tail != stage2_ready_head && stage2_entry_ring_free() < STAGE2_FIFO_BURST_MAX) {
+            stage2_entry_stats.full_stalls++;
+            break;
+        }
+        if (!stage2_ready_pop(&event)) break;
+        uint8_t i = event.beam;
+        stage2_fifo_stats_t *stats = &stage2_fifo[i];
+        // Cleared first, so an edge during the drain queues the beam again
+        stage2_ready_queued[i] = false;
+        // A beam in backoff waits for a later sweep instead of holding up the others
+        uint8_t addr = (uint8_t)(STAGE2_BASE_ADDR + i);
+        if (i2c_device_backing_off(addr)) {
+            i2c_device(addr)->skipped++;
+            continue;
+        }
+
+        uint32_t latency = time_us_32() - event.edge_us;
+        stats->ready_events++;
+        stats->latency_sum_us += latency;
+        if (latency > stats->latency_max_us) stats->latency_max_us = latency;
+
+        stage2_drain_start(i);
+    }
+}
+
+// Core 0 side: hands the entries core 1 has read so far to handle_stage2_entry().
+static void stage2_consume_entries(void) {
+    uint32_t head = stage2_entry_head;
+    __mem_fence_acquire();
+    while (stage2_entry_tail != head) {
+        stage2_entry_record_t record = stage2_entry_ring[stage2_entry_tail & (STAGE2_ENTRY_RING_SIZE - 1)];
+        __mem_fence_release();
+        stage2_entry_tail = stage2_entry_tail + 1;
+
+        uint32_t age = time_us_32() - record.time_us;
+        if (age > stage2_entry_stats.max_age_us) stage2_entry_stats.max_age_us = age;
+        handle_stage2_entry(record.beam, &record.entry);
+    }
+}
+
+static void stage2_report_stats(void) {
+    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
+        const stage2_fifo_stats_t *stats = &stage2_fifo[i];
+        uint32_t entries = stats->entries ? stats->entries : 1;
+        uint32_t events = stats->ready_events ? stats->ready_events : 1;
+        char line[224];
+        snprintf(line,
+                 sizeof(line),
+                 "BUSSTATS beam=%u fifo=%s drains=%lu entries=%lu transactions/entry=%lu.%02lu burst_failures=%lu "
+                 "ready=%lu swept=%lu latency_avg_us=%lu latency_max_us=%lu",
+                 i,
+                 stats->mode == STAGE2_FIFO_BURST ? "burst" : (stats->mode == STAGE2_FIFO_SINGLE ? "single" : "unprobed"),
+                 (unsigned long)stats->drains,
+                 (unsigned long)stats->entries,
+                 (unsigned long)(stats->transactions / entries),
+                 (unsigned long)((stats->transactions * 100u / entries) % 100u),
+                 (unsigned long)stats->burst_failures,
+                 (unsigned long)stats->ready_events,
+                 (unsigned long)stats->swept,
+                 (unsigned long)(stats->latency_sum_us / events),
+                 (unsigned long)stats->latency_max_us);
+        output_send_line(line);
+    }
+    char line[224];
+    snprintf(line,
+             sizeof(line),
+             "BUSSTATS ring used=%lu/%u high_water=%lu pushed=%lu full_stalls=%lu max_age_us=%lu",
+             (unsigned long)(stage2_entry_head - stage2_entry_tail),
+             STAGE2_ENTRY_RING_SIZE,
+             (unsigned long)stage2_entry_stats.high_water,
+             (unsigned long)stage2_entry_stats.pushed,
+             (unsigned long)stage2_entry_stats.full_stalls,
+             (unsigned long)stage2_entry_stats.max_age_us);
+    output_send_line(line);
+    snprintf(line,
+             sizeof(line),
+             "BUSSTATS i2c engine=%s failures=%lu timeouts=%lu recoveries=%lu",
+             i2c_async_stats.dma ? "dma" : "blocking",
+             (unsigned long)i2c_async_stats.failures,
+             (unsigned long)i2c_async_stats.timeouts,
+             (unsigned long)i2c_async_stats.recoveries);
+    output_send_line(line);
+    for (uint8_t i = 0; i < I2C_DEVICE_COUNT; i++) {
+        const i2c_device_t *dev = &i2c_devices[i];
+        snprintf(line,
+                 sizeof(line),
+                 "BUSSTATS i2c dev=0x%02X khz=%lu probed=%u transfers=%lu errors=%lu downgrades=%lu "
+                 "health=%s backoff_ms=%lu skipped=%lu",
+                 STAGE2_BASE_ADDR + i,
+                 (unsigned long)(i2c_speed_tiers[dev->tier] / 1000u),
+                 dev->probed ? 1u : 0u,
+                 (unsigned long)dev->transfers,
+                 (unsigned long)dev->errors,
+                 (unsigned long)dev->downgrades,
+                 dev->backoff_ms ? "backoff" : (dev->fail_run ? "failing" : "ok"),
+                 (unsigned long)dev->backoff_ms,
+                 (unsigned long)dev->skipped);
+        output_send_line(line);
+    }
+    // Share of the time since boot each class held the bus, in 0.1 %
+    uint64_t uptime_us = time_us_64();
+    if (uptime_us == 0) uptime_us = 1;
+    for (int c = 0; c < I2C_CLASS_COUNT; c++) {
+        const i2c_class_stats_t *stats = &i2c_async_stats.cls[c];
+        uint32_t permille = (uint32_t)(stats->busy_us * 1000u / uptime_us);
+        snprintf(line,
+                 sizeof(line),
+                 "BUSSTATS i2c class=%s transactions=%lu bytes=%lu busy=%lu.%lu%% queue_max=%lu slices=%lu",
+                 i2c_class_names[c],
+                 (unsigned long)stats->transactions,
+                 (unsigned long)stats->bytes,
+                 (unsigned long)(permille / 10u),
+                 (unsigned long)(permille % 10u),
+                 (unsigned long)stats->queue_max,
+                 (unsigned long)stats->slices);
+        output_send_line(line);
+    }
+    if (stage2_ready_overflows) {
+        snprintf(line, sizeof(line), "BUSSTATS ready_queue_overflows=%lu", (unsigned long)stage2_ready_overflows);
+        output_send_line(line);
+    }
+    snprintf(line,
+             sizeof(line),
+             "BUSSTATS ann_upload group_uploads=%lu group_beams=%lu page_retries=%lu unicast_beams=%lu "
+             "delta_beams=%lu pages_sent=%lu pages_skipped=%lu",
+             (unsigned long)stage2_nn_upload_stats.uploads,
+             (unsigned long)stage2_nn_upload_stats.group_beams,
+             (unsigned long)stage2_nn_upload_stats.page_retries,
+             (unsigned long)stage2_nn_upload_stats.unicast_beams,
+             (unsigned long)stage2_nn_upload_stats.delta_beams,
+             (unsigned long)stage2_nn_upload_stats.pages_sent,
+             (unsigned long)stage2_nn_upload_stats.pages_skipped);
+    output_send_line(line);
+}
+
 // ==============================
 // Placeholder dictionary + translation
 // ==============================
-static void handle_stage2_entry(uint8_t beam_idx, const stage2_entry_t *entry) {
-    beam_seq_t *seq = &beam_sequences[beam_idx];
+static void beam_seq_reset(beam_seq_t *seq) {
+    seq->count = 0;
+    seq->trie_node = DICT_TRIE_ROOT;
+    seq->overflow = false;
+    seq->emitted = false;
+    dict_phrase_reset(&seq->phrase);
+}
 
+static void beam_emit_word(uint8_t beam_idx, const stage2_entry_t *entry, const char *word, const char *tag) {
     char user_name[32];
     user_lookup_name(entry->user_id, user_name, sizeof(user_name));
 
-    // Append phoneme id to sequence (shift if full)
-    if (seq->count < PHONEME_SEQ_LEN) {
-        seq->seq[seq->count++] = entry->max_id;
-    } else {
-        memmove(&seq->seq[0], &seq->seq[1], PHONEME_SEQ_LEN - 1);
-        seq->seq[PHONEME_SEQ_LEN - 1] = entry->max_id;
+    const char *gender = (entry->female_val >= entry->male_val) ? "female" : "male";
+    uint8_t conf = (entry->female_val >= entry->male_val) ? entry->female_val : entry->male_val;
+    char line[160];
+    snprintf(line, sizeof(line), "beam=%u user_id=%u user=%s word=%s gender=%s conf=%u%s%s",
+             beam_idx, entry->user_id, user_name, word, gender, conf, tag ? " " : "", tag ? tag : "");
+    output_send_line(line);
+    if (beam_idx == TRAIN_BEAM_INDEX) {
+        word_history_push(word);
+    }
+}
+
+static void beam_emit_phrase(uint8_t beam_idx, const stage2_entry_t *entry, uint32_t match) {
+    char text[DICT_PHRASE_TEXT_MAX + 1];
+    bool phrase = false;
+    if (dict_phrase_text(match, text, sizeof(text), &phrase)) {
+        beam_emit_word(beam_idx, entry, text, phrase ? "[PHRASE]" : NULL);
     }
+}
+
+// Phonemes are collected per beam until silence. With Phrases.ac present every phoneme also goes
+// through the phrase automaton, which emits each word or phrase as soon as it is final, including
+// words spoken back to back; the silence lookup below then only runs when those matches do not
+// cover the whole segment.
+// Without it, while the prefix is still inside Dictionary.trie the beam's cursor follows it, and as
+// soon as only one dictionary word can complete the prefix that word is emitted; the remaining
+// phonemes of the word are then ignored up to the silence.
+static void handle_stage2_entry(uint8_t beam_idx, const stage2_entry_t *entry) {
+    beam_seq_t *seq = &beam_sequences[beam_idx];
 
     bool silence = (entry->max_id == SIL_WORD_ID) || (entry->max_id == SIL_SENTENCE_ID);
-    if (!silence || seq->count < PHONEME_SEQ_LEN) {
+    if (!silence) {
+        if (seq->emitted) return;
+
+        // Append phoneme id to sequence; a word longer than any dictionary key is dropped at the silence
+        if (seq->count < PHONEME_SEQ_MAX) {
+            seq->seq[seq->count++] = entry->max_id;
+        } else {
+            seq->overflow = true;
+            seq->trie_node = DICT_TRIE_NONE;
+        }
+
+        if (dict_phrase_ready) {
+            // Words added at run time are not in Phrases.ac: while one can still follow from the
+            // segment start, matches are left to the silence lookup, as for the trie's early output.
+            bool may_emit = seq->overflow || !dict_memtable_has_prefix(seq->seq, seq->count);
+            uint32_t match = dict_phrase_feed(&seq->phrase, entry->max_id, dict_target_language(), may_emit);
+            if (match != 0) beam_emit_phrase(beam_idx, entry, match);
+            return;
+        }
+        if (!dict_trie_ready || seq->trie_node == DICT_TRIE_NONE) return;
+        seq->trie_node = dict_trie_step(seq->trie_node, entry->max_id);
+        if (seq->count < DICT_TRIE_EARLY_MIN_PHONEMES) return;
+
+        uint8_t completion[PHONEME_SEQ_MAX];
+        char word[DICT_WORD_SIZE + 1];
+        if (dict_trie_unique_completion(seq->trie_node, completion) &&
+            !dict_memtable_has_prefix(seq->seq, seq->count) &&
+            dict_lookup_word(completion, word, sizeof(word))) {
+            beam_emit_word(beam_idx, entry, word, NULL);
+            seq->emitted = true;
+        }
         return;
     }
 
-    char word[DICT_WORD_SIZE + 1];
-    if (dict_lookup_word(seq->seq, word, sizeof(word))) {
-        const char *gender = (entry->female_val >= entry->male_val) ? "female" : "male";
-        uint8_t conf = (entry->female_val >= entry->male_val) ? entry->female_val : entry->male_val;
-        char line[160];
-        snprintf(line, sizeof(line), "beam=%u user_id=%u user=%s word=%s gender=%s conf=%u",
-                 beam_idx, entry->user_id, user_name, word, gender, conf);
-        output_send_line(line);
-        if (beam_idx == TRAIN_BEAM_INDEX) {
-            word_history_push(word);
-        }
-        seq->count = 0; // reset after a match
-    } else {
-        // Word not found - add to dictionary with language ID 0 (unknown)
-        if (dict_add_unknown_word(seq->seq)) {
-            // Successfully added - output the new unrecognised word
-            char unrec_word[DICT_WORD_SIZE + 1];
-            snprintf(unrec_word, sizeof(unrec_word), "UnRecognised%02d", unrecognised_counter - 1);
-            const char *gender = (entry->female_val >= entry->male_val) ? "female" : "male";
-            uint8_t conf = (entry->female_val >= entry->male_val) ? entry->female_val : entry->male_val;
-            char line[160];
-            snprintf(line, sizeof(line), "beam=%u user_id=%u user=%s word=%s gender=%s conf=%u [NEW]",
-                     beam_idx, entry->user_id, user_name, unrec_word, gender, conf);
-            output_send_line(line);
-            if (beam_idx == TRAIN_BEAM_INDEX) {
-                word_history_push(unrec_word);
-            }
+    // Dictionary sequences are zero padded after the last phoneme.
+    uint8_t padded[PHONEME_SEQ_MAX] = {0};
+    memcpy(padded, seq->seq, seq->count);
+
+    if (dict_phrase_ready) {
+        // A segment that is itself a word added at run time goes to the lookup below.
+        char mem_word[DICT_WORD_SIZE + 1];
+        bool may_emit = seq->overflow || seq->count == 0 ||
+                        !dict_memtable_find(padded, LANG_UNKNOWN, mem_word, sizeof(mem_word), NULL, NULL);
+        uint32_t match = dict_phrase_flush(&seq->phrase, may_emit);
+        if (match != 0) beam_emit_phrase(beam_idx, entry, match);
+        if (dict_phrase_covered(&seq->phrase)) {
+            beam_seq_reset(seq);
+            return;
         }
-        seq->count = 0; // reset regardless
     }
+
+    if (seq->emitted || seq->overflow || seq->count == 0) {
+        if (seq->overflow) printf("WARNING: Beam %u word exceeds %d phonemes, skipped\n", beam_idx, PHONEME_SEQ_MAX);
+        beam_seq_reset(seq);
+        return;
+    }
+
+    char word[DICT_WORD_SIZE + 1];
+    uint16_t cost = 0;
+    if (dict_lookup_word(padded, word, sizeof(word))) {
+        beam_emit_word(beam_idx, entry, word, NULL);
+    } else if (dict_approx_lookup(padded, seq->count, word, sizeof(word), &cost)) {
+        // Nearest dictionary word within the edit budget, tagged with its distance
+        char tag[24];
+        snprintf(tag, sizeof(tag), "[APPROX d=%u.%u]", (unsigned)(cost / DICT_APPROX_UNIT), (unsigned)(cost % DICT_APPROX_UNIT));
+        beam_emit_word(beam_idx, entry, word, tag);
+    } else if (dict_add_unknown_word(padded)) {
+        // Word not found - added to NewWords.dat with language ID 0 (unknown)
+        char unrec_word[DICT_WORD_SIZE + 1];
+        snprintf(unrec_word, sizeof(unrec_word), "UnRecognised%02d", unrecognised_counter - 1);
+        beam_emit_word(beam_idx, entry, unrec_word, "[NEW]");
+    }
+    beam_seq_reset(seq); // reset regardless
 }
 
 // ==============================
@@ -2623,6 +7502,14 @@ static void init_word_ready_pins(void) {
     }
 }
 
+// Runs on core 1, so the GPIO interrupt is taken there. Word-ready is active low; one shared
+// callback serves all five pins.
+static void init_word_ready_irqs(void) {
+    for (int i = 0; i < STAGE2_COUNT; i++) {
+        gpio_set_irq_enabled_with_callback(word_ready_pins[i], GPIO_IRQ_EDGE_FALL, true, &stage2_ready_irq);
+    }
+}
+
 static void init_fault_pins(void) {
     for (int i = 0; i < STAGE2_COUNT; i++) {
         gpio_init(stage2_fault_pins[i]);
@@ -2632,11 +7519,15 @@ static void init_fault_pins(void) {
 }
 
 static void init_i2c_stage2(void) {
+    for (uint8_t i = 0; i < I2C_DEVICE_COUNT; i++) {
+        i2c_devices[i].tier = I2C_SPEED_DEFAULT_TIER;
+    }
     i2c_init(I2C_STAGE2_PORT, I2C_STAGE2_BAUD);
     gpio_set_function(I2C_STAGE2_SDA, GPIO_FUNC_I2C);
     gpio_set_function(I2C_STAGE2_SCL, GPIO_FUNC_I2C);
     gpio_pull_up(I2C_STAGE2_SDA);
     gpio_pull_up(I2C_STAGE2_SCL);
+    i2c_async_lock = spin_lock_init(spin_lock_claim_unused(true));
 }
 
 static void init_spi_sd(void) {
@@ -2710,6 +7601,24 @@ static void handle_command(const char *line) {
     } else if (strcmp(line, "STOP") == 0) {
         training_stop();
         output_send_line("Training stopped");
+    } else if (strcmp(line, "DICTSTATS") == 0) {
+        dict_report_stats();
+    } else if (strcmp(line, "BUSSTATS") == 0) {
+        stage2_report_stats();
+    } else if (strncmp(line, "APPROX ", 7) == 0) {
+        int edits = atoi(line + 7);
+        if (edits < 0 || edits > 5) {
+            output_send_line("ERROR: APPROX <0-5 edits>");
+        } else {
+            dict_approx_max_cost = (uint16_t)(edits * DICT_APPROX_UNIT);
+            output_send_line(edits ? "Approximate match enabled" : "Approximate match disabled");
+        }
+    } else if (strcmp(line, "XIPSYNC") == 0) {
+        if (dict_xip_sync_start()) {
+            while (dict_xip_sync_step(FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)) {
+            }
+        }
+        output_send_line(dict_xip_ready ? "Flash dictionary synced" : "ERROR: flash dictionary sync failed");
     } else if (strcmp(line, "SAMPLEGEN") == 0) {
         if (generate_sample_words()) {
             output_send_line("SampleWords.txt generated");
@@ -2739,6 +7648,7 @@ static bool stage2_set_target(uint8_t addr, uint8_t neuron) {
 }
 
 static bool stage2_trigger_backprop(uint8_t addr) {
+    stage2_nn_manifests[addr - STAGE2_BASE_ADDR].valid = false;
     return stage2_write_reg16(addr, STAGE2_REG_CONTROL, STAGE2_CTRL_BACKPROP);
 }
 
@@ -2750,49 +7660,27 @@ static bool stage2_read_training_metrics(uint8_t addr,
                                          uint8_t *user_val_out,
                                          uint8_t *female_val_out,
                                          uint8_t *male_val_out) {
-    uint8_t max_id = 0;
-    uint8_t max_val = 0;
-    uint8_t target_val = 0;
-    uint8_t user_id = 0;
-    uint8_t user_val = 0;
-    uint8_t female_val = 0;
-    uint8_t male_val = 0;
-
-    if (!stage2_read_reg8(addr, STAGE2_REG_LAST_MAX_ID, &max_id)) return false;
-    if (!stage2_read_reg8(addr, STAGE2_REG_LAST_MAX_VAL, &max_val)) return false;
-    if (!stage2_read_reg8(addr, STAGE2_REG_LAST_TARGET_VAL, &target_val)) return false;
-    if (!stage2_read_reg8(addr, STAGE2_REG_LAST_USER_ID, &user_id)) return false;
-    if (!stage2_read_reg8(addr, STAGE2_REG_LAST_USER_VAL, &user_val)) return false;
-    if (!stage2_read_reg8(addr, STAGE2_REG_LAST_FEMALE_VAL, &female_val)) return false;
-    if (!stage2_read_reg8(addr, STAGE2_REG_LAST_MALE_VAL, &male_val)) return false;
+    // Registers 0x10-0x16 in order; one read with STAGE2_CAP_REG_BLOCK, seven otherwise
+    uint8_t regs[STAGE2_METRICS_COUNT] = {0};
+    if (stage2_has_cap(addr, STAGE2_CAP_REG_BLOCK)) {
+        uint8_t reg = STAGE2_REG_LAST_MAX_ID;
+        if (!i2c_transfer(addr, I2C_CLASS_TRAINING, &reg, 1, regs, STAGE2_METRICS_COUNT)) return false;
+    } else {
+        for (uint8_t i = 0; i < STAGE2_METRICS_COUNT; i++) {
+            if (!stage2_read_reg8(addr, (uint8_t)(STAGE2_REG_LAST_MAX_ID + i), &regs[i])) return false;
+        }
+    }
 
-    if (max_id_out) *max_id_out = max_id;
-    if (max_val_out) *max_val_out = max_val;
-    if (target_val_out) *target_val_out = target_val;
-    if (user_id_out) *user_id_out = user_id;
-    if (user_val_out) *user_val_out = user_val;
-    if (female_val_out) *female_val_out = female_val;
-    if (male_val_out) *male_val_out = male_val;
+    if (max_id_out) *max_id_out = regs[STAGE2_REG_LAST_MAX_ID - STAGE2_REG_LAST_MAX_ID];
+    if (max_val_out) *max_val_out = regs[STAGE2_REG_LAST_MAX_VAL - STAGE2_REG_LAST_MAX_ID];
+    if (target_val_out) *target_val_out = regs[STAGE2_REG_LAST_TARGET_VAL - STAGE2_REG_LAST_MAX_ID];
+    if (user_id_out) *user_id_out = regs[STAGE2_REG_LAST_USER_ID - STAGE2_REG_LAST_MAX_ID];
+    if (user_val_out) *user_val_out = regs[STAGE2_REG_LAST_USER_VAL - STAGE2_REG_LAST_MAX_ID];
+    if (female_val_out) *female_val_out = regs[STAGE2_REG_LAST_FEMALE_VAL - STAGE2_REG_LAST_MAX_ID];
+    if (male_val_out) *male_val_out = regs[STAGE2_REG_LAST_MALE_VAL - STAGE2_REG_LAST_MAX_ID];
     return true;
 }
 
-static bool i2c_read_stream_reg(uint8_t addr, uint8_t reg, uint8_t *dst, uint16_t len) {
-    if (!dst || len == 0) return false;
-    if (i2c_write_blocking(I2C_STAGE2_PORT, addr, &reg, 1, true) != 1) return false;
-    return i2c_read_blocking(I2C_STAGE2_PORT, addr, dst, len, false) == len;
-}
-
-static bool stage4_set_image_line_ptr(uint16_t line) {
-    if (line >= STAGE4_IMAGE_LINES) line = 0;
-    return stage2_write_reg16(STAGE4_ADDR, STAGE4_REG_IMAGE_LINE_PTR, line);
-}
-
-static bool stage4_read_image_line(uint16_t line, uint8_t *line_out) {
-    if (!line_out) return false;
-    if (!stage4_set_image_line_ptr(line)) return false;
-    return i2c_read_stream_reg(STAGE4_ADDR, STAGE4_REG_IMAGE_DATA, line_out, STAGE4_IMAGE_BINS);
-}
-
 static bool stage4_generate_image(uint8_t phoneme_id) {
     if (!stage2_write_reg8(STAGE4_ADDR, STAGE4_REG_GEN_PHONEME, phoneme_id)) return false;
     if (!stage2_write_reg8(STAGE4_ADDR, STAGE4_REG_TRAIN_TARGET, phoneme_id)) return false;
@@ -2808,10 +7696,13 @@ static bool stage4_backprop_step(uint8_t phoneme_id, uint8_t feedback_score) {
 }
 
 static bool stage4_capture_image(uint8_t image[STAGE4_IMAGE_LINES][STAGE4_IMAGE_BINS]) {
+    stage2_batch_t batch;
+    stage2_batch_begin(&batch);
     for (uint16_t line = 0; line < STAGE4_IMAGE_LINES; line++) {
-        if (!stage4_read_image_line(line, image[line])) return false;
+        stage2_batch_reg(&batch, STAGE4_ADDR, STAGE4_REG_IMAGE_LINE_PTR, line, 2);
+        stage2_batch_read(&batch, STAGE4_ADDR, STAGE4_REG_IMAGE_DATA, image[line], STAGE4_IMAGE_BINS);
     }
-    return true;
+    return stage2_batch_finish(&batch);
 }
 
 static bool stage2_score_generated_image(uint8_t addr,
@@ -2988,9 +7879,9 @@ static bool run_backprop_on_file(uint8_t addr,
     bool gender_pass = false;
     bool user_pass = false;
 
-    uint8_t expected_local[PHONEME_SEQ_LEN] = {0};
+    uint8_t expected_local[PHONEME_SEQ_MAX] = {0};
     if (expected_seq && expected_seq_count > 0) {
-        if (expected_seq_count > PHONEME_SEQ_LEN) expected_seq_count = PHONEME_SEQ_LEN;
+        if (expected_seq_count > PHONEME_SEQ_MAX) expected_seq_count = PHONEME_SEQ_MAX;
         memcpy(expected_local, expected_seq, expected_seq_count);
     }
 
@@ -3164,8 +8055,8 @@ static bool run_backprop_training(void) {
         snprintf(cap_path, sizeof(cap_path), "%s/%s", user_path, ufno.fname);
 
         uint8_t target_id = SIL_WORD_ID;
-        uint8_t word_seq[PHONEME_SEQ_LEN] = {0};
-        uint8_t expected_phonemes[PHONEME_SEQ_LEN] = {0};
+        uint8_t word_seq[PHONEME_SEQ_MAX] = {0};
+        uint8_t expected_phonemes[PHONEME_SEQ_MAX] = {0};
         uint8_t expected_phoneme_count = 0;
         char word_name[32];
         strncpy(word_name, ufno.fname, sizeof(word_name) - 1);
@@ -3176,14 +8067,14 @@ static bool run_backprop_training(void) {
         if (dict_seq_from_word(word_name, word_seq)) {
             expected_phoneme_count = build_expected_phoneme_list(word_seq,
                                                                  expected_phonemes,
-                                                                 PHONEME_SEQ_LEN);
+                                                                 PHONEME_SEQ_MAX);
         }
         bool expected_gender_male = (strcasecmp_local(current_user.gender, "Male") == 0);
 
         lcd_clear();
         lcd_print_padded_line(0, "Stage 2 ANN Train");
         char line1[21];
-        snprintf(line1, sizeof(line1), "Word:%s", word_name);
+        snprintf(line1, sizeof(line1), "Word:%.15s", word_name);
         lcd_print_padded_line(1, line1);
         lcd_print_padded_line(2, last_result);
         char line3[21];
@@ -3250,7 +8141,7 @@ static bool run_backprop_training(void) {
         lcd_clear();
         lcd_print_padded_line(0, "Stage 2 ANN Train");
         char done_line1[21];
-        snprintf(done_line1, sizeof(done_line1), "Word:%s", word_name);
+        snprintf(done_line1, sizeof(done_line1), "Word:%.15s", word_name);
         lcd_print_padded_line(1, done_line1);
         char done_line2[21];
         snprintf(done_line2,
@@ -3281,13 +8172,10 @@ static bool run_backprop_training(void) {
     char nn_path[64];
     if (!stage2_save_nn_to_sd(addr, nn_path, sizeof(nn_path), false)) return false;
 
-    for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
-        if (i == TRAIN_BEAM_INDEX) continue;
-        uint8_t other = (uint8_t)(STAGE2_BASE_ADDR + i);
-        if (!stage2_load_nn_from_sd(other, nn_path)) {
-            ok = false;
-        }
-    }
+    // The training beam is included: its manifest now matches the file, so it costs no pages, and
+    // it is frozen while the group address carries the changed pages to the others
+    uint8_t all = (uint8_t)((1u << STAGE2_COUNT) - 1u);
+    if (stage2_load_nn_broadcast(nn_path, all) != all) ok = false;
 
     return ok;
 }
@@ -3643,6 +8531,26 @@ static void menu_handle_key(char key) {
     }
 }
 
+// ==============================
+// Core 1: Stage 2 acquisition
+// ==============================
+// Word-ready interrupts, FIFO drains and the I2C engine's interrupt and callbacks live here, so
+// an SD write or an LCD redraw on core 0 does not hold up draining.
+static void core1_main(void) {
+    multicore_lockout_victim_init();
+    i2c_async_init();
+    init_word_ready_irqs();
+    core1_running = true;
+
+    while (1) {
+        if (!stage2_acquisition_paused) {
+            stage2_service_ready();
+        }
+        i2c_async_tick();
+        tight_loop_contents();
+    }
+}
+
 int main(void) {
     stdio_init_all();
     sleep_ms(1500);
@@ -3651,6 +8559,12 @@ int main(void) {
     init_word_ready_pins();
     init_fault_pins();
     init_i2c_stage2();
+    // Before core 1 starts draining, so the probe has the bus to itself
+    i2c_speed_probe_all();
+    multicore_launch_core1_with_stack(core1_main, core1_stack, sizeof(core1_stack));
+    while (!core1_running) {
+        tight_loop_contents();
+    }
     init_spi_sd();
     init_uart_ttl();
     lcd_init();
@@ -3690,36 +8604,19 @@ int main(void) {
             }
         }
 
+        // Training drives beam TRAIN_BEAM_INDEX itself; entries stay in the Stage 2 FIFOs meanwhile
+        stage2_acquisition_paused = train_state != TRAIN_IDLE;
         if (train_state != TRAIN_IDLE) {
             training_tick();
             tight_loop_contents();
             continue;
         }
 
-        for (uint8_t i = 0; i < STAGE2_COUNT; i++) {
-            uint8_t addr = (uint8_t)(STAGE2_BASE_ADDR + i);
-            bool word_ready = !gpio_get(word_ready_pins[i]);
-            if (!word_ready) {
-                continue;
-            }
-
-            uint16_t fifo_len = 0;
-            if (!stage2_read_fifo_len(addr, &fifo_len)) {
-                gpio_put(stage2_fault_pins[i], 1);
-                continue;
-            }
-            gpio_put(stage2_fault_pins[i], 0);
-
-            for (uint16_t n = 0; n < fifo_len; n++) {
-                stage2_entry_t entry;
-                if (!stage2_read_fifo_entry(addr, &entry)) {
-                    gpio_put(stage2_fault_pins[i], 1);
-                    break;
-                }
-                handle_stage2_entry(i, &entry);
-            }
-        }
+        stage2_consume_entries();
 
+        dict_compaction_tick();
+        dict_xip_tick();
+        dict_cache_tick();
         tight_loop_contents();
     }
 
@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+"""Compile Phrases.ac, the phrase-spotting automaton read by the firmware.
+
+Every dictionary word (optionally only one language) and every phrase listed in
+Phrases.txt becomes a pattern of an Aho-Corasick automaton over phoneme IDs.
+The beams feed their phonemes through it and get each word or phrase as soon as
+it is final, even when words follow each other without a silence. The firmware
+only uses patterns in the current user's language; on a multi-language card,
+compile with --language for that language, or the other languages' words fall
+through to the normal lookup at silence.
+
+Phrases.txt (optional, next to Dictionary.dat): one phrase per line,
+    2-digit hex language ID + space + the words of the phrase
+    e.g. "01 good morning"
+Each word is looked up in Dictionary.dat (same language first) and the phrase
+pattern is the concatenation of the word sequences. Lines starting with '#'
+are ignored.
+
+Phrases.ac layout (little-endian):
+    512-byte header: "DPHR", version, state count, edge count, pattern count, text bytes
+    16-byte states (state 0 = root), in breadth-first order:
+        0-3 first edge, 4 edge count, 5 depth, 6-7 reserved,
+        8-11 failure state, 12-15 pattern index + 1 of the longest pattern
+        ending at this state (own or through failure links), 0 = none
+    4-byte edges, sorted by phoneme per state: phoneme + 24-bit target state
+    8-byte patterns: phoneme count, language ID, word count, text length, text offset (u32)
+    pattern text (not NUL terminated)
+
+Phrases.ac does not depend on Dictionary.dat at run time; re-run this tool after
+editing the dictionary or the phrase list.
+"""
+
+import argparse
+import os
+import struct
+import sys
+from collections import deque
+
+PHRASE_VERSION = 1
+HEADER_BLOCK = 512
+MAX_EDGES = 48          # DICT_PHRASE_MAX_EDGES
+MAX_DEPTH = 255         # depth is stored in one byte
+MAX_TEXT = 64           # DICT_PHRASE_TEXT_MAX
+MAX_STATES = 1 << 24    # edge targets are 24-bit
+
+LEGACY_PHONEMES = 15
+LEGACY_LANG_OFFSET = 45
+
+
+def parse_dictionary_line(line):
+    """Returns (phoneme tuple, language ID, word) for either Dictionary.dat layout, or None."""
+    line = line.rstrip('\r\n')
+    try:
+        if line[2:3] == ':':
+            count = int(line[0:2], 16)
+            fields = line[3:3 + count * 3].split()
+            lang_hex = line[3 + count * 3:5 + count * 3]
+            word = line[6 + count * 3:]
+            if len(fields) != count:
+                return None
+        else:
+            fields = line[:LEGACY_LANG_OFFSET].split()
+            if len(fields) != LEGACY_PHONEMES:
+                return None
+            lang_hex = line[LEGACY_LANG_OFFSET:LEGACY_LANG_OFFSET + 2]
+            word = line[LEGACY_LANG_OFFSET + 3:]
+        seq = tuple(v for v in (int(f, 16) for f in fields) if v != 0)
+        lang = int(lang_hex, 16)
+    except ValueError:
+        return None
+    word = word.strip(' ')
+    if not seq or not word:
+        return None
+    return seq, lang, word
+
+
+def load_dictionary(path):
+    entries = []
+    with open(path, 'r', encoding='ascii', errors='ignore', newline='') as f:
+        for line in f:
+            record = parse_dictionary_line(line)
+            if record:
+                entries.append(record)
+    return entries
+
+
+def load_phrases(path, entries):
+    by_word = {}
+    for seq, lang, word in entries:
+        by_word.setdefault(word.lower(), []).append((lang, seq))
+
+    phrases = []
+    with open(path, 'r', encoding='ascii', errors='ignore') as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            parts = line.split()
+            try:
+                lang = int(parts[0], 16)
+            except ValueError:
+                print(f"WARNING: {path}:{number}: missing language ID, skipped")
+                continue
+            words = parts[1:]
+            seq = []
+            for word in words:
+                candidates = by_word.get(word.lower())
+                if not candidates:
+                    print(f"WARNING: {path}:{number}: '{word}' is not in Dictionary.dat, phrase skipped")
+                    seq = None
+                    break
+                same = [c for c in candidates if c[0] == lang]
+                seq.extend((same or candidates)[0][1])
+            if seq and len(words) > 0:
+                phrases.append((tuple(seq), lang, ' '.join(words), len(words)))
+    return phrases
+
+
+def build_automaton(patterns):
+    """patterns: list of (seq, lang, text, words). Returns (states, edges) in file order."""
+    # Trie with one pattern per state (sequences are unique).
+    children = [{}]
+    own = [None]
+    for index, (seq, _, _, _) in enumerate(patterns):
+        state = 0
+        for phoneme in seq:
+            nxt = children[state].get(phoneme)
+            if nxt is None:
+                nxt = len(children)
+                children[state][phoneme] = nxt
+                children.append({})
+                own.append(None)
+            state = nxt
+        own[state] = index
+
+    # Breadth-first renumbering keeps every state's edges contiguous and parents before children.
+    order = [0]
+    depth = {0: 0}
+    queue = deque([0])
+    while queue:
+        state = queue.popleft()
+        for phoneme in sorted(children[state]):
+            child = children[state][phoneme]
+            depth[child] = depth[state] + 1
+            order.append(child)
+            queue.append(child)
+    new_index = {old: new for new, old in enumerate(order)}
+
+    fail = {0: 0}
+    output = {0: 0}
+    for state in order:
+        for phoneme in sorted(children[state]):
+            child = children[state][phoneme]
+            if state == 0:
+                fail[child] = 0
+            else:
+                f = fail[state]
+                while f != 0 and phoneme not in children[f]:
+                    f = fail[f]
+                fail[child] = children[f].get(phoneme, 0)
+            if own[child] is not None:
+                output[child] = own[child] + 1
+            else:
+                output[child] = output[fail[child]]
+
+    states = []
+    edges = []
+    for state in order:
+        kids = sorted(children[state].items())
+        if len(kids) > MAX_EDGES:
+            raise ValueError(f"state at depth {depth[state]} has {len(kids)} edges (max {MAX_EDGES})")
+        if depth[state] > MAX_DEPTH:
+            raise ValueError(f"pattern longer than {MAX_DEPTH} phonemes")
+        states.append((len(edges), len(kids), depth[state], new_index[fail[state]], output[state]))
+        for phoneme, child in kids:
+            edges.append((phoneme, new_index[child]))
+    if len(states) >= MAX_STATES:
+        raise ValueError(f"{len(states)} states exceed the 24-bit edge target")
+    return states, edges
+
+
+def write_phrases(path, patterns, states, edges):
+    text = bytearray()
+    pattern_records = bytearray()
+    for seq, lang, words_text, words in patterns:
+        data = words_text.encode('ascii', errors='replace')[:MAX_TEXT]
+        pattern_records += struct.pack('<BBBBI', len(seq), lang, words, len(data), len(text))
+        text += data
+
+    header = bytearray(HEADER_BLOCK)
+    struct.pack_into('<4sIIIII', header, 0, b'DPHR', PHRASE_VERSION, len(states), len(edges), len(patterns), len(text))
+
+    with open(path, 'wb') as f:
+        f.write(header)
+        for first_edge, count, depth, fail, output in states:
+            f.write(struct.pack('<IBBHII', first_edge, count, depth, 0, fail, output))
+        for phoneme, target in edges:
+            f.write(bytes([phoneme]) + target.to_bytes(3, 'little'))
+        f.write(pattern_records)
+        f.write(text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile Phrases.ac from Dictionary.dat and Phrases.txt")
+    parser.add_argument('microsd', help="directory holding Dictionary.dat (the card's /microsd)")
+    parser.add_argument('--language', help="only dictionary words of this 2-digit hex language ID")
+    parser.add_argument('--phrases', help="phrase list (default: Phrases.txt next to Dictionary.dat)")
+    parser.add_argument('--no-words', action='store_true', help="phrases only, no single dictionary words")
+    parser.add_argument('-o', '--output', help="output file (default: Phrases.ac next to Dictionary.dat)")
+    args = parser.parse_args()
+
+    dict_path = os.path.join(args.microsd, "Dictionary.dat")
+    phrases_path = args.phrases or os.path.join(args.microsd, "Phrases.txt")
+    out_path = args.output or os.path.join(args.microsd, "Phrases.ac")
+    language = int(args.language, 16) if args.language else None
+
+    entries = load_dictionary(dict_path)
+    patterns = []
+    if not args.no_words:
+        # Target language first so it wins when two languages share a sequence
+        chosen = [e for e in entries if language is None or e[1] == language]
+        chosen.sort(key=lambda e: (e[1] != language, e[1]))
+        patterns.extend((seq, lang, word, 1) for seq, lang, word in chosen)
+    if os.path.exists(phrases_path):
+        patterns.extend(load_phrases(phrases_path, entries))
+    # One pattern per sequence: the first one listed wins
+    seen = set()
+    patterns = [p for p in patterns if not (p[0] in seen or seen.add(p[0]))]
+    if not patterns:
+        print("ERROR: nothing to compile")
+        sys.exit(1)
+
+    try:
+        states, edges = build_automaton(patterns)
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        sys.exit(1)
+    write_phrases(out_path, patterns, states, edges)
+
+    phrase_count = sum(1 for p in patterns if p[3] > 1)
+    size = os.path.getsize(out_path)
+    print(f"✓ Created {out_path}: {len(patterns) - phrase_count} words, {phrase_count} phrases, "
+          f"{len(states)} states, {len(edges)} edges, {size} bytes")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,312 @@
+/* Dictionary benchmark: runs the firmware's lookup, insert and merge code against a FatFs disk image */
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "host_disk.h"
+
+static unsigned long bench_lseeks = 0;
+static int bench_verbose = 0;
+
+/* Firmware log lines are dropped unless -v is given; the report goes through fprintf/fputs */
+static int bench_log(const char *fmt, ...) {
+    if (!bench_verbose) return 0;
+    va_list args;
+    va_start(args, fmt);
+    int n = vprintf(fmt, args);
+    va_end(args);
+    return n;
+}
+
+/* Every f_lseek the firmware makes (f_rewind included) goes through the counter */
+#define printf bench_log
+#define f_lseek bench_f_lseek
+#define main firmware_main
+extern char __flash_binary_end asm("bench_flash");
+#include "../../speech_recognition_translator.c"
+#undef main
+#undef f_lseek
+#undef printf
+
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+
+FRESULT bench_f_lseek(FIL *fp, FSIZE_t ofs) {
+    bench_lseeks++;
+    return f_lseek(fp, ofs);
+}
+
+uint8_t bench_flash[PICO_FLASH_SIZE_BYTES];
+
+#define BENCH_LANGUAGES 4
+#define BENCH_TARGET_LANG 1
+#define BENCH_KEY_SPACE 2560000u  /* 40^4 prefixes */
+
+typedef struct {
+    uint8_t key[DICT_KEY_SIZE];
+    uint32_t id;
+} bench_entry_t;
+
+typedef struct {
+    unsigned long reads;
+    unsigned long writes;
+    unsigned long lseeks;
+    uint64_t start_us;
+} bench_mark_t;
+
+static uint32_t bench_rng = 1;
+
+static uint32_t bench_rand(void) {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return bench_rng;
+}
+
+/* Sequence n: a 4-phoneme prefix unique to n (n * 7919 permutes the 40^4 prefixes), then a random
+   tail for a total of 4..16 phonemes, all from the stage-2 alphabet 0x05..0x2C */
+static void bench_make_seq(uint32_t n, uint8_t *seq) {
+    memset(seq, 0, PHONEME_SEQ_MAX);
+    uint32_t p = (uint32_t)(((uint64_t)n * 7919u) % BENCH_KEY_SPACE);
+    for (int i = 3; i >= 0; i--) {
+        seq[i] = (uint8_t)(DICT_APPROX_FIRST_ID + p % DICT_APPROX_PHONEMES);
+        p /= DICT_APPROX_PHONEMES;
+    }
+    int len = 4 + (int)(bench_rand() % 13);
+    for (int i = 4; i < len; i++) {
+        seq[i] = (uint8_t)(DICT_APPROX_FIRST_ID + bench_rand() % DICT_APPROX_PHONEMES);
+    }
+}
+
+static void bench_make_entry(uint32_t n, uint8_t lang, bench_entry_t *entry) {
+    bench_make_seq(n, entry->key);
+    entry->key[PHONEME_SEQ_MAX] = lang;
+    entry->id = n;
+}
+
+static void bench_word(uint32_t n, char *word, size_t len) {
+    snprintf(word, len, "w%lu", (unsigned long)n);
+}
+
+static int bench_compare_entry(const void *a, const void *b) {
+    return memcmp(((const bench_entry_t *)a)->key, ((const bench_entry_t *)b)->key, DICT_KEY_SIZE);
+}
+
+static bool bench_write_records(const char *path, const bench_entry_t *entries, uint32_t count) {
+    FIL file;
+    if (f_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return false;
+    for (uint32_t i = 0; i < count; i++) {
+        char word[DICT_WORD_SIZE + 1];
+        char line[DICT_LINE_BUF];
+        UINT bw;
+        bench_word(entries[i].id, word, sizeof(word));
+        size_t len = dict_format_record_line(entries[i].key, entries[i].key[PHONEME_SEQ_MAX], word, line);
+        if (len == 0 || f_write(&file, line, (UINT)len, &bw) != FR_OK || bw != len) {
+            f_close(&file);
+            return false;
+        }
+    }
+    return f_close(&file) == FR_OK;
+}
+
+static void bench_begin(bench_mark_t *mark) {
+    mark->reads = bench_disk_reads;
+    mark->writes = bench_disk_writes;
+    mark->lseeks = bench_lseeks;
+    mark->start_us = time_us_64();
+}
+
+static void bench_report(uint32_t records, const char *op, const bench_mark_t *mark, uint32_t ops, uint32_t errors) {
+    double us = (double)(time_us_64() - mark->start_us);
+    double n = ops ? (double)ops : 1.0;
+    fprintf(stdout, "%8lu  %-14s %7lu %11.2f %11.1f %10.2f %10.2f %9.2f %7lu\n",
+            (unsigned long)records, op, (unsigned long)ops, us / 1000.0, us / n,
+            (double)(bench_disk_reads - mark->reads) / n,
+            (double)(bench_disk_writes - mark->writes) / n,
+            (double)(bench_lseeks - mark->lseeks) / n,
+            (unsigned long)errors);
+    fflush(stdout);
+}
+
+static uint32_t bench_lookups(const bench_entry_t *entries, uint32_t count, uint32_t ops, bool expect_hit) {
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        const bench_entry_t *entry = &entries[bench_rand() % count];
+        char word[DICT_WORD_SIZE + 1];
+        char expected[DICT_WORD_SIZE + 1];
+
+        /* Every lookup goes to the storage layers, not the RAM result cache */
+        dict_cache_clear();
+        bool found = dict_lookup_word(entry->key, word, sizeof(word));
+        bench_word(entry->id, expected, sizeof(expected));
+        if (found != expect_hit || (found && strcmp(word, expected) != 0)) errors++;
+    }
+    return errors;
+}
+
+static int bench_run(uint32_t records, uint32_t newwords, uint32_t ops, const char *image) {
+    bench_rng = 0x9E3779B9u ^ records;
+    memset(bench_flash, 0xFF, sizeof(bench_flash));
+
+    /* 256 MB image: room for Dictionary.dat at 100k records plus the derived files and rewrites */
+    if (!host_disk_open(image, 524288)) {
+        fprintf(stderr, "dict_bench: cannot create %s\n", image);
+        return 1;
+    }
+    BYTE work[FF_MAX_SS];
+    if (f_mkfs("0:", FM_FAT32, 0, work, sizeof(work)) != FR_OK || f_mount(&fs, "0:", 1) != FR_OK ||
+        f_mkdir("0:/microsd") != FR_OK) {
+        fprintf(stderr, "dict_bench: cannot format %s\n", image);
+        return 1;
+    }
+
+    /* Sequence numbers: [0, records) dictionary, then NewWords.dat, inserts and misses */
+    bench_entry_t *dict = calloc(records, sizeof(bench_entry_t));
+    bench_entry_t *pending = calloc(newwords ? newwords : 1, sizeof(bench_entry_t));
+    bench_entry_t *inserts = calloc(ops, sizeof(bench_entry_t));
+    bench_entry_t *misses = calloc(ops, sizeof(bench_entry_t));
+    if (!dict || !pending || !inserts || !misses) {
+        fprintf(stderr, "dict_bench: out of memory\n");
+        return 1;
+    }
+    for (uint32_t i = 0; i < records; i++) {
+        bench_make_entry(i, (uint8_t)(1 + bench_rand() % BENCH_LANGUAGES), &dict[i]);
+    }
+    qsort(dict, records, sizeof(bench_entry_t), bench_compare_entry);
+    for (uint32_t i = 0; i < newwords; i++) {
+        bench_make_entry(records + i, BENCH_TARGET_LANG, &pending[i]);
+    }
+    for (uint32_t i = 0; i < ops; i++) {
+        bench_make_entry(records + newwords + i, BENCH_TARGET_LANG, &inserts[i]);
+        bench_make_entry(records + newwords + ops + i, BENCH_TARGET_LANG, &misses[i]);
+    }
+
+    if (!bench_write_records("0:/microsd/Dictionary.dat", dict, records) ||
+        (newwords && !bench_write_records("0:/microsd/NewWords.dat", pending, newwords))) {
+        fprintf(stderr, "dict_bench: cannot write the synthetic dictionary\n");
+        return 1;
+    }
+    f_unmount("0:");
+
+    /* Lookups resolve for an English user, so three of the four languages go through the fallback */
+    current_user.set = true;
+    strncpy(current_user.language, "English", sizeof(current_user.language) - 1);
+
+    bench_mark_t mark;
+    bench_begin(&mark);
+    bool ready = dict_init();
+    bench_report(records, "init", &mark, 1, ready ? 0 : 1);
+    if (!ready) return 1;
+
+    bench_begin(&mark);
+    uint32_t errors = bench_lookups(dict, records, ops, true);
+    bench_report(records, "lookup-hit", &mark, ops, errors);
+
+    bench_begin(&mark);
+    errors = bench_lookups(misses, ops, ops, false);
+    bench_report(records, "lookup-miss", &mark, ops, errors);
+
+    /* dict_init started the flash sync when the dictionary fits the region; finish it as the main loop would */
+    if (dict_xip_sync.active) {
+        bench_begin(&mark);
+        uint32_t ticks = 0;
+        while (dict_xip_sync.active) {
+            dict_xip_tick();
+            ticks++;
+        }
+        bench_report(records, "xip-sync", &mark, ticks, dict_xip_ready ? 0 : 1);
+    }
+    if (dict_xip_ready) {
+        bench_begin(&mark);
+        errors = bench_lookups(dict, records, ops, true);
+        bench_report(records, "lookup-xip", &mark, ops, errors);
+    }
+
+    /* One main-loop compaction tick per insert, then ticks until the last compaction lands */
+    bench_begin(&mark);
+    errors = 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        char word[DICT_WORD_SIZE + 1];
+        bench_word(inserts[i].id, word, sizeof(word));
+        if (!dict_add_word_with_language(inserts[i].key, BENCH_TARGET_LANG, word)) errors++;
+        dict_compaction_tick();
+    }
+    while (dict_compaction.active) dict_compaction_tick();
+    bench_report(records, "insert", &mark, ops, errors);
+
+    bench_begin(&mark);
+    errors = bench_lookups(inserts, ops, ops, true);
+    bench_report(records, "lookup-new", &mark, ops, errors);
+
+    if (newwords) {
+        bench_begin(&mark);
+        bool merged = dict_merge_new_words();
+        bench_report(records, "merge", &mark, newwords, merged ? 0 : 1);
+
+        bench_begin(&mark);
+        errors = bench_lookups(pending, newwords, ops, true);
+        bench_report(records, "lookup-merged", &mark, ops, errors);
+    }
+
+    dict_close_files();
+    f_unmount("0:");
+    host_disk_close();
+    return 0;
+}
+
+static void bench_usage(void) {
+    fputs("usage: dict_bench [-v] [--ops N] [--newwords N] [--image PATH] [records ...]\n"
+          "  records   dictionary sizes to benchmark (default 1000 10000 100000)\n"
+          "  --ops     lookups and inserts per size (default 1000)\n"
+          "  --newwords  NewWords.dat records to merge (default records / 20)\n"
+          "  --image   FatFs disk image path (default dict_bench.img)\n", stderr);
+}
+
+int main(int argc, char **argv) {
+    uint32_t sizes[16];
+    int size_count = 0;
+    uint32_t ops = 1000;
+    long newwords = -1;
+    const char *image = "dict_bench.img";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            bench_verbose = 1;
+        } else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) {
+            ops = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--newwords") == 0 && i + 1 < argc) {
+            newwords = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+            image = argv[++i];
+        } else if (argv[i][0] != '-' && size_count < 16) {
+            sizes[size_count++] = (uint32_t)strtoul(argv[i], NULL, 10);
+        } else {
+            bench_usage();
+            return 2;
+        }
+    }
+    if (size_count == 0) {
+        sizes[0] = 1000;
+        sizes[1] = 10000;
+        sizes[2] = 100000;
+        size_count = 3;
+    }
+    if (ops == 0) ops = 1;
+
+    fprintf(stdout, "%8s  %-14s %7s %11s %11s %10s %10s %9s %7s\n",
+            "records", "op", "count", "total_ms", "us/op", "rd_sec/op", "wr_sec/op", "lseek/op", "errors");
+
+    /* Each size runs in its own process so firmware globals start from their boot state */
+    int status = 0;
+    for (int i = 0; i < size_count; i++) {
+        uint32_t pending = newwords >= 0 ? (uint32_t)newwords : sizes[i] / 20;
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) _exit(bench_run(sizes[i], pending, ops, image));
+        int child = 1;
+        if (pid < 0 || waitpid(pid, &child, 0) < 0 || !WIFEXITED(child) || WEXITSTATUS(child) != 0) status = 1;
+    }
+    unlink(image);
+    return status;
+}
@@ -0,0 +1,83 @@
+/* File-backed FatFs disk for tools/dict_bench, with per-sector I/O counters */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "ff.h"
+#include "diskio.h"
+#include "host_disk.h"
+
+static FILE *disk_image = NULL;
+static DWORD disk_sectors = 0;
+
+unsigned long bench_disk_reads = 0;
+unsigned long bench_disk_writes = 0;
+
+/* Same counter the SD driver exports; the firmware's DICTSTATS reads it */
+volatile uint32_t sd_sector_reads = 0;
+
+int host_disk_open(const char *path, unsigned long sectors) {
+    disk_image = fopen(path, "w+b");
+    if (!disk_image) return 0;
+    disk_sectors = (DWORD)sectors;
+
+    /* Sparse file of the requested size; FatFs formats it */
+    if (fseek(disk_image, (long)sectors * FF_MIN_SS - 1, SEEK_SET) != 0 || fputc(0, disk_image) == EOF) {
+        fclose(disk_image);
+        disk_image = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void host_disk_close(void) {
+    if (disk_image) fclose(disk_image);
+    disk_image = NULL;
+}
+
+DSTATUS disk_initialize(BYTE pdrv) {
+    return (pdrv == 0 && disk_image) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE pdrv) {
+    return (pdrv == 0 && disk_image) ? 0 : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count) {
+    if (pdrv != 0 || !disk_image) return RES_NOTRDY;
+    bench_disk_reads += count;
+    sd_sector_reads += count;
+    if (fseek(disk_image, (long)sector * FF_MIN_SS, SEEK_SET) != 0) return RES_ERROR;
+    return fread(buff, FF_MIN_SS, count, disk_image) == count ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count) {
+    if (pdrv != 0 || !disk_image) return RES_NOTRDY;
+    bench_disk_writes += count;
+    if (fseek(disk_image, (long)sector * FF_MIN_SS, SEEK_SET) != 0) return RES_ERROR;
+    return fwrite(buff, FF_MIN_SS, count, disk_image) == count ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
+    if (pdrv != 0 || !disk_image) return RES_NOTRDY;
+    switch (cmd) {
+        case CTRL_SYNC:
+            fflush(disk_image);
+            return RES_OK;
+        case GET_SECTOR_COUNT:
+            *(DWORD *)buff = disk_sectors;
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *(WORD *)buff = FF_MIN_SS;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *)buff = 1;
+            return RES_OK;
+        default:
+            return RES_PARERR;
+    }
+}
+
+/* Fixed timestamp, as on the board (sd_driver.c) */
+DWORD get_fattime(void) {
+    return ((2024 - 1980) << 25) | (1 << 21) | (1 << 16);
+}
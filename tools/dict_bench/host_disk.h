@@ -0,0 +1,8 @@
+/* File-backed FatFs disk for tools/dict_bench */
+#pragma once
+
+extern unsigned long bench_disk_reads;
+extern unsigned long bench_disk_writes;
+
+int host_disk_open(const char *path, unsigned long sectors);
+void host_disk_close(void);
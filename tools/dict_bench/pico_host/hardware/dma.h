@@ -0,0 +1,29 @@
+/* No DMA on the host: no channel can be claimed, so the I2C engine runs in blocking mode. */
+#pragma once
+#include "pico/stdlib.h"
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+typedef struct {
+    uint32_t ctrl;
+} dma_channel_config;
+
+static inline int dma_claim_unused_channel(bool required) { (void)required; return -1; }
+static inline void dma_channel_unclaim(uint channel) { (void)channel; }
+static inline dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void)channel;
+    dma_channel_config c = {0};
+    return c;
+}
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+    (void)c; (void)size;
+}
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) { (void)c; (void)incr; }
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) { (void)c; (void)incr; }
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) { (void)c; (void)dreq; }
+static inline void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                                         const volatile void *read_addr, uint transfer_count, bool trigger) {
+    (void)channel; (void)config; (void)write_addr; (void)read_addr; (void)transfer_count; (void)trigger;
+}
+static inline bool dma_channel_is_busy(uint channel) { (void)channel; return false; }
+static inline void dma_channel_abort(uint channel) { (void)channel; }
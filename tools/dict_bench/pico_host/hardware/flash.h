@@ -0,0 +1,21 @@
+/* QSPI flash backed by a RAM array; XIP_BASE points at it so the XIP dictionary reads it directly. */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#define FLASH_PAGE_SIZE 256u
+#define FLASH_SECTOR_SIZE 4096u
+
+extern uint8_t bench_flash[PICO_FLASH_SIZE_BYTES];
+
+#undef XIP_BASE
+#define XIP_BASE ((uintptr_t)bench_flash)
+
+static inline void flash_range_erase(uint32_t offset, size_t count) {
+    memset(&bench_flash[offset], 0xFF, count);
+}
+
+static inline void flash_range_program(uint32_t offset, const uint8_t *data, size_t count) {
+    for (size_t i = 0; i < count; i++) bench_flash[offset + i] &= data[i];
+}
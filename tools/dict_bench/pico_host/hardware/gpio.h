@@ -0,0 +1,17 @@
+#pragma once
+#include "pico/stdlib.h"
+
+static inline void gpio_init(unsigned pin) { (void)pin; }
+static inline void gpio_set_dir(unsigned pin, bool out) { (void)pin; (void)out; }
+static inline void gpio_pull_up(unsigned pin) { (void)pin; }
+static inline bool gpio_get(unsigned pin) { (void)pin; return true; }
+static inline void gpio_put(unsigned pin, bool value) { (void)pin; (void)value; }
+static inline void gpio_set_function(unsigned pin, int fn) { (void)pin; (void)fn; }
+
+#define GPIO_IRQ_EDGE_FALL 0x4u
+#define GPIO_IRQ_EDGE_RISE 0x8u
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+static inline void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback) {
+    (void)gpio; (void)events; (void)enabled; (void)callback;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "pico/stdlib.h"
+
+typedef struct spi_inst spi_inst_t;
+#define spi0 ((spi_inst_t *)0)
+
+static inline unsigned spi_init(spi_inst_t *spi, unsigned baud) { (void)spi; return baud; }
@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+static inline void __mem_fence_acquire(void) { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+static inline void __mem_fence_release(void) { __atomic_thread_fence(__ATOMIC_RELEASE); }
+
+typedef volatile uint32_t spin_lock_t;
+static inline uint32_t spin_lock_blocking(spin_lock_t *lock) { (void)lock; return 0; }
+static inline void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) { (void)lock; (void)saved_irq; }
+static inline int spin_lock_claim_unused(bool required) { (void)required; return 0; }
+static inline spin_lock_t *spin_lock_init(unsigned lock_num) {
+    static spin_lock_t locks[32];
+    return &locks[lock_num];
+}
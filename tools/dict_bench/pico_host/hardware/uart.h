@@ -0,0 +1,8 @@
+#pragma once
+#include "pico/stdlib.h"
+
+typedef struct uart_inst uart_inst_t;
+#define uart0 ((uart_inst_t *)0)
+
+static inline unsigned uart_init(uart_inst_t *uart, unsigned baud) { (void)uart; return baud; }
+static inline void uart_puts(uart_inst_t *uart, const char *s) { (void)uart; (void)s; }
@@ -0,0 +1,9 @@
+/* Single core on the host: core 1 is never started, so core1_running stays false. */
+#pragma once
+#include "pico/stdlib.h"
+
+static inline void multicore_launch_core1(void (*entry)(void)) { (void)entry; }
+static inline void multicore_launch_core1_with_stack(void (*entry)(void), uint32_t *stack_bottom, size_t stack_size_bytes) { (void)entry; (void)stack_bottom; (void)stack_size_bytes; }
+static inline void multicore_lockout_victim_init(void) {}
+static inline void multicore_lockout_start_blocking(void) {}
+static inline void multicore_lockout_end_blocking(void) {}
@@ -0,0 +1,46 @@
+/* Host stand-in for the Pico SDK runtime used by tools/dict_bench (time, GPIO/I2C constants). */
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#define PICO_ERROR_TIMEOUT -1
+#define PICO_ERROR_GENERIC -2
+
+#define GPIO_IN 0
+#define GPIO_OUT 1
+#define GPIO_FUNC_SPI 1
+#define GPIO_FUNC_UART 2
+#define GPIO_FUNC_I2C 3
+#define GPIO_FUNC_SIO 5
+
+#define XIP_BASE 0x10000000u
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (2u * 1024u * 1024u)
+#endif
+
+#define __not_in_flash_func(f) f
+
+typedef uint64_t absolute_time_t;
+typedef unsigned int uint;
+
+static inline uint64_t time_us_64(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static inline uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+static inline absolute_time_t make_timeout_time_us(uint64_t us) { return time_us_64() + us; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return time_us_64() + (uint64_t)ms * 1000u; }
+static inline bool time_reached(absolute_time_t t) { return time_us_64() >= t; }
+static inline void sleep_ms(uint32_t ms) { (void)ms; }
+static inline void sleep_us(uint64_t us) { (void)us; }
+static inline void busy_wait_us_32(uint32_t us) { (void)us; }
+static inline void tight_loop_contents(void) {}
+static inline int getchar_timeout_us(uint32_t us) { (void)us; return PICO_ERROR_TIMEOUT; }
+static inline bool stdio_init_all(void) { return true; }
+static inline unsigned get_core_num(void) { return 0; }
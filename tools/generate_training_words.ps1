@@ -47,21 +47,34 @@ $outPath = if ([string]::IsNullOrWhiteSpace($OutputPath)) {
     $OutputPath
 }
 
-$hexFieldChars = 45
+# Lines are "NN:" + NN hex phonemes + language ID + word; the old fixed-width
+# layout (15 phonemes in 45 chars, language ID at 45, word at 48) is still accepted.
+$legacyHexFieldChars = 45
 $langFieldChars = 2
 $langSepChars = 1
 $wordSize = 26
-$wordOffset = $hexFieldChars + $langFieldChars + $langSepChars
 
 $targetIds = New-Object System.Collections.Generic.HashSet[int]
 
 $entries = New-Object System.Collections.Generic.List[object]
 Get-Content $dictPath | ForEach-Object {
     $line = $_
+    if ($line.Length -lt 3) { return }
+
+    if ($line[2] -eq ':') {
+        try { $count = [Convert]::ToInt32($line.Substring(0, 2), 16) } catch { return }
+        $hexFieldStart = 3
+        $hexFieldChars = $count * 3
+    } else {
+        $hexFieldStart = 0
+        $hexFieldChars = $legacyHexFieldChars
+    }
+    $langOffset = $hexFieldStart + $hexFieldChars
+    $wordOffset = $langOffset + $langFieldChars + $langSepChars
     if ($line.Length -lt $wordOffset) { return }
 
-    $hexPart = $line.Substring(0, $hexFieldChars).Trim()
-    $langHex = if ($line.Length -ge ($hexFieldChars + $langFieldChars)) { $line.Substring($hexFieldChars, $langFieldChars) } else { "00" }
+    $hexPart = $line.Substring($hexFieldStart, $hexFieldChars).Trim()
+    $langHex = $line.Substring($langOffset, $langFieldChars)
     try { $entryLanguageId = [Convert]::ToInt32($langHex, 16) } catch { $entryLanguageId = 0 }
     if ($entryLanguageId -ne $LanguageId) { return }
 